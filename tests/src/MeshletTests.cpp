@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Model/Meshlet.h"
+#include "Test.h"
+#include "TestMeshes.h"
+
+namespace
+{
+    /** Same projection as Camera, with Vulkan's flipped y and [0, 1] depth */
+    glm::mat4 make_view_projection(const glm::vec3& eye, const glm::vec3& target)
+    {
+        const glm::mat4 clip(1.0f,  0.0f, 0.0f, 0.0f,
+                             0.0f, -1.0f, 0.0f, 0.0f,
+                             0.0f,  0.0f, 0.5f, 0.0f,
+                             0.0f,  0.0f, 0.5f, 1.0f);
+        const glm::mat4 projection = clip
+            * glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+        return projection
+            * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    /** Whether any triangle of the meshlet faces eye */
+    bool has_front_face(
+        const TestMesh& mesh,
+        const Meshlet& meshlet,
+        const glm::mat4& transform,
+        const glm::vec3& eye
+    )
+    {
+        const uint32_t last = meshlet.index_offset + meshlet.index_count;
+        for (uint32_t i = meshlet.index_offset; i < last; i += 3)
+        {
+            const glm::vec3 p0 = glm::vec3(transform
+                * glm::vec4(mesh.vertices[mesh.indices[i]].position, 1.0f));
+            const glm::vec3 p1 = glm::vec3(transform
+                * glm::vec4(mesh.vertices[mesh.indices[i + 1]].position, 1.0f));
+            const glm::vec3 p2 = glm::vec3(transform
+                * glm::vec4(mesh.vertices[mesh.indices[i + 2]].position, 1.0f));
+
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            if (glm::dot(normal, eye - p0) > 0.0f)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Meshlet> build_all_meshlets(const TestMesh& mesh)
+    {
+        return build_meshlets(mesh.indices, mesh.vertices, 0,
+            (uint32_t)mesh.indices.size());
+    }
+} // namespace
+
+TEST(meshlets_respect_limits_and_cover_the_range)
+{
+    for (const TestMesh& mesh : { make_sphere(48, 96), make_grid(64, 2.0f) })
+    {
+        const std::vector<Meshlet> meshlets = build_all_meshlets(mesh);
+        CHECK(!meshlets.empty());
+
+        uint32_t next_index = 0;
+        for (const Meshlet& meshlet : meshlets)
+        {
+            CHECK(meshlet.index_offset == next_index);
+            CHECK(meshlet.index_count > 0);
+            CHECK(meshlet.index_count % 3 == 0);
+            CHECK(meshlet.index_count / 3 <= MESHLET_MAX_TRIANGLES);
+            CHECK(meshlet.vertex_count <= MESHLET_MAX_VERTICES);
+
+            // The vertex count is the number of distinct vertices
+            std::vector<uint32_t> seen;
+            const uint32_t last = meshlet.index_offset + meshlet.index_count;
+            for (uint32_t i = meshlet.index_offset; i < last; i++)
+            {
+                if (std::find(seen.begin(), seen.end(), mesh.indices[i])
+                    == seen.end())
+                {
+                    seen.push_back(mesh.indices[i]);
+                }
+            }
+            CHECK(seen.size() == meshlet.vertex_count);
+
+            next_index = last;
+        }
+        CHECK(next_index == mesh.indices.size());
+    }
+}
+
+TEST(meshlets_of_a_subrange_stay_inside_it)
+{
+    const TestMesh mesh = make_grid(32, 1.0f);
+    const uint32_t first_index = 300;
+    const uint32_t index_count = 1800;
+
+    const std::vector<Meshlet> meshlets = build_meshlets(
+        mesh.indices, mesh.vertices, first_index, index_count);
+
+    CHECK(meshlets.front().index_offset == first_index);
+    CHECK(meshlets.back().index_offset + meshlets.back().index_count
+        == first_index + index_count);
+}
+
+TEST(meshlet_spheres_contain_their_vertices)
+{
+    const TestMesh mesh = make_sphere(48, 96);
+    for (const Meshlet& meshlet : build_all_meshlets(mesh))
+    {
+        const glm::vec3 center(meshlet.bounding_sphere);
+        const uint32_t last = meshlet.index_offset + meshlet.index_count;
+        for (uint32_t i = meshlet.index_offset; i < last; i++)
+        {
+            const glm::vec3 position = mesh.vertices[mesh.indices[i]].position;
+            CHECK(glm::length(position - center)
+                <= meshlet.bounding_sphere.w * 1.0001f + 1e-6f);
+        }
+    }
+}
+
+TEST(meshlet_cones_are_conservative)
+{
+    const TestMesh mesh = make_sphere(48, 96);
+    const std::vector<Meshlet> meshlets = build_all_meshlets(mesh);
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> coordinate(-6.0f, 6.0f);
+
+    uint32_t culled = 0;
+    for (uint32_t eye_index = 0; eye_index < 200; eye_index++)
+    {
+        const glm::vec3 eye(
+            coordinate(random), coordinate(random), coordinate(random));
+
+        for (const Meshlet& meshlet : meshlets)
+        {
+            if (!is_cone_backfacing(meshlet.cone,
+                glm::vec3(meshlet.bounding_sphere), meshlet.bounding_sphere.w,
+                eye))
+            {
+                continue;
+            }
+
+            // Never culls a meshlet with a triangle facing the eye
+            CHECK(!has_front_face(mesh, meshlet, glm::mat4(1.0f), eye));
+            culled++;
+        }
+    }
+
+    // A sphere always faces away from outside viewers with about half of it
+    CHECK(culled > 0);
+}
+
+TEST(meshlet_visibility)
+{
+    const TestMesh mesh = make_sphere(48, 96);
+    const std::vector<Meshlet> meshlets = build_all_meshlets(mesh);
+
+    const glm::vec3 eye(0.0f, 0.0f, 5.0f);
+    const Frustum frustum =
+        extract_frustum(make_view_projection(eye, glm::vec3(0.0f)));
+
+    // In front of the camera: the far side is culled, and nothing that faces
+    // the camera is
+    uint32_t visible_count = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        const bool visible =
+            is_meshlet_visible(meshlet, glm::mat4(1.0f), frustum, eye);
+        if (has_front_face(mesh, meshlet, glm::mat4(1.0f), eye))
+        {
+            CHECK(visible);
+        }
+        visible_count += visible;
+    }
+    CHECK(visible_count > 0);
+    CHECK(visible_count < meshlets.size());
+
+    // Behind the camera, or off to the side, nothing is
+    for (const glm::vec3 offset :
+        { glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(50.0f, 0.0f, 0.0f) })
+    {
+        const glm::mat4 transform = glm::translate(glm::mat4(1.0f), offset);
+        for (const Meshlet& meshlet : meshlets)
+        {
+            CHECK(!is_meshlet_visible(meshlet, transform, frustum, eye));
+        }
+    }
+
+    // Non-uniform scale skips the cone test, so every meshlet in the frustum
+    // is kept. A uniform scale still culls
+    const glm::mat4 stretched =
+        glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.5f, 1.0f));
+    const glm::mat4 scaled = glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
+    uint32_t scaled_visible_count = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        CHECK(is_meshlet_visible(meshlet, stretched, frustum, eye));
+
+        const bool visible = is_meshlet_visible(meshlet, scaled, frustum, eye);
+        if (has_front_face(mesh, meshlet, scaled, eye))
+        {
+            CHECK(visible);
+        }
+        scaled_visible_count += visible;
+    }
+    CHECK(scaled_visible_count < meshlets.size());
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Test.h"
+#include "TestMeshes.h"
+#include "Model/Model.h"
+#include "Model/ObjParser.h"
+#include "Utils/ThreadPool.h"
+
+namespace
+{
+    const char* const MATERIAL_LIBRARY =
+        "newmtl red\n"
+        "Kd 1 0 0\n"
+        "\n"
+        "newmtl green\n"
+        "Kd 0 1 0\n"
+        "map_Kd green.png\n"
+        "\n"
+        "newmtl blue\n"
+        "Kd 0 0 1\n"
+        "d 0.5\n";
+
+    std::filesystem::path get_test_directory()
+    {
+        const std::filesystem::path directory =
+            std::filesystem::temp_directory_path() / "vulkantest_obj_parser";
+        std::filesystem::create_directories(directory);
+        return directory;
+    }
+
+    void write_file(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(text.data(), (std::streamsize)text.size());
+    }
+
+    /**
+     * Appends a fixture mesh to an OBJ. Every face gets its own usemtl line,
+     * cycling through material_names, so a material switch sits next to any
+     * chunk boundary that falls among the faces. Relative meshes index their
+     * vertices from the end, like f -3/-3/-3 -2/-2/-2 -1/-1/-1.
+     */
+    void append_mesh(
+        std::string& obj,
+        const TestMesh& mesh,
+        bool relative,
+        const std::vector<std::string>& material_names,
+        size_t& vertex_count
+    )
+    {
+        char line[256];
+        for (const Vertex& vertex : mesh.vertices)
+        {
+            snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n",
+                vertex.position.x, vertex.position.y, vertex.position.z);
+            obj += line;
+            snprintf(line, sizeof(line), "vt %.6f %.6f\n",
+                vertex.texcoord.x, vertex.texcoord.y);
+            obj += line;
+            snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n",
+                vertex.normal.x, vertex.normal.y, vertex.normal.z);
+            obj += line;
+        }
+
+        for (size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            obj += "usemtl " + material_names[i / 3 % material_names.size()]
+                + "\nf";
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                const long long index = relative
+                    ? (long long)mesh.indices[i + corner]
+                        - (long long)mesh.vertices.size()
+                    : (long long)(vertex_count + mesh.indices[i + corner] + 1);
+                snprintf(line, sizeof(line), " %lld/%lld/%lld",
+                    index, index, index);
+                obj += line;
+            }
+            obj += "\n";
+        }
+
+        vertex_count += mesh.vertices.size();
+    }
+
+    /**
+     * Offsets where parse_obj_parallel ends its chunks, worked out the same
+     * way it splits the file. Only used to steer material switches onto the
+     * boundaries.
+     */
+    std::vector<size_t> get_chunk_ends(const std::string& obj)
+    {
+        const size_t min_chunk_size = 1024 * 1024;
+        const size_t chunks_per_thread = 4;
+
+        const size_t target_chunks = std::max<size_t>(
+            1, std::min(obj.size() / min_chunk_size,
+                (size_t)get_thread_pool().get_thread_count()
+                    * chunks_per_thread));
+        const size_t target_size = obj.size() / target_chunks + 1;
+
+        std::vector<size_t> ends;
+        size_t begin = 0;
+        while (begin < obj.size())
+        {
+            size_t end = std::min(begin + target_size, obj.size());
+            while (obj[end - 1] != '\n')
+            {
+                end++;
+            }
+            ends.push_back(end);
+            begin = end;
+        }
+        return ends;
+    }
+
+    /** Whether some chunk but the last ends on a usemtl line. */
+    bool has_switch_at_chunk_end(const std::string& obj)
+    {
+        const std::vector<size_t> ends = get_chunk_ends(obj);
+        for (size_t i = 0; i + 1 < ends.size(); i++)
+        {
+            const size_t line = obj.rfind('\n', ends[i] - 2) + 1;
+            if (obj.compare(line, 7, "usemtl ") == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Imports an OBJ with both parsers and checks they agree exactly. */
+    void check_parsers_match(const std::filesystem::path& path)
+    {
+        const std::string filename = path.string();
+
+        Model serial;
+        CHECK(serial.load_from_obj(filename.c_str()));
+        Model parallel;
+        CHECK(parse_obj_parallel(filename.c_str(), parallel));
+
+        CHECK(!serial.indices.empty());
+        CHECK(parallel.indices == serial.indices);
+
+        CHECK(parallel.vertices.size() == serial.vertices.size());
+        for (size_t i = 0; i < serial.vertices.size(); i++)
+        {
+            const Vertex& a = serial.vertices[i];
+            const Vertex& b = parallel.vertices[i];
+            CHECK(a.position == b.position && a.texcoord == b.texcoord
+                && a.normal == b.normal && a.color == b.color);
+        }
+
+        CHECK(parallel.submeshes.size() == serial.submeshes.size());
+        for (size_t i = 0; i < serial.submeshes.size(); i++)
+        {
+            const Submesh& a = serial.submeshes[i];
+            const Submesh& b = parallel.submeshes[i];
+            CHECK(a.material_index == b.material_index
+                && a.index_offset == b.index_offset
+                && a.index_count == b.index_count);
+        }
+
+        CHECK(parallel.materials.size() == serial.materials.size());
+        for (size_t i = 0; i < serial.materials.size(); i++)
+        {
+            const Material& a = serial.materials[i];
+            const Material& b = parallel.materials[i];
+            CHECK(a.name == b.name && a.base_color == b.base_color
+                && a.texture_path == b.texture_path);
+        }
+
+        CHECK(parallel.material_files == serial.material_files);
+    }
+} // namespace
+
+TEST(obj_parser_matches_fast_obj)
+{
+    const std::filesystem::path directory = get_test_directory();
+    write_file(directory / "materials.mtl", MATERIAL_LIBRARY);
+
+    // A missing library, a material no library defines, a quad to split into
+    // a fan and a last line without a newline
+    std::string obj = "mtllib materials.mtl\nmtllib missing.mtl\n";
+    size_t vertex_count = 0;
+    append_mesh(obj, make_sphere(6, 8), false, { "green", "unlisted" },
+        vertex_count);
+    obj += "o quad\nusemtl red\nf 1/1/1 2/2/2 11/11/11 10/10/10\n";
+    append_mesh(obj, make_grid(3, 1.0f), true, { "blue", "red" },
+        vertex_count);
+    obj += "usemtl green\nf 1/1/1 2/2/2 3/3/3";
+
+    write_file(directory / "small.obj", obj);
+    check_parsers_match(directory / "small.obj");
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(obj_parser_matches_fast_obj_across_chunks)
+{
+    const std::filesystem::path directory = get_test_directory();
+    write_file(directory / "materials.mtl", MATERIAL_LIBRARY);
+
+    std::string body;
+    size_t vertex_count = 0;
+    append_mesh(body, make_sphere(160, 160), false, { "red", "green", "blue" },
+        vertex_count);
+    body += "mtllib missing.mtl\n";
+    append_mesh(body, make_grid(64, 2.0f), true, { "blue", "green" },
+        vertex_count);
+
+    // Pad the header until a chunk ends right after a usemtl line, so that
+    // switch has to carry over to the next chunk's faces. Chunks end on the
+    // other lines too, which starts the next chunk with a usemtl
+    std::string obj;
+    bool found = false;
+    for (size_t padding = 0; padding < 256 && !found; padding++)
+    {
+        obj = "mtllib materials.mtl\n# " + std::string(padding, '-') + "\n"
+            + body;
+        found = has_switch_at_chunk_end(obj);
+    }
+    CHECK(found);
+    CHECK(get_chunk_ends(obj).size() > 1);
+
+    // The serial importer has to take this one
+    CHECK(obj.size() < PARALLEL_OBJ_THRESHOLD);
+
+    write_file(directory / "large.obj", obj);
+    check_parsers_match(directory / "large.obj");
+
+    std::filesystem::remove_all(directory);
+}
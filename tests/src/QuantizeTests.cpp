@@ -0,0 +1,130 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/geometric.hpp>
+
+#include "Model/Quantize.h"
+#include "Test.h"
+#include "TestMeshes.h"
+
+namespace
+{
+    /**
+     * Packs the vertices and checks both the error quantize_vertices reports
+     * and the error measured here against the bound.
+     */
+    void check_round_trip(const std::vector<Vertex>& vertices)
+    {
+        const QuantizationParams params =
+            compute_quantization_params(vertices);
+        const QuantizationError bound = get_quantization_error_bound(params);
+
+        std::vector<PackedVertex> packed;
+        const QuantizationError error =
+            quantize_vertices(vertices, params, packed);
+        CHECK(packed.size() == vertices.size());
+
+        CHECK(error.position <= bound.position);
+        CHECK(error.normal <= bound.normal);
+        CHECK(error.texcoord <= bound.texcoord);
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex unpacked = unpack_vertex(packed[i], params);
+            CHECK(glm::length(unpacked.position - vertices[i].position)
+                <= bound.position);
+            CHECK(glm::length(unpacked.texcoord - vertices[i].texcoord)
+                <= bound.texcoord);
+
+            const glm::vec3 normal = glm::normalize(vertices[i].normal);
+            const float angle = std::atan2(
+                glm::length(glm::cross(unpacked.normal, normal)),
+                glm::dot(unpacked.normal, normal));
+            CHECK(angle <= bound.normal);
+        }
+    }
+
+    std::vector<Vertex> make_random_vertices(
+        std::mt19937& random,
+        size_t count,
+        const glm::vec3& center,
+        float extent
+    )
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> texcoord(-2.0f, 3.0f);
+
+        std::vector<Vertex> vertices(count);
+        for (Vertex& vertex : vertices)
+        {
+            vertex.position = center
+                + extent * glm::vec3(unit(random), unit(random), unit(random));
+            vertex.texcoord = { texcoord(random), texcoord(random) };
+
+            glm::vec3 normal;
+            do
+            {
+                normal = glm::vec3(unit(random), unit(random), unit(random));
+            } while (glm::length(normal) < 0.01f);
+            vertex.normal = normal;
+            vertex.color = glm::vec3(1.0f);
+        }
+        return vertices;
+    }
+} // namespace
+
+TEST(quantize_round_trip_is_within_bound)
+{
+    std::mt19937 random(42);
+
+    // Meshes around the origin, far from it, and tiny or huge ones
+    check_round_trip(make_random_vertices(random, 10000, glm::vec3(0.0f), 1.0f));
+    check_round_trip(make_random_vertices(
+        random, 10000, glm::vec3(1000.0f, -250.0f, 40.0f), 3.0f));
+    check_round_trip(make_random_vertices(
+        random, 1000, glm::vec3(0.5f), 0.0001f));
+    check_round_trip(make_random_vertices(
+        random, 1000, glm::vec3(-20.0f), 5000.0f));
+
+    check_round_trip(make_sphere(32, 64).vertices);
+}
+
+TEST(quantize_round_trip_of_axis_normals)
+{
+    // The octahedron's vertices and edges, where the fold is
+    std::vector<Vertex> vertices;
+    for (const glm::vec3 normal : {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1),
+        glm::vec3(1, 1, 0), glm::vec3(-1, 0, -1), glm::vec3(0, -1, -1),
+        glm::vec3(1, -1, -1), glm::vec3(-1, -1, 1) })
+    {
+        vertices.push_back({
+            .position = normal,
+            .texcoord = { 0.0f, 1.0f },
+            .normal = normal,
+            .color = glm::vec3(1.0f)
+        });
+    }
+
+    check_round_trip(vertices);
+}
+
+TEST(quantize_flat_mesh)
+{
+    // Every vertex on one plane, with a single texcoord, which gives
+    // degenerate extents
+    std::vector<Vertex> vertices;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        vertices.push_back({
+            .position = { (float)i, 2.0f, (float)(i % 7) },
+            .texcoord = { 0.25f, 0.25f },
+            .normal = { 0.0f, 1.0f, 0.0f },
+            .color = glm::vec3(1.0f)
+        });
+    }
+
+    check_round_trip(vertices);
+}
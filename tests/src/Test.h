@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * A test or benchmark, registered by TEST or BENCHMARK at startup. Tests
+ * report failures through CHECK and keep going, benchmarks print what they
+ * measured.
+ */
+struct TestCase
+{
+    const char* name;
+    std::function<void()> function;
+};
+
+std::vector<TestCase>& get_tests();
+std::vector<TestCase>& get_benchmarks();
+
+struct TestRegistrar
+{
+    TestRegistrar(std::vector<TestCase>& cases, const char* name,
+        std::function<void()>&& function)
+    {
+        cases.push_back({ name, std::move(function) });
+    }
+};
+
+void report_failure(const char* file, int line, const char* expression);
+
+#define TEST(name) \
+    static void name(); \
+    static const TestRegistrar name##_registrar(get_tests(), #name, name); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const TestRegistrar name##_registrar( \
+        get_benchmarks(), #name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    ((expression) ? (void)0 : report_failure(__FILE__, __LINE__, #expression))
+
+/**
+ * Runs function iterations times and returns the average time per call in
+ * nanoseconds, after one untimed warm up call.
+ */
+double time_ns(uint32_t iterations, const std::function<void()>& function);
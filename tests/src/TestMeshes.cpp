@@ -0,0 +1,93 @@
+#include "TestMeshes.h"
+
+#include <cmath>
+
+TestMesh make_sphere(uint32_t rings, uint32_t segments)
+{
+    const float pi = 3.14159265358979f;
+    TestMesh mesh;
+
+    // One extra column of vertices closes the seam
+    for (uint32_t ring = 0; ring <= rings; ring++)
+    {
+        const float theta = pi * (float)ring / (float)rings;
+        for (uint32_t segment = 0; segment <= segments; segment++)
+        {
+            const float phi = 2.0f * pi * (float)segment / (float)segments;
+            const glm::vec3 position(
+                std::sin(theta) * std::cos(phi),
+                std::cos(theta),
+                -std::sin(theta) * std::sin(phi)
+            );
+            mesh.vertices.push_back({
+                .position = position,
+                .texcoord = { (float)segment / (float)segments,
+                              (float)ring / (float)rings },
+                .normal = position,
+                .color = { 1.0f, 1.0f, 1.0f }
+            });
+        }
+    }
+
+    const uint32_t stride = segments + 1;
+    for (uint32_t ring = 0; ring < rings; ring++)
+    {
+        for (uint32_t segment = 0; segment < segments; segment++)
+        {
+            const uint32_t top_left = ring * stride + segment;
+            const uint32_t top_right = top_left + 1;
+            const uint32_t bottom_left = top_left + stride;
+            const uint32_t bottom_right = bottom_left + 1;
+
+            // The triangles touching the poles would be degenerate
+            if (ring != 0)
+            {
+                mesh.indices.insert(mesh.indices.end(),
+                    { top_left, bottom_left, top_right });
+            }
+            if (ring != rings - 1)
+            {
+                mesh.indices.insert(mesh.indices.end(),
+                    { top_right, bottom_left, bottom_right });
+            }
+        }
+    }
+
+    return mesh;
+}
+
+TestMesh make_grid(uint32_t cells, float size)
+{
+    TestMesh mesh;
+
+    for (uint32_t y = 0; y <= cells; y++)
+    {
+        for (uint32_t x = 0; x <= cells; x++)
+        {
+            const float u = (float)x / (float)cells;
+            const float v = (float)y / (float)cells;
+            const float noise = 0.01f * std::sin(37.0f * u + 91.0f * v);
+            mesh.vertices.push_back({
+                .position = { (u - 0.5f) * size, (v - 0.5f) * size, noise },
+                .texcoord = { u, v },
+                .normal = { 0.0f, 0.0f, 1.0f },
+                .color = { u, v, 1.0f }
+            });
+        }
+    }
+
+    const uint32_t stride = cells + 1;
+    for (uint32_t y = 0; y < cells; y++)
+    {
+        for (uint32_t x = 0; x < cells; x++)
+        {
+            const uint32_t corner = y * stride + x;
+            mesh.indices.insert(mesh.indices.end(), {
+                corner, corner + 1, corner + stride + 1,
+                corner, corner + stride + 1, corner + stride
+            });
+        }
+    }
+
+    return mesh;
+}
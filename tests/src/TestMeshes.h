@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Model/Vertex.h"
+
+struct TestMesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+/**
+ * A unit UV sphere around the origin, wound counter-clockwise seen from
+ * outside, with a texcoord seam and normals pointing out.
+ */
+TestMesh make_sphere(uint32_t rings, uint32_t segments);
+
+/**
+ * A square grid in the xy plane from -size / 2 to size / 2, facing +z, with
+ * a little noise on z so it isn't perfectly flat.
+ */
+TestMesh make_grid(uint32_t cells, float size);
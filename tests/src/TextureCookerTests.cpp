@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "Texture/TextureCooker.h"
+
+namespace
+{
+    /**
+     * Smooth gradients with some noise, like a photographic texture. The
+     * size isn't a multiple of the block size, so edge blocks get covered.
+     */
+    TextureData make_image(bool with_alpha)
+    {
+        TextureData image;
+        image.width = 61;
+        image.height = 45;
+        image.levels.push_back({ image.width, image.height, 0,
+            (uint64_t)image.width * image.height * 4 });
+        image.pixels.resize(image.levels[0].size);
+
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<int> noise(-6, 6);
+        const auto to_byte = [](float value)
+        {
+            return (uint8_t)std::clamp((int)std::lround(value), 0, 255);
+        };
+
+        for (uint32_t y = 0; y < image.height; y++)
+        {
+            for (uint32_t x = 0; x < image.width; x++)
+            {
+                const float u = (float)x / (image.width - 1);
+                const float v = (float)y / (image.height - 1);
+                uint8_t* pixel = &image.pixels[4 * (y * image.width + x)];
+
+                pixel[0] = to_byte(255.0f * u + noise(random));
+                pixel[1] = to_byte(255.0f * v + noise(random));
+                pixel[2] = to_byte(128.0f + 100.0f
+                    * std::sin(6.0f * (u + v)) + noise(random));
+                pixel[3] = with_alpha ? to_byte(255.0f * (1.0f - u * v)) : 255;
+            }
+        }
+
+        return image;
+    }
+
+    /**
+     * Checks the top level of a cooked texture against the image. Every level
+     * has to decode, but the last few squeeze whole gradients into a single
+     * block, so only the top one says much about the encoder.
+     */
+    void check_psnr(
+        const TextureData& cooked,
+        const TextureData& image,
+        bool include_alpha,
+        double min_psnr
+    )
+    {
+        CHECK(cooked.levels.size()
+            == get_mip_level_count(image.width, image.height));
+
+        for (uint32_t level = 0; level < cooked.levels.size(); level++)
+        {
+            const TextureLevel& info = cooked.levels[level];
+            CHECK(decode_texture_level(cooked, level).size()
+                == 4 * (size_t)info.width * info.height);
+        }
+
+        const std::vector<uint8_t> pixels = decode_texture_level(cooked, 0);
+        const double psnr = compute_psnr(image.pixels.data(), pixels.data(),
+            (size_t)image.width * image.height, include_alpha);
+        if (psnr < min_psnr)
+        {
+            printf("  %s: %.2f dB, expected at least %.2f\n",
+                get_texture_format_name(cooked.format), psnr, min_psnr);
+        }
+        CHECK(psnr >= min_psnr);
+    }
+
+    /** A couple of dB under what the encoders reach on make_image */
+    constexpr double BC1_MIN_PSNR = 32.0;
+    constexpr double BC3_MIN_PSNR = 33.0;
+    constexpr double BC7_MIN_PSNR = 34.5;
+
+    const ETextureFormat COMPRESSED_FORMATS[] = {
+        TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC7
+    };
+} // namespace
+
+TEST(texture_cooker_is_deterministic)
+{
+    const TextureData image = make_image(true);
+
+    for (const ETextureFormat format : COMPRESSED_FORMATS)
+    {
+        // Blocks are encoded on the thread pool, so any dependence on the
+        // order they run in would show up as different bytes
+        const TextureData first = cook_texture(image, format);
+        const TextureData second = cook_texture(image, format);
+        CHECK(!first.pixels.empty());
+        CHECK(first.pixels == second.pixels);
+    }
+}
+
+TEST(texture_cooker_sse2_matches_scalar)
+{
+    if (!set_texture_cooker_sse2(true))
+    {
+        printf("  no SSE2 loops in this build, skipped\n");
+        return;
+    }
+
+    for (const bool with_alpha : { false, true })
+    {
+        const TextureData image = make_image(with_alpha);
+        for (const ETextureFormat format : COMPRESSED_FORMATS)
+        {
+            set_texture_cooker_sse2(true);
+            const TextureData sse2 = cook_texture(image, format);
+            set_texture_cooker_sse2(false);
+            const TextureData scalar = cook_texture(image, format);
+            CHECK(sse2.pixels == scalar.pixels);
+        }
+    }
+
+    set_texture_cooker_sse2(true);
+}
+
+TEST(texture_cooker_psnr_floor)
+{
+    const TextureData opaque = make_image(false);
+    const TextureData translucent = make_image(true);
+
+    // Uncompressed textures come back exactly
+    const TextureData uncompressed =
+        cook_texture(translucent, TEXTURE_FORMAT_RGBA8);
+    const std::vector<uint8_t> pixels = decode_texture_level(uncompressed, 0);
+    CHECK(std::isinf(compute_psnr(translucent.pixels.data(), pixels.data(),
+        (size_t)translucent.width * translucent.height, true)));
+
+    check_psnr(cook_texture(opaque, TEXTURE_FORMAT_BC1), opaque, false,
+        BC1_MIN_PSNR);
+    check_psnr(cook_texture(translucent, TEXTURE_FORMAT_BC3), translucent,
+        true, BC3_MIN_PSNR);
+    check_psnr(cook_texture(translucent, TEXTURE_FORMAT_BC7), translucent,
+        true, BC7_MIN_PSNR);
+}
@@ -0,0 +1,273 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "Test.h"
+#include "Utils/ThreadPool.h"
+
+namespace
+{
+    /**
+     * Keeps every worker of a pool busy until released, or until a timeout
+     * so a broken pool fails the test instead of hanging it.
+     */
+    class PoolBlocker
+    {
+    public:
+        explicit PoolBlocker(ThreadPool& pool)
+        {
+            for (uint32_t i = 0; i < pool.get_thread_count(); i++)
+            {
+                blocked.push_back(pool.submit(
+                    [this]()
+                    {
+                        started.fetch_add(1);
+                        const auto timeout = std::chrono::steady_clock::now()
+                            + std::chrono::seconds(5);
+                        while (!released.load()
+                            && std::chrono::steady_clock::now() < timeout)
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                ));
+            }
+
+            while (started.load() < blocked.size())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        ~PoolBlocker() { release(); }
+
+        void release()
+        {
+            released = true;
+            for (std::future<void>& future : blocked)
+            {
+                future.wait();
+            }
+            blocked.clear();
+        }
+
+    private:
+        std::vector<std::future<void>> blocked;
+        std::atomic<size_t> started = 0;
+        std::atomic<bool> released = false;
+    };
+} // namespace
+
+TEST(thread_pool_submit_returns_result)
+{
+    ThreadPool pool(2);
+    std::future<int> result = pool.submit([]() { return 42; });
+    CHECK(result.get() == 42);
+}
+
+TEST(thread_pool_parallel_for_runs_every_index_once)
+{
+    ThreadPool pool(3);
+
+    for (const size_t count : { 1, 2, 7, 64, 1000 })
+    {
+        for (const size_t batch_size : { 0, 1, 3, 64, 2000 })
+        {
+            std::vector<std::atomic<uint32_t>> calls(count);
+            pool.parallel_for_range(count, batch_size,
+                [&](size_t first, size_t last)
+                {
+                    CHECK(first < last);
+                    CHECK(last <= count);
+                    CHECK(last - first <= std::max<size_t>(batch_size, 1));
+                    for (size_t i = first; i < last; i++)
+                    {
+                        calls[i].fetch_add(1);
+                    }
+                }
+            );
+
+            for (const std::atomic<uint32_t>& call : calls)
+            {
+                CHECK(call.load() == 1);
+            }
+        }
+    }
+
+    bool called = false;
+    pool.parallel_for(0, [&](size_t) { called = true; });
+    CHECK(!called);
+}
+
+TEST(thread_pool_nested_parallel_for)
+{
+    ThreadPool pool(2);
+    std::atomic<uint32_t> calls = 0;
+
+    std::future<void> outer = pool.submit(
+        [&]()
+        {
+            pool.parallel_for(16,
+                [&](size_t)
+                {
+                    pool.parallel_for(16, [&](size_t) { calls.fetch_add(1); });
+                }
+            );
+        }
+    );
+    outer.get();
+
+    CHECK(calls.load() == 16 * 16);
+}
+
+TEST(thread_pool_run_after_waits_for_dependency)
+{
+    ThreadPool pool(3);
+    JobCounter first;
+    JobCounter second;
+    std::atomic<uint32_t> first_done = 0;
+    std::atomic<uint32_t> ordered = 0;
+
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        pool.run(first,
+            [&]()
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                first_done.fetch_add(1);
+            }
+        );
+    }
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        pool.run_after(first, second,
+            [&]()
+            {
+                if (first_done.load() == 32)
+                {
+                    ordered.fetch_add(1);
+                }
+            }
+        );
+    }
+
+    pool.wait(second);
+    CHECK(first.is_done());
+    CHECK(ordered.load() == 32);
+
+    // A dependency that's already done queues the job right away
+    JobCounter third;
+    bool ran = false;
+    pool.run_after(first, third, [&]() { ran = true; });
+    pool.wait(third);
+    CHECK(ran);
+}
+
+TEST(thread_pool_parallel_for_ignores_unrelated_tasks)
+{
+    ThreadPool pool(2);
+    PoolBlocker blocker(pool);
+
+    // Queued behind the blocked workers, so only a waiter that helps with
+    // anything queued would run it
+    std::atomic<bool> unrelated_ran = false;
+    std::future<void> unrelated =
+        pool.submit([&]() { unrelated_ran = true; });
+
+    // The helpers can't start either, so the caller does every batch and
+    // returns without waiting for them
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> calls = 0;
+    pool.parallel_for(100, [&](size_t) { calls.fetch_add(1); });
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK(calls.load() == 100);
+    CHECK(!unrelated_ran.load());
+    CHECK(elapsed < std::chrono::seconds(1));
+
+    blocker.release();
+    unrelated.get();
+    CHECK(unrelated_ran.load());
+}
+
+TEST(thread_pool_frame_pool_is_separate)
+{
+    ThreadPool& frame_pool = get_frame_pool();
+    CHECK(&frame_pool != &get_thread_pool());
+    CHECK(frame_pool.get_thread_count() >= 1);
+
+    // Background work keeping the shared pool busy doesn't hold frame work
+    PoolBlocker blocker(get_thread_pool());
+    std::atomic<uint32_t> calls = 0;
+    frame_pool.parallel_for(64, [&](size_t) { calls.fetch_add(1); });
+    CHECK(calls.load() == 64);
+}
+
+TEST(thread_pool_drains_on_destruction)
+{
+    std::atomic<uint32_t> calls = 0;
+    {
+        ThreadPool pool(2);
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            pool.submit([&]() { calls.fetch_add(1); });
+        }
+    }
+    CHECK(calls.load() == 100);
+}
+
+BENCHMARK(thread_pool_scheduling_overhead)
+{
+    ThreadPool pool;
+    const uint32_t threads = pool.get_thread_count();
+
+    // A task queued from outside the pool and waited on
+    const double submit_ns = time_ns(10000,
+        [&]() { pool.submit([]() {}).get(); });
+
+    // Empty parallel_for calls, which are all scheduling
+    const double parallel_for_ns = time_ns(10000,
+        [&]() { pool.parallel_for(threads + 1, [](size_t) {}); });
+
+    // Jobs fanned out from a worker, which stay off the shared lock
+    const uint32_t job_count = 10000;
+    const double worker_push_ns = time_ns(20,
+        [&]()
+        {
+            pool.submit(
+                [&]()
+                {
+                    JobCounter counter;
+                    for (uint32_t i = 0; i < job_count; i++)
+                    {
+                        pool.run(counter, []() {});
+                    }
+                    pool.wait(counter);
+                }
+            ).get();
+        }
+    ) / job_count;
+
+    // Small batches of real work against doing it serially
+    std::vector<float> values(1 << 20, 1.0f);
+    const auto scale = [&](size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            values[i] = values[i] * 0.5f + 1.0f;
+        }
+    };
+    const double serial_ns = time_ns(20,
+        [&]() { scale(0, values.size()); });
+    const double parallel_ns = time_ns(20,
+        [&]() { pool.parallel_for_range(values.size(), 4096, scale); });
+
+    printf("%u threads\n", threads);
+    printf("  submit and wait        %10.0f ns\n", submit_ns);
+    printf("  empty parallel_for     %10.0f ns\n", parallel_for_ns);
+    printf("  job queued by worker   %10.0f ns\n", worker_push_ns);
+    printf("  1M floats serial       %10.0f ns\n", serial_ns);
+    printf("  1M floats parallel_for %10.0f ns\n", parallel_ns);
+}
@@ -0,0 +1,87 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "Test.h"
+
+namespace
+{
+    /** Checks can fail on pool threads too */
+    std::atomic<uint32_t> failure_count = 0;
+} // namespace
+
+std::vector<TestCase>& get_tests()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+std::vector<TestCase>& get_benchmarks()
+{
+    static std::vector<TestCase> benchmarks;
+    return benchmarks;
+}
+
+void report_failure(const char* file, int line, const char* expression)
+{
+    std::cerr << file << "(" << line << "): CHECK(" << expression
+              << ") failed\n";
+    failure_count++;
+}
+
+double time_ns(uint32_t iterations, const std::function<void()>& function)
+{
+    function();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        function();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        elapsed).count() / iterations;
+}
+
+/**
+ * Runs every test, or every benchmark with --bench. Any other argument only
+ * runs the cases whose name contains it. Returns the number of failed checks.
+ */
+int main(int argc, char* args[])
+{
+    std::vector<TestCase>* cases = &get_tests();
+    const char* filter = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--bench") == 0)
+        {
+            cases = &get_benchmarks();
+        }
+        else
+        {
+            filter = args[i];
+        }
+    }
+
+    uint32_t run_count = 0;
+    for (const TestCase& test : *cases)
+    {
+        if (filter && !strstr(test.name, filter))
+        {
+            continue;
+        }
+
+        const uint32_t failures_before = failure_count;
+        test.function();
+        run_count++;
+
+        std::cout << (failure_count == failures_before ? "[ ok ] " : "[FAIL] ")
+                  << test.name << "\n";
+    }
+
+    std::cout << run_count << " run, " << failure_count.load()
+              << " failed checks\n";
+    return (int)failure_count.load();
+}
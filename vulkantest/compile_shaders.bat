@@ -0,0 +1,36 @@
+@echo off
+rem Compiles the GLSL shaders in shaders\ to SPIR-V in shaders\spirv\. Visual
+rem Studio runs it from the project directory before every build. It needs
+rem glslc from the Vulkan SDK. The SPIR-V is checked in, so commit whatever
+rem it regenerates after a shader changes.
+
+setlocal
+if not defined VULKAN_SDK set VULKAN_SDK=C:\VulkanSDK\1.3.239.0
+set GLSLC="%VULKAN_SDK%\Bin\glslc.exe"
+set OUT=shaders\spirv
+
+if not exist %GLSLC% (
+    echo compile_shaders: %GLSLC% not found, install the Vulkan SDK or set VULKAN_SDK 1>&2
+    exit /b 1
+)
+
+if not exist %OUT% mkdir %OUT%
+
+call :compile tri_vert.vert tri_vert || exit /b 1
+call :compile tri_frag.frag tri_frag || exit /b 1
+call :compile rainbow_tri_vert.vert rainbow_tri_vert || exit /b 1
+call :compile rainbow_tri_frag.frag rainbow_tri_frag || exit /b 1
+call :compile default_lit.frag default_lit || exit /b 1
+call :compile tri_mesh.vert tri_mesh || exit /b 1
+
+rem The quantized vertex layout is a variant of the same shader
+call :compile tri_mesh.vert tri_mesh_packed -DPACKED_VERTICES || exit /b 1
+
+call :compile cull_meshlets.comp cull_meshlets || exit /b 1
+
+exit /b 0
+
+rem Usage: compile <source in shaders\> <output name> [glslc options]
+:compile
+%GLSLC% --target-env=vulkan1.3 %3 shaders\%1 -o %OUT%\%2.spv
+exit /b %errorlevel%
@@ -1,6 +1,10 @@
 #version 460
 
+// Must match MAX_TEXTURES in src/Texture/TextureCache.h
+#define MAX_TEXTURES 256
+
 layout (location = 0) in vec3 color;
+layout (location = 1) in vec2 texcoord;
 layout (location = 0) out vec4 out_fcolor;
 
 layout(set = 0, binding = 1) uniform SceneData {
@@ -11,7 +15,30 @@ layout(set = 0, binding = 1) uniform SceneData {
 	vec4 sunlight_color;
 } scene_data;
 
+struct MaterialData
+{
+	vec4 base_color;
+	uint texture_index;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+} material_buffer;
+
+// Every texture slot is valid, unloaded ones hold a white texture
+layout(set = 2, binding = 1) uniform sampler2D textures[MAX_TEXTURES];
+
+layout(push_constant) uniform DrawConstants
+{
+	uint material_index;
+} draw;
+
 void main()
 {
-	out_fcolor = vec4(color + scene_data.ambient_color.xyz, 1.0f);
-}
\ No newline at end of file
+	MaterialData material = material_buffer.materials[draw.material_index];
+	vec4 albedo =
+		material.base_color * texture(textures[material.texture_index], texcoord);
+
+	out_fcolor = vec4(color * albedo.rgb + scene_data.ambient_color.xyz, 1.0f);
+}
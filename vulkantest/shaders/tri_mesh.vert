@@ -1,10 +1,19 @@
 #version 460
 
+// Compile with PACKED_VERTICES defined (spirv/tri_mesh_packed.spv) for the
+// quantized PackedVertex layout
+
 // Vertex shader inputs
+#ifdef PACKED_VERTICES
+layout(location = 0) in vec4 position; // snorm16, relative to the mesh bounds
+layout(location = 1) in vec2 texcoord; // unorm16, relative to the uv bounds
+layout(location = 2) in vec2 normal;   // snorm16, octahedral
+#else
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 texcoord;
+layout(location = 1) in vec2 texcoord;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec3 color;
+#endif
 
 layout(set = 0, binding = 0) uniform CameraMatrices
 {
@@ -14,6 +23,9 @@ layout(set = 0, binding = 0) uniform CameraMatrices
 struct ObjectData
 {
     mat4 transform;
+    vec4 position_scale;
+    vec4 position_offset;
+    vec4 texcoord_scale_offset; // xy = scale, zw = offset
 };
 
 // Transforms of the models coming in
@@ -23,14 +35,45 @@ layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer
 } object_buffer;
 
 layout(location = 0) out vec3 out_color;
+layout(location = 1) out vec2 out_texcoord;
+
+#ifdef PACKED_VERTICES
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+#endif
 
 void main()
 {
+    ObjectData object = object_buffer.objects[gl_BaseInstance];
+
     // Concatenate model and VP matrices into MVP matrix
-    mat4 model_matrix = object_buffer.objects[gl_BaseInstance].transform;
+    mat4 model_matrix = object.transform;
     mat4 modelviewprojection = (camera_data.vp_matrix * model_matrix);
 
+#ifdef PACKED_VERTICES
+    // Dequantize the vertex back into model space
+    vec3 model_position =
+        position.xyz * object.position_scale.xyz + object.position_offset.xyz;
+    vec2 model_texcoord = texcoord * object.texcoord_scale_offset.xy
+        + object.texcoord_scale_offset.zw;
+    vec3 model_normal = oct_decode(normal);
+    vec3 model_color = vec3(1.0f);
+#else
+    vec3 model_position = position;
+    vec2 model_texcoord = texcoord;
+    vec3 model_color = color;
+#endif
+
     // Transform vertex from local space to clip space with MVP matrix
-    gl_Position = modelviewprojection * vec4(position, 1.0f);
-    out_color = color;
-}
\ No newline at end of file
+    gl_Position = modelviewprojection * vec4(model_position, 1.0f);
+    out_color = model_color;
+
+    // OBJ texture coordinates start at the bottom of the image
+    out_texcoord = vec2(model_texcoord.x, 1.0f - model_texcoord.y);
+}
@@ -1,7 +1,11 @@
 #include "Application.h"
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <span>
 #include <string>
 #include <stdexcept>
 
@@ -10,6 +14,8 @@
 #include <SDL2/SDL_vulkan.h>
 #include <vk-bootstrap/VkBootstrap.h>
 
+#include "Model/Meshlet.h"
+#include "Utils/ThreadPool.h"
 #include "Utils/string_ops.h"
 #include "VulkanRenderer/PipelineBuilder.h"
 #include "VulkanRenderer/vkinit.h"
@@ -39,6 +45,8 @@ void Application::setup()
 
 void Application::input()
 {
+    input_time = std::chrono::steady_clock::now();
+
     SDL_Event event;
 
     // Handling core SDL events (moving the mouse, closing the window, etc.)
@@ -142,6 +150,44 @@ void Application::input()
                     camera.set_move_state(UP, true);
                     break;
                 }
+                // Switching present modes, which the render thread picks up
+                // by recreating the swapchain
+                if (event.key.keysym.sym == SDLK_F1)
+                {
+                    present_mode = VK_PRESENT_MODE_FIFO_KHR;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_F2)
+                {
+                    present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_F3)
+                {
+                    present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+                    break;
+                }
+                if (event.key.keysym.sym == SDLK_F4)
+                {
+                    present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                    break;
+                }
+                // Cycling how many frames the CPU may run ahead
+                if (event.key.keysym.sym == SDLK_F5)
+                {
+                    max_frames_ahead =
+                        max_frames_ahead.load() % NUM_OVERLAPPING_FRAMES + 1;
+                    std::cout << "Max frames ahead: "
+                              << max_frames_ahead.load() << "\n";
+                    break;
+                }
+                // Reloading the models after editing their files
+                if (event.key.keysym.sym == SDLK_F6)
+                {
+                    std::cout << "Reloading models\n";
+                    reload_models();
+                    break;
+                }
                 break;
             }
             case SDL_KEYUP:
@@ -186,49 +232,299 @@ void Application::update()
 {
     camera.update();
 
-    for (const std::shared_ptr<Model>& model : models)
+    // Models don't depend on each other, so they're updated in parallel
+    const std::span<Model> scene_models = models.get_items();
+    const float rot = (float)simulation_step * 0.005f;
+
+    get_frame_pool().parallel_for_range(scene_models.size(), MODELS_PER_JOB,
+        [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                scene_models[i].rotation.y = rot;
+                scene_models[i].update();
+            }
+        }
+    );
+}
+
+void Application::publish_frame_packet()
+{
+    FramePacket& packet = frame_packets.get_back();
+    packet.step = simulation_step;
+    packet.input_time = input_time;
+    packet.vp_matrix = camera.vp_matrix;
+    packet.camera_position = camera.position;
+
+    // Test code that changes the ambient color
+    const float frame_delta = (float)simulation_step / 120.0f;
+
+    context.scene_data.ambient_color = {
+        sinf(frame_delta), 0.0f, cosf(frame_delta), 1.0f
+    };
+    packet.scene_data = context.scene_data;
+
+    // Every model needs a slot in the object buffer, so the models past the
+    // last one are left out
+    const std::span<const Model> all_models = models.get_items();
+    const std::span<const Model> scene_models =
+        all_models.first(std::min<size_t>(all_models.size(), MAX_OBJECTS));
+    const size_t dropped_objects = all_models.size() - scene_models.size();
+
+    // Every model's object data and draws go in ranges of their own, so the
+    // ranges are laid out first and then filled in parallel
+    first_draws.resize(scene_models.size() + 1);
+    first_draws[0] = 0;
+    for (size_t i = 0; i < scene_models.size(); i++)
+    {
+        // Models that weren't imported are drawn whole
+        first_draws[i + 1] = first_draws[i]
+            + std::max<size_t>(scene_models[i].submeshes.size(), 1);
+    }
+    packet.objects.resize(scene_models.size());
+    packet.draws.resize(first_draws.back());
+
+    // Draw every submesh with its material, at a level of detail picked from
+    // its size on screen
+    get_frame_pool().parallel_for_range(scene_models.size(), MODELS_PER_JOB,
+        [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                const Model& model = scene_models[i];
+                const QuantizationParams& quantization = model.quantization;
+
+                packet.objects[i] = {
+                    .model_matrix = model.transform,
+                    .position_scale =
+                        glm::vec4(quantization.position_scale, 0.0f),
+                    .position_offset =
+                        glm::vec4(quantization.position_offset, 0.0f),
+                    .texcoord_scale_offset = glm::vec4(
+                        quantization.texcoord_scale,
+                        quantization.texcoord_offset)
+                };
+
+                MeshDraw draw = {
+                    .object_index = (uint32_t)i,
+                    .material_index = 0,
+                    .first_index = model.first_index,
+                    .vertex_offset = (int32_t)model.vertex_offset
+                };
+                MeshDraw* model_draws = packet.draws.data() + first_draws[i];
+
+                // Models that weren't imported are drawn with the default
+                // material
+                if (model.submeshes.empty())
+                {
+                    const Submesh whole = { .index_count = model.index_count };
+                    draw.lod = select_lod(model, whole);
+                    model_draws[0] = draw;
+                    continue;
+                }
+
+                for (size_t j = 0; j < model.submeshes.size(); j++)
+                {
+                    const Submesh& submesh = model.submeshes[j];
+                    draw.material_index =
+                        model.material_offset + submesh.material_index;
+                    draw.lod = select_lod(model, submesh);
+
+                    // Models without meshlets are drawn whole
+                    draw.first_meshlet =
+                        model.meshlet_offset + draw.lod.meshlet_offset;
+                    if (model.meshlet_count == 0)
+                    {
+                        draw.lod.meshlet_count = 0;
+                    }
+                    model_draws[j] = draw;
+                }
+            }
+        }
+    );
+
+    // Every draw needs a slot in the draw count buffer
+    const size_t draw_count = packet.draws.size();
+    packet.draws.resize(std::min<size_t>(draw_count, MAX_DRAWS));
+    const size_t dropped_draws = draw_count - packet.draws.size();
+
+    // Said once whenever the amount left out changes, not every step
+    if (dropped_objects != dropped_object_count)
+    {
+        dropped_object_count = dropped_objects;
+        if (dropped_objects > 0)
+        {
+            std::cerr << "Out of object slots, " << dropped_objects
+                      << " models will not be drawn.\n";
+        }
+    }
+    if (dropped_draws != dropped_draw_count)
+    {
+        dropped_draw_count = dropped_draws;
+        if (dropped_draws > 0)
+        {
+            std::cerr << "Out of draw slots, " << dropped_draws
+                      << " submeshes will not be drawn.\n";
+        }
+    }
+
+    // The models in the packet joined the scene once their uploads retired,
+    // so the frame waits on those and acquires them. The acquires are handed
+    // over ahead of the packet, and in order, since the packet may be skipped
+    packet.upload_value = upload_context.batcher.get_retired_value();
+    UploadHandoff handoff = {
+        .value = packet.upload_value,
+        .acquires = upload_context.batcher.take_acquires(),
+        .resident_textures = std::move(upload_context.resident_textures)
+    };
+    upload_context.resident_textures.clear();
+    if (!handoff.acquires.empty() || !handoff.resident_textures.empty())
     {
-        float rot = (float)current_frame * 0.005f;
-        model->rotation.y = rot;
-        model->update();
+        upload_handoffs.push(std::move(handoff));
     }
+
+    frame_packets.publish();
 }
 
 constexpr uint64_t TIMEOUT_PERIOD = UINT64_MAX;
 
-void Application::render()
+/** Share of a heap's budget past which memory use is warned about */
+constexpr float MEMORY_BUDGET_WARNING = 0.9f;
+
+const char* const MEMORY_REPORT_PATH = "memory_report.json";
+
+static VkFormat get_texture_vk_format(ETextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1:
+            return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case TEXTURE_FORMAT_BC3:
+            return VK_FORMAT_BC3_SRGB_BLOCK;
+        case TEXTURE_FORMAT_BC7:
+            return VK_FORMAT_BC7_SRGB_BLOCK;
+        default:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+    }
+}
+
+void Application::render_loop()
+{
+    bool has_packet = false;
+
+    while (rendering.load(std::memory_order_relaxed))
+    {
+        // Hold back until the display has caught up enough, so the packet
+        // taken next is as recent as can be
+        limit_latency();
+
+        // Draw the latest packet, or the last one again when the simulation
+        // hasn't published another since
+        has_packet |= frame_packets.acquire();
+        if (!has_packet)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Frames are skipped while there's no swapchain to present to, such
+        // as when the window is minimized
+        if (render(frame_packets.get_front()))
+        {
+            current_frame++;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool Application::render(FramePacket& packet)
 {
     // Get current frame data
-    const PerFrame& frame = get_current_frame();
+    PerFrame& frame = get_current_frame();
 
-    // Wait until the GPU has finished rendering, looping in case it takes
-    // longer than expected
-    VkResult result;
-    do
+    // The frame's resources are free once the GPU has completed the last
+    // frame that used them
+    const uint64_t frame_number = current_frame + 1;
+    if (frame_number > (uint64_t)NUM_OVERLAPPING_FRAMES)
     {
-        result = vkWaitForFences(
-            context.device, 
-            1, 
-            &frame.queue_submit_fence,
-            true, 
-            TIMEOUT_PERIOD
-        );
-    } while (result == VK_TIMEOUT);
-    VK_CHECK(vkResetFences(context.device, 1, &frame.queue_submit_fence));
+        wait_for_frame(frame_number - (uint64_t)NUM_OVERLAPPING_FRAMES);
+    }
+
+    // Every upload handed over before the packet was published is taken,
+    // including those of packets that were skipped. Texture slots that became
+    // resident are written to every frame's set, each once it's no longer in
+    // use, and the acquires wait for the next frame recorded
+    if (upload_handoffs.drain(drained_handoffs))
+    {
+        for (const UploadHandoff& handoff : drained_handoffs)
+        {
+            pending_acquires.append(handoff.acquires);
+            pending_upload_value =
+                std::max(pending_upload_value, handoff.value);
+
+            for (PerFrame& other_frame : context.frames)
+            {
+                other_frame.pending_textures.insert(
+                    other_frame.pending_textures.end(),
+                    handoff.resident_textures.begin(),
+                    handoff.resident_textures.end());
+            }
+        }
+        drained_handoffs.clear();
+    }
+
+    // The frame's descriptor sets are no longer in use
+    update_texture_descriptors(frame);
+
+    // Nor are the resources released before the frames completed so far
+    collect_releases(get_completed_frame());
+
+    // A present mode switch takes a new swapchain
+    if (present_mode.load() != context.requested_present_mode
+        && !recreate_swapchain())
+    {
+        return false;
+    }
 
-    // Request an image from swapchain
+    // Request an image from swapchain. An out of date swapchain can't be
+    // presented to anymore, so the frame is skipped until it's recreated
     uint32_t swapchain_image_index;
-    VK_CHECK(vkAcquireNextImageKHR(
+    VkResult result = vkAcquireNextImageKHR(
         context.device,
         context.swapchain,
         TIMEOUT_PERIOD,
         frame.swapchain_acquire_semaphore,
         nullptr, 
-        &swapchain_image_index)
+        &swapchain_image_index
     );
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        recreate_swapchain();
+        return false;
+    }
+
+    // A suboptimal swapchain can still be presented to, so it's replaced
+    // after this frame
+    bool swapchain_stale = result == VK_SUBOPTIMAL_KHR;
+    if (!swapchain_stale)
+    {
+        VK_CHECK(result);
+    }
+
+    update_memory_snapshot();
+
+    frame.number = frame_number;
+    frame.input_time = packet.input_time;
 
     // Clear all command buffers
     VK_CHECK(vkResetCommandPool(context.device, frame.primary_command_pool, 0));
+    for (VkCommandPool pool : frame.secondary_command_pools)
+    {
+        VK_CHECK(vkResetCommandPool(context.device, pool, 0));
+    }
 
     // Start recording commands into the command buffer
     const VkCommandBufferBeginInfo cmd_buf_begin_info = {
@@ -242,6 +538,38 @@ void Application::render()
         &cmd_buf_begin_info)
     );
 
+    // The GPU timings of the frame's previous use are in, since it has
+    // completed
+    GpuProfiler& profiler = context.gpu_profiler;
+    profiler.begin_frame(frame.primary_command_buffer, frame.queries);
+    if (gpu_report_interval != 0 && current_frame > 0
+        && current_frame % gpu_report_interval == 0)
+    {
+        std::cout << format_gpu_scope_stats(profiler.get_stats());
+    }
+    const uint32_t frame_query = profiler.begin_scope(
+        frame.primary_command_buffer, frame.queries, "frame");
+
+    // Take ownership of whatever the transfer queue uploaded for the models
+    // and textures that joined the scene since the last frame recorded
+    const uint32_t acquire_query = profiler.begin_scope(
+        frame.primary_command_buffer, frame.queries, "upload acquires");
+    pending_acquires.record(frame.primary_command_buffer);
+    pending_acquires.clear();
+    profiler.end_scope(
+        frame.primary_command_buffer, frame.queries, acquire_query);
+
+    // Cull meshlets into this frame's indirect draws before the render pass
+    if (meshlet_culling)
+    {
+        const uint32_t cull_query = profiler.begin_scope(
+            frame.primary_command_buffer, frame.queries, "meshlet culling",
+            true);
+        cull_meshlets(frame.primary_command_buffer, frame, packet);
+        profiler.end_scope(
+            frame.primary_command_buffer, frame.queries, cull_query);
+    }
+
     // Set color clear value
     VkClearValue color_clear_value;
     //float flash = fabsf(sinf((float)current_frame / 120.f));
@@ -262,161 +590,191 @@ void Application::render()
         .pNext = nullptr,
         .renderPass = context.render_pass,
         .framebuffer = context.framebuffers[swapchain_image_index],
-        .renderArea = window->scissor,
+        .renderArea = { { 0, 0 }, context.swapchain_extent },
         .clearValueCount = (uint32_t)clear_values.size(),
         .pClearValues = &clear_values.data()[0]
     };
-    vkCmdBeginRenderPass(
-        frame.primary_command_buffer,
-        &render_pass_begin_info,
-        VK_SUBPASS_CONTENTS_INLINE
-    );
-
-    // Bind pipeline to the command buffer
-    vkCmdBindPipeline(
-        frame.primary_command_buffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        context.pipeline
-    );
 
-    // Bind descriptor sets to pipeline
-    const int frame_index = current_frame % NUM_OVERLAPPING_FRAMES;
+    // The frame's slot of the scene data uniform buffer
+    const int frame_index = (int)(current_frame % NUM_OVERLAPPING_FRAMES);
     const uint32_t uniform_offset =
         (uint32_t)pad_uniform_buffer_size(sizeof(Scene)) * frame_index;
 
-    vkCmdBindDescriptorSets(
-        frame.primary_command_buffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        context.pipeline_layout,
-        0, 
-        1, 
-        &frame.global_descriptor_set,
-        1, 
-        &uniform_offset
-    );
-
-    // Test code that changes the ambient color
-    const float frame_delta = (float)current_frame / 120.0f;
-
-    context.scene_data.ambient_color = {
-        sinf(frame_delta), 0.0f, cosf(frame_delta), 1.0f
-    };
-
-    // Copy scene data into uniform buffer
-    char* scene_data;
-    vmaMapMemory(
-        context.allocator, 
-        context.scene_data_buffer.allocation,
-        reinterpret_cast<void **>(&scene_data)
-    );
-
-    scene_data += uniform_offset;
-
-    memcpy(scene_data, &context.scene_data, sizeof(Scene));
-
-    vmaUnmapMemory(context.allocator, context.scene_data_buffer.allocation);
+    // Copy scene data into the frame's slot of the uniform buffer. The
+    // per-frame buffers stay mapped, so these are plain writes
+    char* scene_data =
+        static_cast<char*>(context.scene_data_buffer.mapped_data);
+    memcpy(scene_data + uniform_offset, &packet.scene_data, sizeof(Scene));
+    flush_mapped_buffer(
+        context.scene_data_buffer, uniform_offset, sizeof(Scene));
 
     // Copy VP matrix into the uniform buffer
-    void* data;
-    vmaMapMemory(
-        context.allocator, 
-        frame.global_uniform_buffer.allocation, 
-        &data
+    memcpy(frame.global_uniform_buffer.mapped_data, &packet.vp_matrix,
+        sizeof(glm::mat4));
+    flush_mapped_buffer(frame.global_uniform_buffer, 0, sizeof(glm::mat4));
+
+    // Copy object data into the object storage buffer through its mapping
+    memcpy(frame.object_storage_buffer.mapped_data, packet.objects.data(),
+        packet.objects.size() * sizeof(GPUObjectData));
+    flush_mapped_buffer(frame.object_storage_buffer, 0,
+        packet.objects.size() * sizeof(GPUObjectData));
+
+    // The draws are recorded into secondary command buffers, which is all
+    // the render pass holds. Its queries go around it for that reason
+    const uint32_t render_pass_query = profiler.begin_scope(
+        frame.primary_command_buffer, frame.queries, "render pass", true);
+    vkCmdBeginRenderPass(
+        frame.primary_command_buffer,
+        &render_pass_begin_info,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
     );
 
-    memcpy(data, &camera.vp_matrix, sizeof(glm::mat4));
-
-    vmaUnmapMemory(context.allocator, frame.global_uniform_buffer.allocation);
-
-    // Write into object shader storage buffer by mapping the memory and casting
-    void* object_data;
-    vmaMapMemory(
-        context.allocator, 
-        frame.object_storage_buffer.allocation,
-        &object_data
+    // Split the draws into even shares across the frame pool, leaving
+    // small frames to fewer threads
+    const size_t draw_count = packet.draws.size();
+    const size_t max_shares = frame.secondary_command_buffers.size();
+    const size_t share_count = std::min(max_shares,
+        (draw_count + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY);
+    const size_t share_size =
+        share_count > 0 ? (draw_count + share_count - 1) / share_count : 0;
+    const VkFramebuffer framebuffer =
+        context.framebuffers[swapchain_image_index];
+
+    get_frame_pool().parallel_for(share_count,
+        [&](size_t share)
+        {
+            const size_t first_draw = std::min(draw_count, share * share_size);
+            const size_t last_draw =
+                std::min(draw_count, first_draw + share_size);
+            record_draws(frame.secondary_command_buffers[share], frame, packet,
+                framebuffer, uniform_offset, first_draw, last_draw);
+        }
     );
 
-    GPUObjectData *object_SSBO = reinterpret_cast<GPUObjectData *>(object_data);
-
-    for (size_t i = 0; i < models.size(); i++)
+    if (share_count > 0)
     {
-        object_SSBO[i].model_matrix = models[i]->transform;
-    }
-
-    vmaUnmapMemory(context.allocator, frame.object_storage_buffer.allocation);
-
-    // Bind object descriptor set to pipline
-    vkCmdBindDescriptorSets(
-        frame.primary_command_buffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        context.pipeline_layout,
-        1,
-        1,
-        &frame.object_descriptor_set,
-        0,
-        nullptr
-    );
-
-    // Loop over all models in the scene
-    for (size_t i = 0; i < models.size(); i++)
-    {
-        // Bind vertex buffer to the command buffer with an offset of zero
-        const VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(
-            frame.primary_command_buffer, 
-            0, 
-            1,
-            &models[i]->vertex_buffer.buffer, 
-            &offset
-        );
-
-        // Draw the model
-        vkCmdDraw(
+        vkCmdExecuteCommands(
             frame.primary_command_buffer,
-            (uint32_t)models[i]->vertices.size(), 
-            1, 
-            0, 
-            (uint32_t)i
+            (uint32_t)share_count,
+            frame.secondary_command_buffers.data()
         );
     }
 
     // Finalize render stage commands
     vkCmdEndRenderPass(frame.primary_command_buffer);
+    profiler.end_scope(
+        frame.primary_command_buffer, frame.queries, render_pass_query);
+    profiler.end_scope(
+        frame.primary_command_buffer, frame.queries, frame_query);
     VK_CHECK(vkEndCommandBuffer(frame.primary_command_buffer));
 
-    // Submit command buffer to the graphics queue
-    const VkPipelineStageFlags wait_stage =
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Submit command buffer to the graphics queue. Besides the swapchain
+    // image, it waits on every upload the scene uses. They have already
+    // retired, so the wait only orders their ownership transfers
+    const std::array<VkSemaphore, 2> wait_semaphores = {
+        frame.swapchain_acquire_semaphore,
+        upload_context.batcher.get_semaphore()
+    };
+    const std::array<VkPipelineStageFlags, 2> wait_stages = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+    };
+    const std::array<uint64_t, 2> wait_values = {
+        0, // binary
+        std::max(packet.upload_value, pending_upload_value)
+    };
+
+    // Presenting needs a binary semaphore, and the frame semaphore tells
+    // when the frame has completed
+    const std::array<VkSemaphore, 2> signal_semaphores = {
+        frame.swapchain_release_semaphore,
+        context.frame_semaphore
+    };
+    const std::array<uint64_t, 2> signal_values = {
+        0, // binary
+        frame_number
+    };
+
+    const VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreValueCount = (uint32_t)wait_values.size(),
+        .pWaitSemaphoreValues = wait_values.data(),
+        .signalSemaphoreValueCount = (uint32_t)signal_values.size(),
+        .pSignalSemaphoreValues = signal_values.data()
+    };
 
     const VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &frame.swapchain_acquire_semaphore,
-        .pWaitDstStageMask = &wait_stage,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = (uint32_t)wait_semaphores.size(),
+        .pWaitSemaphores = wait_semaphores.data(),
+        .pWaitDstStageMask = wait_stages.data(),
         .commandBufferCount = 1,
         .pCommandBuffers = &frame.primary_command_buffer,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &frame.swapchain_release_semaphore
-    };
-    VK_CHECK(vkQueueSubmit(
-        context.queue, 
-        1, 
-        &submit_info, 
-        frame.queue_submit_fence)
-    );
+        .signalSemaphoreCount = (uint32_t)signal_semaphores.size(),
+        .pSignalSemaphores = signal_semaphores.data()
+    };
+    {
+        // Uploads may be submitted to the same queue from the simulation
+        // thread
+        std::lock_guard<std::mutex> lock(context.queue_mutex);
+        VK_CHECK(vkQueueSubmit(
+            context.queue, 
+            1, 
+            &submit_info, 
+            nullptr)
+        );
+    }
+
+    // This frame is the first to draw without the packet's releases, so they
+    // wait for the frame before it
+    for (std::function<void()>& deleter : packet.releases)
+    {
+        frame_releases.push_back({ current_frame, std::move(deleter) });
+    }
+    packet.releases.clear();
 
-    // Present image to the swap chain
+    // Present image to the swap chain. Frames are presented with their number
+    // as id, so the latency limiter can wait for them to be presented
+    const VkPresentIdKHR present_id = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = nullptr,
+        .swapchainCount = 1,
+        .pPresentIds = &frame_number
+    };
     const VkPresentInfoKHR present_info = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext = nullptr,
+        .pNext = context.wait_for_present ? &present_id : nullptr,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores = &frame.swapchain_release_semaphore,
         .swapchainCount = 1,
         .pSwapchains = &context.swapchain,
         .pImageIndices = &swapchain_image_index
     };
-    VK_CHECK(vkQueuePresentKHR(context.queue, &present_info));
+    {
+        std::lock_guard<std::mutex> lock(context.queue_mutex);
+        result = vkQueuePresentKHR(context.queue, &present_info);
+    }
+    if (context.swapchain_first_frame == 0)
+    {
+        context.swapchain_first_frame = frame_number;
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    {
+        swapchain_stale = true;
+    }
+    else
+    {
+        VK_CHECK(result);
+    }
+
+    if (swapchain_stale)
+    {
+        recreate_swapchain();
+    }
+
+    return true;
 }
 
 void Application::initialize()
@@ -446,9 +804,12 @@ void Application::initialize()
     init_default_renderpass();
     init_framebuffers();
     init_per_frames();
+    init_textures();
     init_descriptors();
+    init_geometry_buffers();
     //init_sync_objects();
     init_pipelines();
+    init_cull_pipeline();
 
     // Everything is successfully initialized and the application is running
     running = true;
@@ -458,14 +819,38 @@ void Application::run()
 {
     setup();
 
+    // Frames are recorded and submitted on a thread of their own, which
+    // draws whatever the simulation published last
+    rendering = true;
+    render_thread = std::thread([this]() { render_loop(); });
+
+    // The simulation stays on the main thread, which SDL's events have to be
+    // handled on
+    std::chrono::steady_clock::time_point next_step =
+        std::chrono::steady_clock::now();
     while (running)
     {
         input();
+        process_model_uploads();
         update();
-        render();
-        
-        current_frame++;
+        publish_frame_packet();
+
+        simulation_step++;
+
+        // Steps are taken at a fixed rate. After a hitch the simulation
+        // carries on from now rather than catching up
+        next_step += SIMULATION_STEP;
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        if (next_step < now)
+        {
+            next_step = now;
+        }
+        std::this_thread::sleep_until(next_step);
     }
+
+    rendering = false;
+    render_thread.join();
 }
 
 void Application::destroy()
@@ -478,15 +863,44 @@ void Application::destroy()
 
 void Application::destroy_vulkan_resources()
 {
+    // Let models that are still parsing finish. They were never uploaded, so
+    // there's nothing to free for them
+    for (ModelLoad& load : loading_models)
+    {
+        load.model.wait();
+    }
+    loading_models.clear();
+    texture_cache.wait_all();
+
     // Wait until the GPU is completely idle
     vkDeviceWaitIdle(context.device);
 
-    for (const std::shared_ptr<Model> &model : models)
+    // Retire the upload batches in flight before their buffers are freed
+    upload_context.batcher.wait();
+    finish_model_uploads();
+
+    // Nothing is in flight anymore, so released resources can go right away,
+    // including those of packets that were never drawn
+    collect_releases(UINT64_MAX);
+    for (FramePacket& packet : frame_packets.get_buffers())
+    {
+        for (std::function<void()>& deleter : packet.releases)
+        {
+            deleter();
+        }
+        packet.releases.clear();
+    }
+
+    // Model geometry goes with the shared buffers, in the deletion queue
+    for (const Texture& texture : texture_cache.get_textures())
     {
-        if (model->vertex_buffer.buffer)
+        if (texture.image.image)
         {
-            vmaDestroyBuffer(context.allocator, model->vertex_buffer.buffer,
-                model->vertex_buffer.allocation);
+            context.memory_tracker.untrack(
+                texture.image.allocation, MEMORY_CATEGORY_TEXTURES);
+            vkDestroyImageView(context.device, texture.view, nullptr);
+            vmaDestroyImage(context.allocator, texture.image.image,
+                texture.image.allocation);
         }
     }
     deletion_queue.flush();
@@ -527,10 +941,78 @@ void Application::init_instance()
     vkb::PhysicalDeviceSelector selector(vkb_inst);
     selector.set_minimum_version(1, 3);
     selector.set_surface(context.surface);
-    const vkb::PhysicalDevice vkb_gpu = selector.select().value();
+
+    // Meshlet culling draws with vkCmdDrawIndexedIndirectCount, passing the
+    // object index through firstInstance. Materials pick their texture from
+    // the texture array with an index read from the material buffer, and
+    // textures are cooked to BC formats
+    selector.set_required_features({
+        .multiDrawIndirect = VK_TRUE,
+        .drawIndirectFirstInstance = VK_TRUE,
+        .textureCompressionBC = VK_TRUE,
+        .shaderSampledImageArrayDynamicIndexing = VK_TRUE
+    });
+    // Uploads signal a timeline semaphore that frames wait on
+    selector.set_required_features_12({
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .drawIndirectCount = VK_TRUE,
+        .timelineSemaphore = VK_TRUE
+    });
+    // Lets the allocator report real heap budgets
+    selector.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    // Let the latency limiter wait for frames to be presented rather than
+    // only completed
+    selector.add_desired_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    selector.add_desired_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    vkb::PhysicalDevice vkb_gpu = selector.select().value();
 
     context.gpu = vkb_gpu.physical_device;
 
+    // GPU timings come with pipeline statistics when the device can gather
+    // them across secondary command buffers
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(context.gpu, &supported_features);
+    const bool pipeline_statistics_supported =
+        supported_features.pipelineStatisticsQuery
+        && supported_features.inheritedQueries;
+    if (pipeline_statistics_supported)
+    {
+        vkb_gpu.features.pipelineStatisticsQuery = VK_TRUE;
+        vkb_gpu.features.inheritedQueries = VK_TRUE;
+    }
+
+    const std::vector<std::string> gpu_extensions = vkb_gpu.get_extensions();
+    const auto has_extension = [&](const char* name)
+    {
+        return std::find(gpu_extensions.begin(), gpu_extensions.end(), name)
+            != gpu_extensions.end();
+    };
+    context.memory_budget_supported =
+        has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Present waits also need their features, which drivers may not have
+    // despite the extensions
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .pNext = nullptr
+    };
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = &present_wait_features
+    };
+    bool present_wait_supported = false;
+    if (has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+        && has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &present_id_features
+        };
+        vkGetPhysicalDeviceFeatures2(context.gpu, &features);
+        present_wait_supported = present_id_features.presentId
+            && present_wait_features.presentWait;
+    }
+
     // Create a Vulkan device for the selected GPU
     vkb::DeviceBuilder device_builder(vkb_gpu);
     VkPhysicalDeviceShaderDrawParametersFeatures
@@ -539,11 +1021,27 @@ void Application::init_instance()
             .pNext = nullptr,
             .shaderDrawParameters = VK_TRUE
     };
-    const vkb::Device vkb_device =
-        device_builder.add_pNext(&shader_draw_parameters_features).build().value();
+    device_builder.add_pNext(&shader_draw_parameters_features);
+    if (present_wait_supported)
+    {
+        device_builder.add_pNext(&present_id_features);
+        device_builder.add_pNext(&present_wait_features);
+    }
+    const vkb::Device vkb_device = device_builder.build().value();
 
     context.device = vkb_device.device;
 
+    // The loader doesn't export extension commands, so vkWaitForPresentKHR
+    // is looked up on the device
+    if (present_wait_supported)
+    {
+        context.wait_for_present = (PFN_vkWaitForPresentKHR)
+            vkGetDeviceProcAddr(context.device, "vkWaitForPresentKHR");
+    }
+    std::cout << "Latency limiter waits on "
+              << (context.wait_for_present ? "presents" : "frame completion")
+              << "\n";
+
     context.gpu_properties = vkb_device.physical_device.properties;
 
     std::cout << "GPU minimum buffer alignment: "
@@ -554,42 +1052,108 @@ void Application::init_instance()
     context.queue = vkb_device.get_queue(vkb::QueueType::graphics).value();
     context.graphics_queue_index =
         (int)vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+
+    // Upload on a transfer-only queue when the GPU has one, so copies run
+    // alongside rendering. Otherwise they share the graphics queue
+    const auto transfer_queue =
+        vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+    if (transfer_queue.has_value())
+    {
+        context.transfer_queue = transfer_queue.value();
+        context.transfer_queue_index = (int)vkb_device
+            .get_dedicated_queue_index(vkb::QueueType::transfer).value();
+    }
+    else
+    {
+        context.transfer_queue = context.queue;
+        context.transfer_queue_index = context.graphics_queue_index;
+    }
+
+    // Partial image copies must line up with the transfer queue's granularity
+    context.transfer_image_granularity = vkb_device
+        .queue_families[context.transfer_queue_index]
+        .minImageTransferGranularity;
+
+    context.gpu_profiler.init(
+        context.device,
+        context.gpu_properties.limits.timestampPeriod,
+        vkb_device.queue_families[context.graphics_queue_index]
+            .timestampValidBits,
+        pipeline_statistics_supported
+    );
 }
 
 void Application::init_allocator()
 {
+    // With VK_EXT_memory_budget, VMA reports what the driver estimates the
+    // process uses and may use of every heap, rather than guessing
     const VmaAllocatorCreateInfo allocator_create_info = {
+        .flags = context.memory_budget_supported
+            ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+            : 0u,
         .physicalDevice = context.gpu,
         .device = context.device,
-        .instance = context.instance
+        .instance = context.instance,
+        .vulkanApiVersion = VK_API_VERSION_1_3
     };
     VK_CHECK(vmaCreateAllocator(&allocator_create_info, &context.allocator));
 
+    context.memory_tracker.init(
+        context.allocator, context.memory_budget_supported);
+
     deletion_queue.push([&]() { vmaDestroyAllocator(context.allocator); });
 }
 
 void Application::init_swapchain()
 {
-    // Create a swapchain
+    create_swapchain();
+
+    deletion_queue.push(
+        [=]()
+        {
+            destroy_swapchain_images();
+            vkDestroySwapchainKHR(context.device, context.swapchain, nullptr);
+        }
+    );
+}
+
+void Application::create_swapchain()
+{
+    // Create a swapchain. Every surface supports FIFO, so that's what's used
+    // when the mode asked for isn't
+    context.requested_present_mode = present_mode.load();
+
+    const VkSwapchainKHR old_swapchain = context.swapchain;
     vkb::SwapchainBuilder builder(context.gpu, context.device, context.surface);
     builder.use_default_format_selection();
-    builder.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR); // use vsync
+    builder.set_desired_present_mode(context.requested_present_mode);
+    builder.add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);
     builder.set_desired_min_image_count(vkb::SwapchainBuilder::TRIPLE_BUFFERING);
     builder.set_desired_extent(window->extent.width, window->extent.height);
+    builder.set_old_swapchain(old_swapchain);
     vkb::Swapchain vkbSwapchain = builder.build().value();
 
-    context.swapchain = vkbSwapchain.swapchain;
-    context.image_format = vkbSwapchain.image_format;
+    // The old swapchain is retired by the new one, and nothing uses its
+    // images anymore
+    if (old_swapchain)
+    {
+        vkDestroySwapchainKHR(context.device, old_swapchain, nullptr);
+    }
+
+    context.swapchain = vkbSwapchain.swapchain;
+    context.swapchain_first_frame = 0;
+    context.image_format = vkbSwapchain.image_format;
+    context.swapchain_extent = vkbSwapchain.extent;
+    context.present_mode = vkbSwapchain.present_mode;
     context.swapchain_image_views = vkbSwapchain.get_image_views().value();
 
-    deletion_queue.push([=]()
-        { vkDestroySwapchainKHR(context.device, context.swapchain, nullptr); }
-    );
+    std::cout << "Present mode: "
+              << get_present_mode_name(context.present_mode) << "\n";
 
     // Configure the depth image
     const VkExtent3D depth_image_extent = {
-        .width = window->extent.width,
-        .height = window->extent.height,
+        .width = context.swapchain_extent.width,
+        .height = context.swapchain_extent.height,
         .depth = 1
     };
 
@@ -614,6 +1178,8 @@ void Application::init_swapchain()
         &context.depth_image.allocation,
         nullptr)
     );
+    context.memory_tracker.track(
+        context.depth_image.allocation, MEMORY_CATEGORY_ATTACHMENTS);
 
     // Create depth image view
     const VkImageViewCreateInfo image_view_create_info =
@@ -629,16 +1195,50 @@ void Application::init_swapchain()
         nullptr, 
         &context.depth_image_view)
     );
+}
 
-    deletion_queue.push(
-        [=]()
-        {
-            vkDestroyImageView(
-                context.device, context.depth_image_view, nullptr);
-            vmaDestroyImage(context.allocator, context.depth_image.image,
-                context.depth_image.allocation);
-        }
-    );
+void Application::destroy_swapchain_images()
+{
+    for (VkImageView image_view : context.swapchain_image_views)
+    {
+        vkDestroyImageView(context.device, image_view, nullptr);
+    }
+    context.swapchain_image_views.clear();
+
+    vkDestroyImageView(context.device, context.depth_image_view, nullptr);
+    context.memory_tracker.untrack(
+        context.depth_image.allocation, MEMORY_CATEGORY_ATTACHMENTS);
+    vmaDestroyImage(context.allocator, context.depth_image.image,
+        context.depth_image.allocation);
+}
+
+bool Application::recreate_swapchain()
+{
+    // A minimized window has no area to present to, so the swapchain is kept
+    // until it's restored
+    VkSurfaceCapabilitiesKHR capabilities;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+        context.gpu, context.surface, &capabilities));
+    if (capabilities.currentExtent.width == 0
+        || capabilities.currentExtent.height == 0)
+    {
+        return false;
+    }
+
+    // Presents signal nothing to wait on, so the queue is drained rather than
+    // waiting on the frame semaphore. The device and everything not sized
+    // after the swapchain stays as it is
+    {
+        std::lock_guard<std::mutex> lock(context.queue_mutex);
+        VK_CHECK(vkQueueWaitIdle(context.queue));
+    }
+
+    destroy_framebuffers();
+    destroy_swapchain_images();
+    create_swapchain();
+    create_framebuffers();
+
+    return true;
 }
 
 void Application::init_default_renderpass()
@@ -746,6 +1346,13 @@ void Application::init_default_renderpass()
 }
 
 void Application::init_framebuffers()
+{
+    create_framebuffers();
+
+    deletion_queue.push([=]() { destroy_framebuffers(); });
+}
+
+void Application::create_framebuffers()
 {
     // Create framebuffers for the swapchain images. This will connect the
     // render pass to the images for rendering
@@ -754,8 +1361,8 @@ void Application::init_framebuffers()
         .pNext = nullptr,
         .renderPass = context.render_pass,
         .attachmentCount = 1,
-        .width = window->extent.width,
-        .height = window->extent.height,
+        .width = context.swapchain_extent.width,
+        .height = context.swapchain_extent.height,
         .layers = 1
     };
 
@@ -779,18 +1386,16 @@ void Application::init_framebuffers()
             nullptr, 
             &context.framebuffers[i])
         );
+    }
+}
 
-
-        deletion_queue.push(
-            [=]()
-            {
-                vkDestroyFramebuffer(
-                    context.device, context.framebuffers[i], nullptr);
-                vkDestroyImageView(
-                    context.device, context.swapchain_image_views[i], nullptr);
-            }
-        );
+void Application::destroy_framebuffers()
+{
+    for (VkFramebuffer framebuffer : context.framebuffers)
+    {
+        vkDestroyFramebuffer(context.device, framebuffer, nullptr);
     }
+    context.framebuffers.clear();
 }
 
 VkShaderModule Application::load_shader_module(const char* filename) const
@@ -841,15 +1446,37 @@ void Application::init_per_frames()
         vkinit::command_pool_create_info(
             context.graphics_queue_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 
-    VkFenceCreateInfo fence_create_info =
-        vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
-
     const VkSemaphoreCreateInfo semaphore_create_info = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
         .pNext = nullptr,
         .flags = 0
     };
 
+    // Frames are paced by a single timeline semaphore rather than a fence
+    // each, which also counts the frames the GPU has completed
+    const VkSemaphoreTypeCreateInfo timeline_type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    const VkSemaphoreCreateInfo timeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &timeline_type_info,
+        .flags = 0
+    };
+    VK_CHECK(vkCreateSemaphore(context.device, &timeline_create_info,
+        nullptr, &context.frame_semaphore));
+
+    deletion_queue.push([=]()
+    {
+        vkDestroySemaphore(context.device, context.frame_semaphore, nullptr);
+    });
+
+    // Draws are recorded in as many shares as there are threads to record
+    // them, counting the one waiting on the rest
+    const uint32_t secondary_count = get_frame_pool().get_thread_count() + 1;
+
     // For each swapchain image
     for (PerFrame& frame : context.frames)
     {
@@ -864,9 +1491,26 @@ void Application::init_per_frames()
         VK_CHECK(vkAllocateCommandBuffers(context.device,
             &command_buffer_allocate_info, &frame.primary_command_buffer));
 
-        // Create a Vulkan fence
-        VK_CHECK(vkCreateFence(context.device, &fence_create_info, nullptr,
-            &frame.queue_submit_fence));
+        // Give every share of the draws a pool of its own, since a pool can
+        // only be used by one thread at a time
+        frame.secondary_command_pools.resize(secondary_count);
+        frame.secondary_command_buffers.resize(secondary_count);
+        for (uint32_t i = 0; i < secondary_count; i++)
+        {
+            VK_CHECK(vkCreateCommandPool(context.device,
+                &command_pool_create_info, nullptr,
+                &frame.secondary_command_pools[i]));
+
+            const VkCommandBufferAllocateInfo secondary_allocate_info =
+                vkinit::command_buffer_allocate_info(
+                    frame.secondary_command_pools[i], 1,
+                    VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+            VK_CHECK(vkAllocateCommandBuffers(context.device,
+                &secondary_allocate_info, &frame.secondary_command_buffers[i]));
+        }
+
+        context.gpu_profiler.init_frame(frame.queries);
 
         // Create semaphores to synchornize acquiring images from the swapchain
         VK_CHECK(vkCreateSemaphore(context.device, &semaphore_create_info,
@@ -879,53 +1523,30 @@ void Application::init_per_frames()
             {
                 vkDestroyCommandPool(
                     context.device, frame.primary_command_pool, nullptr);
-                vkDestroyFence(
-                    context.device, frame.queue_submit_fence, nullptr);
+                for (VkCommandPool pool : frame.secondary_command_pools)
+                {
+                    vkDestroyCommandPool(context.device, pool, nullptr);
+                }
                 vkDestroySemaphore(
                     context.device, frame.swapchain_acquire_semaphore, nullptr);
                 vkDestroySemaphore(
                     context.device, frame.swapchain_release_semaphore, nullptr);
+                context.gpu_profiler.destroy_frame(frame.queries);
             }
         );
     }
 
-    // Create fence for upload context
-    fence_create_info = vkinit::fence_create_info();
-    VK_CHECK(vkCreateFence(
-        context.device, 
-        &fence_create_info, 
-        nullptr,
-        &upload_context.upload_fence)
-    );
-
-    // Create command pool for upload context
-    command_pool_create_info =
-        vkinit::command_pool_create_info(context.graphics_queue_index);
-    VK_CHECK(vkCreateCommandPool(
-        context.device, 
-        &command_pool_create_info,
-        nullptr, 
-        &upload_context.command_pool)
-    );
-
-    // Allocate command buffer for upload context
-    const VkCommandBufferAllocateInfo alloc_info =
-        vkinit::command_buffer_allocate_info(upload_context.command_pool, 1);
-    VK_CHECK(vkAllocateCommandBuffers(
-        context.device, 
-        &alloc_info, 
-        &upload_context.command_buffer)
-    );
-
-    deletion_queue.push(
-        [=]()
-        {
-            vkDestroyFence(
-                context.device, upload_context.upload_fence, nullptr);
-            vkDestroyCommandPool(
-                context.device, upload_context.command_pool, nullptr);
-        }
-    );
+    // Uploads are made on the transfer queue for the graphics queue
+    upload_context.batcher.init(context.device, context.allocator,
+        context.transfer_queue, (uint32_t)context.transfer_queue_index,
+        (uint32_t)context.graphics_queue_index,
+        context.transfer_image_granularity, UPLOAD_STAGING_SIZE,
+        context.transfer_queue == context.queue ? &context.queue_mutex : nullptr);
+    context.memory_tracker.track(
+        upload_context.batcher.get_staging_allocation(),
+        MEMORY_CATEGORY_STAGING);
+
+    deletion_queue.push([=]() { upload_context.batcher.destroy(); });
 }
 
 void Application::init_descriptors()
@@ -934,7 +1555,9 @@ void Application::init_descriptors()
     const std::vector<VkDescriptorPoolSize> pool_sizes = {
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_DESCRIPTOR_SETS },
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, MAX_DESCRIPTOR_SETS },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_DESCRIPTOR_SETS },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_DESCRIPTOR_SETS * 4 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            MAX_TEXTURES * NUM_OVERLAPPING_FRAMES },
     };
 
     const VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
@@ -999,14 +1622,115 @@ void Application::init_descriptors()
         &context.object_descriptor_set_layout)
     );
 
+    // Create descriptor set layout for the meshlet culling pass: meshlets,
+    // objects, draw commands and draw counts
+    std::array<VkDescriptorSetLayoutBinding, 4> cull_bindings;
+    for (uint32_t i = 0; i < (uint32_t)cull_bindings.size(); i++)
+    {
+        cull_bindings[i] = vkinit::descriptorset_layout_binding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+    }
+
+    layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = (uint32_t)cull_bindings.size(),
+        .pBindings = cull_bindings.data()
+    };
+    VK_CHECK(vkCreateDescriptorSetLayout(
+        context.device,
+        &layout_info,
+        nullptr,
+        &context.cull_descriptor_set_layout)
+    );
+
+    // Create descriptor set layout for materials: the material buffer and the
+    // texture array
+    VkDescriptorSetLayoutBinding texture_binding =
+        vkinit::descriptorset_layout_binding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+    texture_binding.descriptorCount = MAX_TEXTURES;
+
+    const std::array<VkDescriptorSetLayoutBinding, 2> material_bindings = {
+        vkinit::descriptorset_layout_binding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+        texture_binding
+    };
+
+    layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = (uint32_t)material_bindings.size(),
+        .pBindings = material_bindings.data()
+    };
+    VK_CHECK(vkCreateDescriptorSetLayout(
+        context.device,
+        &layout_info,
+        nullptr,
+        &context.material_descriptor_set_layout)
+    );
+
+    // Create the material buffer, with the default material in slot 0
+    context.material_buffer = create_mapped_buffer(
+        sizeof(GPUMaterial) * MAX_MATERIALS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        MEMORY_CATEGORY_OTHER
+    );
+
+    GPUMaterial* materials =
+        static_cast<GPUMaterial*>(context.material_buffer.mapped_data);
+    materials[0] = {
+        .base_color = glm::vec4(1.0f),
+        .texture_index = DEFAULT_TEXTURE
+    };
+    flush_mapped_buffer(context.material_buffer, 0, sizeof(GPUMaterial));
+
+    // The default material is never freed, so it keeps slot 0
+    context.material_allocator.init(MAX_MATERIALS);
+    uint64_t default_material;
+    (void)context.material_allocator.allocate(1, default_material);
+
+    const VkDescriptorBufferInfo material_buffer_info = {
+        .buffer = context.material_buffer.buffer,
+        .offset = 0,
+        .range = sizeof(GPUMaterial) * MAX_MATERIALS
+    };
+
+    // Every texture slot starts out as the default texture
+    const VkDescriptorImageInfo default_texture_info = {
+        .sampler = context.texture_sampler,
+        .imageView = texture_cache.get(DEFAULT_TEXTURE).view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    std::vector<VkDescriptorImageInfo> texture_infos(
+        MAX_TEXTURES, default_texture_info);
+
+    // Create the meshlet buffer shared by every model
+    context.meshlet_buffer = create_buffer(
+        sizeof(Meshlet) * MAX_MESHLETS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MEMORY_CATEGORY_MESHES
+    );
+    context.meshlet_allocator.init(MAX_MESHLETS);
+
+    const VkDescriptorBufferInfo meshlet_buffer_info = {
+        .buffer = context.meshlet_buffer.buffer,
+        .offset = 0,
+        .range = sizeof(Meshlet) * MAX_MESHLETS
+    };
+
     // Create scene UBO
     const size_t scene_buffer_size =
         NUM_OVERLAPPING_FRAMES * pad_uniform_buffer_size(sizeof(Scene));
 
-    context.scene_data_buffer = create_buffer(
+    context.scene_data_buffer = create_mapped_buffer(
         scene_buffer_size,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-        VMA_MEMORY_USAGE_CPU_TO_GPU
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        MEMORY_CATEGORY_FRAME
     );
 
     VkDescriptorBufferInfo scene_buffer_info = {
@@ -1018,16 +1742,35 @@ void Application::init_descriptors()
     VkDescriptorSetAllocateInfo alloc_info;
     VkDescriptorBufferInfo global_buffer_info;
     VkDescriptorBufferInfo object_buffer_info;
-    std::array<VkWriteDescriptorSet, 3> descriptor_writes;
+    VkDescriptorBufferInfo draw_command_buffer_info;
+    VkDescriptorBufferInfo draw_count_buffer_info;
+    std::array<VkWriteDescriptorSet, 9> descriptor_writes;
     for (PerFrame& frame : context.frames)
     {
-        // Create global uniform buffer and object storage buffer
-        frame.global_uniform_buffer = create_buffer(sizeof(glm::mat4),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        // Create global uniform buffer and object storage buffer. They're
+        // rewritten every frame, so they stay mapped
+        frame.global_uniform_buffer = create_mapped_buffer(sizeof(glm::mat4),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MEMORY_CATEGORY_FRAME);
 
-        frame.object_storage_buffer = create_buffer(
+        frame.object_storage_buffer = create_mapped_buffer(
             sizeof(GPUObjectData) * MAX_OBJECTS,
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MEMORY_CATEGORY_FRAME);
+
+        // Create the indirect draw buffers the culling pass writes to
+        frame.draw_command_buffer = create_buffer(
+            sizeof(VkDrawIndexedIndirectCommand) * MAX_MESHLETS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY,
+            MEMORY_CATEGORY_FRAME
+        );
+
+        frame.draw_count_buffer = create_buffer(
+            sizeof(uint32_t) * MAX_DRAWS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY,
+            MEMORY_CATEGORY_FRAME
+        );
 
         // Allocate descriptor sets for the global uniform buffer and object
         // storage buffer
@@ -1055,6 +1798,30 @@ void Application::init_descriptors()
             &frame.object_descriptor_set)
         );
 
+        alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = context.descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &context.cull_descriptor_set_layout
+        };
+        VK_CHECK(vkAllocateDescriptorSets(
+            context.device,
+            &alloc_info,
+            &frame.cull_descriptor_set)
+        );
+
+        alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = context.descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &context.material_descriptor_set_layout
+        };
+        VK_CHECK(vkAllocateDescriptorSets(
+            context.device,
+            &alloc_info,
+            &frame.material_descriptor_set)
+        );
+
         // Bind buffer objects to their descriptor sets
         global_buffer_info = {
             .buffer = frame.global_uniform_buffer.buffer,
@@ -1068,6 +1835,18 @@ void Application::init_descriptors()
             .range = sizeof(GPUObjectData) * MAX_OBJECTS
         };
 
+        draw_command_buffer_info = {
+            .buffer = frame.draw_command_buffer.buffer,
+            .offset = 0,
+            .range = sizeof(VkDrawIndexedIndirectCommand) * MAX_MESHLETS
+        };
+
+        draw_count_buffer_info = {
+            .buffer = frame.draw_count_buffer.buffer,
+            .offset = 0,
+            .range = sizeof(uint32_t) * MAX_DRAWS
+        };
+
         descriptor_writes = {
             vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                 frame.global_descriptor_set, &global_buffer_info, 0),
@@ -1075,10 +1854,25 @@ void Application::init_descriptors()
                 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 frame.global_descriptor_set, &scene_buffer_info, 1),
             vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                frame.object_descriptor_set, &object_buffer_info, 0)
+                frame.object_descriptor_set, &object_buffer_info, 0),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                frame.cull_descriptor_set, &meshlet_buffer_info, 0),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                frame.cull_descriptor_set, &object_buffer_info, 1),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                frame.cull_descriptor_set, &draw_command_buffer_info, 2),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                frame.cull_descriptor_set, &draw_count_buffer_info, 3),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                frame.material_descriptor_set, &material_buffer_info, 0),
+            vkinit::write_descriptor_image(
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                frame.material_descriptor_set, texture_infos.data(), 1)
         };
-        vkUpdateDescriptorSets(
-            context.device, 3, descriptor_writes.data(), 0, nullptr);
+        descriptor_writes[8].descriptorCount = MAX_TEXTURES;
+        vkUpdateDescriptorSets(context.device,
+            (uint32_t)descriptor_writes.size(), descriptor_writes.data(), 0,
+            nullptr);
     }
 
     deletion_queue.push(
@@ -1087,10 +1881,20 @@ void Application::init_descriptors()
             vmaDestroyBuffer(context.allocator,
                 context.scene_data_buffer.buffer,
                 context.scene_data_buffer.allocation);
+            vmaDestroyBuffer(context.allocator,
+                context.meshlet_buffer.buffer,
+                context.meshlet_buffer.allocation);
+            vmaDestroyBuffer(context.allocator,
+                context.material_buffer.buffer,
+                context.material_buffer.allocation);
             vkDestroyDescriptorSetLayout(
                 context.device, context.global_descriptor_set_layout, nullptr);
             vkDestroyDescriptorSetLayout(
                 context.device, context.object_descriptor_set_layout, nullptr);
+            vkDestroyDescriptorSetLayout(
+                context.device, context.cull_descriptor_set_layout, nullptr);
+            vkDestroyDescriptorSetLayout(
+                context.device, context.material_descriptor_set_layout, nullptr);
             vkDestroyDescriptorPool(
                 context.device, context.descriptor_pool, nullptr);
 
@@ -1102,11 +1906,93 @@ void Application::init_descriptors()
                 vmaDestroyBuffer(context.allocator,
                     frame.global_uniform_buffer.buffer,
                     frame.global_uniform_buffer.allocation);
+                vmaDestroyBuffer(context.allocator,
+                    frame.draw_command_buffer.buffer,
+                    frame.draw_command_buffer.allocation);
+                vmaDestroyBuffer(context.allocator,
+                    frame.draw_count_buffer.buffer,
+                    frame.draw_count_buffer.allocation);
             }
         }
     );
 }
 
+void Application::update_memory_snapshot()
+{
+    // VMA refetches the budgets from the driver when the frame index changes
+    vmaSetCurrentFrameIndex(context.allocator, (uint32_t)current_frame);
+
+    const bool was_over_budget =
+        memory_snapshot.is_over_budget(MEMORY_BUDGET_WARNING);
+    memory_snapshot = context.memory_tracker.get_snapshot(current_frame);
+
+    // Warn as soon as a heap gets close to its budget, before the driver
+    // starts paging memory out
+    if (memory_snapshot.is_over_budget(MEMORY_BUDGET_WARNING)
+        && !was_over_budget)
+    {
+        std::cerr << "GPU memory use is near its budget:\n"
+                  << format_memory_snapshot(memory_snapshot);
+    }
+
+    if (memory_report_interval == 0
+        || current_frame % memory_report_interval != 0)
+    {
+        return;
+    }
+
+    std::cout << format_memory_snapshot(memory_snapshot);
+
+    // Written aside and moved over, so the report is always whole
+    const std::string temp_path = std::string(MEMORY_REPORT_PATH) + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file)
+        {
+            return;
+        }
+        file << memory_snapshot_to_json(memory_snapshot);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, MEMORY_REPORT_PATH, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+    }
+}
+
+void Application::init_geometry_buffers()
+{
+    // Every model uses the same vertex format, so the vertex buffer is
+    // allocated in whole vertices
+    context.vertex_buffer = create_buffer(
+        (size_t)MAX_VERTICES * get_vertex_size(vertex_format),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MEMORY_CATEGORY_MESHES
+    );
+    context.vertex_allocator.init(MAX_VERTICES);
+
+    context.index_buffer = create_buffer(
+        (size_t)MAX_INDICES * sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MEMORY_CATEGORY_MESHES
+    );
+    context.index_allocator.init(MAX_INDICES);
+
+    deletion_queue.push(
+        [&]()
+        {
+            vmaDestroyBuffer(context.allocator, context.vertex_buffer.buffer,
+                context.vertex_buffer.allocation);
+            vmaDestroyBuffer(context.allocator, context.index_buffer.buffer,
+                context.index_buffer.allocation);
+        }
+    );
+}
+
 void Application::init_pipelines()
 {
     // Set up shaders for pipeline
@@ -1115,8 +2001,11 @@ void Application::init_pipelines()
     VkPipelineShaderStageCreateInfo stage;
 
     // Load shaders for pipeline
-    // Vertex stage
-    module = load_shader_module("shaders/spirv/tri_mesh.spv");
+    // Vertex stage. Packed vertices use the variant of tri_mesh.vert compiled
+    // with PACKED_VERTICES defined
+    module = load_shader_module(vertex_format == VERTEX_FORMAT_PACKED
+        ? "shaders/spirv/tri_mesh_packed.spv"
+        : "shaders/spirv/tri_mesh.spv");
     stage = vkinit::shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, module);
     shader_stages.push_back(stage);
 
@@ -1126,19 +2015,30 @@ void Application::init_pipelines()
     shader_stages.push_back(stage);
 
     // Specify vertex input descriptors for pipeline
-    VertexInputDescription description = get_vertex_input_description();
+    VertexInputDescription description =
+        get_vertex_input_description(vertex_format);
 
     // Fill pipeline layout struct
     VkPipelineLayoutCreateInfo layout_info = vkinit::pipeline_layout_create_info();
 
     // Specify descriptor set layouts
-    std::array<VkDescriptorSetLayout, 2> set_layouts = {
+    std::array<VkDescriptorSetLayout, 3> set_layouts = {
         context.global_descriptor_set_layout,
         context.object_descriptor_set_layout,
+        context.material_descriptor_set_layout,
     };
-    layout_info.setLayoutCount = 2;
+    layout_info.setLayoutCount = (uint32_t)set_layouts.size();
     layout_info.pSetLayouts = set_layouts.data();
 
+    // The material of each draw is passed as a push constant
+    const VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(MaterialPushConstants)
+    };
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+
     // Create pipeline layout
     VK_CHECK(vkCreatePipelineLayout(
         context.device, 
@@ -1152,11 +2052,6 @@ void Application::init_pipelines()
         .shader_stages = shader_stages,
         .vertex_input = vkinit::vertex_input_state_create_info(description),
         .input_assembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
-        .viewport = { .x = 0.0f, .y = 0.0f,
-                      .width = (float)window->extent.width,
-                      .height = (float)window->extent.height,
-                      .minDepth = 0.0f, .maxDepth = 1.0f },
-        .scissor = window->scissor,
         .raster = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL),
         .blend_attachment = vkinit::color_blend_attachment_state(),
         .multisample = vkinit::multisample_state_create_info(),
@@ -1164,6 +2059,14 @@ void Application::init_pipelines()
         .pipeline_layout = context.pipeline_layout
     };
 
+    // Meshlet culling drops clusters that face away from the camera, so the
+    // rasterizer has to drop back faces too or whole clusters would vanish
+    // while their neighbours' back faces still show. Models are wound
+    // counter-clockwise, and the projection's flipped y keeps them that way
+    // on screen
+    builder.raster.cullMode = VK_CULL_MODE_BACK_BIT;
+    builder.raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
     // Build the pipeline
     builder.shader_stages = shader_stages;
     context.pipeline = builder.build_pipeline(context.device, context.render_pass);
@@ -1181,6 +2084,60 @@ void Application::init_pipelines()
     );
 }
 
+void Application::init_cull_pipeline()
+{
+    const VkShaderModule module =
+        load_shader_module("shaders/spirv/cull_meshlets.spv");
+
+    // The per-model parameters are passed as push constants
+    const VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(MeshletCullPushConstants)
+    };
+
+    VkPipelineLayoutCreateInfo layout_info = vkinit::pipeline_layout_create_info();
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &context.cull_descriptor_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+
+    VK_CHECK(vkCreatePipelineLayout(
+        context.device,
+        &layout_info,
+        nullptr,
+        &context.cull_pipeline_layout)
+    );
+
+    const VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .stage = vkinit::shader_stage_create_info(
+            VK_SHADER_STAGE_COMPUTE_BIT, module),
+        .layout = context.cull_pipeline_layout
+    };
+    VK_CHECK(vkCreateComputePipelines(
+        context.device,
+        nullptr,
+        1,
+        &pipeline_info,
+        nullptr,
+        &context.cull_pipeline)
+    );
+
+    vkDestroyShaderModule(context.device, module, nullptr);
+
+    deletion_queue.push(
+        [=]()
+        {
+            vkDestroyPipeline(context.device, context.cull_pipeline, nullptr);
+            vkDestroyPipelineLayout(
+                context.device, context.cull_pipeline_layout, nullptr);
+        }
+    );
+}
+
 void Application::load_models()
 {
     // Allocate memory for the triangle vertices
@@ -1193,135 +2150,967 @@ void Application::load_models()
     triangle.vertices[0].color = { 1.0f, 0.0f, 0.0f };
     triangle.vertices[1].color = { 0.0f, 1.0f, 0.0f };
     triangle.vertices[2].color = { 0.0f, 0.0f, 1.0f };
+    triangle.indices = { 0, 1, 2 };
 
-    std::shared_ptr<Model> koopa = create_model("assets/models/koopa/koopa.obj");
+    load_scene_model("assets/models/koopa/koopa.obj");
 
-    std::shared_ptr<Model> robot = create_model("assets/models/robot/robot.obj");
-    robot->translation = glm::vec3(0.0f, 30.0f, 0.0f);
+    load_scene_model("assets/models/robot/robot.obj", glm::vec3(0.0f),
+        glm::vec3(1.0f), glm::vec3(0.0f, 30.0f, 0.0f));
+}
 
-    upload_model(koopa);
-    upload_model(robot);
+void Application::load_scene_model(
+    const char* filename,
+    const glm::vec3& rotation,
+    const glm::vec3& scale,
+    const glm::vec3& translation
+)
+{
+    model_sources.push_back({ filename, rotation, scale, translation });
+    request_scene_model(model_sources.size() - 1);
 }
 
-Buffer Application::create_buffer(
-    size_t alloc_size,
-    VkBufferUsageFlags usage,
-    VmaMemoryUsage memory_usage
-) const
+void Application::reload_models()
 {
-    // Specify info about the buffer to create
-    const VkBufferCreateInfo buffer_info = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .pNext = nullptr,
-        .size = alloc_size,
-        .usage = usage
-    };
+    for (size_t i = 0; i < model_sources.size(); i++)
+    {
+        request_scene_model(i);
+    }
+}
 
-    // Set allocation properties for the buffer
-    const VmaAllocationCreateInfo alloc_info = { .usage = memory_usage };
+void Application::request_scene_model(size_t source)
+{
+    ModelSource& model_source = model_sources[source];
+    const uint32_t request = ++model_source.last_request;
 
-    Buffer buffer;
+    load_model_async(model_source.filename.c_str(), model_source.rotation,
+        model_source.scale, model_source.translation,
+        [this, source, request](ModelHandle handle)
+        {
+            ModelSource& loaded_source = model_sources[source];
 
-    // Allocate memory for the buffer
-    VK_CHECK(vmaCreateBuffer(
-        context.allocator, 
-        &buffer_info, 
-        &alloc_info,
-        &buffer.buffer, 
-        &buffer.allocation, 
-        nullptr)
-    );
+            // Loads can finish out of order. One that was requested again
+            // since is already out of date, so it's dropped
+            if (request < loaded_source.loaded_request)
+            {
+                unload_model(handle);
+                return;
+            }
 
-    return buffer;
+            // The old version stays in the scene until the new one replaces
+            // it, so nothing disappears while the file is parsed again.
+            // Unloading a model that was never loaded does nothing
+            unload_model(loaded_source.handle);
+            loaded_source.handle = handle;
+            loaded_source.loaded_request = request;
+        }
+    );
 }
 
+void Application::load_model_async(
+    const char* filename,
+    const glm::vec3& rotation,
+    const glm::vec3& scale,
+    const glm::vec3& translation,
+    ModelLoadedCallback on_loaded
+)
+{
+    const std::string path(filename);
+    const EVertexFormat format = vertex_format;
+
+    std::future<std::optional<Model>> model = get_thread_pool().submit(
+        [=]()
+        {
+            return create_model(
+                path.c_str(), rotation, scale, translation, format);
+        }
+    );
+    loading_models.push_back({ std::move(model), std::move(on_loaded) });
+}
 
-void Application::upload_model(std::shared_ptr<Model>& model)
+void Application::process_model_uploads()
 {
-    if (!model)
+    // Retire the batches the GPU is done with. Later uploads don't wait for
+    // the ones in flight
+    upload_context.batcher.poll();
+    finish_model_uploads();
+
+    // Gather every model that has finished parsing
+    std::vector<ModelUpload> batch;
+    for (auto it = loading_models.begin(); it != loading_models.end();)
     {
-        return;
+        if (it->model.wait_for(std::chrono::seconds(0))
+            != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        // Models that failed to load or have no geometry are dropped
+        std::optional<Model> model = it->model.get();
+        if (model && !model->indices.empty())
+        {
+            upload_materials(*model);
+            batch.push_back({ std::move(*model), std::move(it->on_loaded) });
+        }
+        it = loading_models.erase(it);
     }
 
-    // Copy the model vertex data to the allocated memory block
-    const size_t buf_sz = model->vertices.size() * sizeof(Vertex);
+    // Textures are uploaded as soon as they're decoded, whether or not the
+    // models using them are in the same batch
+    std::vector<uint32_t> textures = texture_cache.collect_decoded();
+
+    if (!batch.empty() || !textures.empty())
+    {
+        upload_models(batch, textures);
+    }
+}
 
-    // Create a staging buffer to upload the mesh to the GPU
-    VkBufferCreateInfo buffer_create_info = {
+Buffer Application::create_buffer(
+    size_t alloc_size,
+    VkBufferUsageFlags usage,
+    VmaMemoryUsage memory_usage,
+    EMemoryCategory category
+)
+{
+    // Specify info about the buffer to create
+    const VkBufferCreateInfo buffer_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = nullptr,
-        .size = buf_sz,
-        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT // transfer commands only
+        .size = alloc_size,
+        .usage = usage
     };
 
     // Set allocation properties for the buffer
-    VmaAllocationCreateInfo alloc_create_info = {
-        .usage = VMA_MEMORY_USAGE_CPU_ONLY
-    };
+    const VmaAllocationCreateInfo alloc_info = { .usage = memory_usage };
+
+    Buffer buffer;
 
-    // Allocate memory for the staging buffer
-    Buffer staging_buffer;
+    // Allocate memory for the buffer
     VK_CHECK(vmaCreateBuffer(
-        context.allocator,
-        &buffer_create_info,
-        &alloc_create_info,
-        &staging_buffer.buffer,
-        &staging_buffer.allocation,
+        context.allocator, 
+        &buffer_info, 
+        &alloc_info,
+        &buffer.buffer, 
+        &buffer.allocation, 
         nullptr)
     );
 
-    // Map allocated memory to be accessible to the CPU
-    void* vertex_data;
-    vmaMapMemory(context.allocator, staging_buffer.allocation, &vertex_data);
-
-    // Copy memory into the buffer
-    memcpy(vertex_data, model->vertices.data(), buf_sz);
+    context.memory_tracker.track(buffer.allocation, category);
 
-    // Unmap the memory to release it back to the allocator
-    vmaUnmapMemory(context.allocator, staging_buffer.allocation);
+    return buffer;
+}
 
-    // Create a vertex buffer for the model
-    buffer_create_info = {
+Buffer Application::create_mapped_buffer(
+    size_t alloc_size,
+    VkBufferUsageFlags usage,
+    EMemoryCategory category
+)
+{
+    const VkBufferCreateInfo buffer_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = nullptr,
-        .size = buf_sz,
-        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .size = alloc_size,
+        .usage = usage
     };
 
-    alloc_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    // Let VMA pick host visible memory suited to write combined writes,
+    // which may be device local on GPUs that have it
+    const VmaAllocationCreateInfo alloc_info = {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT
+            | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+        .usage = VMA_MEMORY_USAGE_AUTO
+    };
 
-    // Allocate vertex buffer
+    Buffer buffer;
+    VmaAllocationInfo allocation_info;
     VK_CHECK(vmaCreateBuffer(
         context.allocator,
-        &buffer_create_info,
-        &alloc_create_info,
-        &model->vertex_buffer.buffer,
-        &model->vertex_buffer.allocation,
+        &buffer_info,
+        &alloc_info,
+        &buffer.buffer,
+        &buffer.allocation,
+        &allocation_info)
+    );
+    buffer.mapped_data = allocation_info.pMappedData;
+
+    VkMemoryPropertyFlags memory_flags;
+    vmaGetAllocationMemoryProperties(
+        context.allocator, buffer.allocation, &memory_flags);
+    buffer.needs_flush =
+        (memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0;
+
+    context.memory_tracker.track(buffer.allocation, category);
+
+    return buffer;
+}
+
+void Application::flush_mapped_buffer(
+    const Buffer& buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size
+) const
+{
+    if (buffer.needs_flush && size > 0)
+    {
+        VK_CHECK(vmaFlushAllocation(
+            context.allocator, buffer.allocation, offset, size));
+    }
+}
+
+void Application::upload_models(
+    std::vector<ModelUpload>& batch,
+    std::vector<uint32_t>& textures
+)
+{
+    UploadBatcher& batcher = upload_context.batcher;
+
+    for (auto it = batch.begin(); it != batch.end();)
+    {
+        Model& model = it->model;
+
+        // Hand out the model's ranges of the shared vertex and index buffers
+        const uint32_t vertex_count = (uint32_t)model.get_vertex_count();
+        const uint32_t index_count = (uint32_t)model.indices.size();
+
+        uint64_t vertex_offset;
+        uint64_t first_index;
+        {
+            // Released ranges are freed from the render thread
+            std::lock_guard<std::mutex> lock(context.geometry_mutex);
+
+            const char* error = nullptr;
+            if (!context.vertex_allocator.allocate(vertex_count, vertex_offset))
+            {
+                error = "Out of vertex buffer space, model will not be drawn.";
+            }
+            else if (!context.index_allocator.allocate(
+                index_count, first_index))
+            {
+                error = "Out of index buffer space, model will not be drawn.";
+                context.vertex_allocator.free(vertex_offset, vertex_count);
+            }
+
+            // Dropped models give back the material slots they were given
+            if (error)
+            {
+                std::cerr << error << "\n";
+                if (model.material_count > 0)
+                {
+                    context.material_allocator.free(
+                        model.material_offset, model.material_count);
+                }
+                it = batch.erase(it);
+                continue;
+            }
+        }
+
+        model.vertex_offset = (uint32_t)vertex_offset;
+        model.vertex_count = vertex_count;
+        model.first_index = (uint32_t)first_index;
+        model.index_count = index_count;
+
+        // The data is read when the batch is staged, after the loop
+        const uint32_t vertex_size = get_vertex_size(model.vertex_format);
+        batcher.copy_to_buffer(model.get_vertex_data(),
+            model.get_vertex_data_size(), context.vertex_buffer.buffer,
+            vertex_offset * vertex_size);
+        batcher.copy_to_buffer(model.indices.data(),
+            index_count * sizeof(uint32_t), context.index_buffer.buffer,
+            first_index * sizeof(uint32_t));
+
+        // Models that don't fit in the meshlet buffer are drawn whole
+        const uint32_t meshlet_count = (uint32_t)model.meshlets.size();
+        uint64_t meshlet_offset = 0;
+        if (meshlet_count > 0)
+        {
+            std::lock_guard<std::mutex> lock(context.geometry_mutex);
+            if (!context.meshlet_allocator.allocate(
+                meshlet_count, meshlet_offset))
+            {
+                std::cerr << "Out of meshlet slots, model will not be "
+                             "culled.\n";
+                model.meshlets.clear();
+            }
+        }
+
+        // Copy the meshlets to their slots of the shared meshlet buffer,
+        // rebased onto the model's ranges of the shared buffers
+        if (!model.meshlets.empty())
+        {
+            model.meshlet_offset = (uint32_t)meshlet_offset;
+            model.meshlet_count = meshlet_count;
+
+            for (Meshlet& meshlet : model.meshlets)
+            {
+                meshlet.index_offset += model.first_index;
+                meshlet.vertex_offset = (int32_t)model.vertex_offset;
+            }
+
+            batcher.copy_to_buffer(model.meshlets.data(),
+                meshlet_count * sizeof(Meshlet),
+                context.meshlet_buffer.buffer,
+                model.meshlet_offset * sizeof(Meshlet));
+        }
+
+        ++it;
+    }
+
+    // Cooked textures are copied straight out of their mapping
+    for (const uint32_t slot : textures)
+    {
+        upload_texture(texture_cache.get(slot));
+    }
+
+    // The copies go in as few submits as fit in the staging ring
+    batcher.submit();
+
+    // The levels only needed to live until they were in the staging ring
+    for (const uint32_t slot : textures)
+    {
+        texture_cache.get(slot).data = {};
+    }
+
+    // So did the geometry. Drawing only needs the models' ranges of the
+    // shared buffers
+    for (ModelUpload& upload : batch)
+    {
+        Model& model = upload.model;
+        model.vertices = {};
+        model.packed_vertices = {};
+        model.indices = {};
+        model.meshlets = {};
+    }
+
+    upload_context.pending_uploads.push_back({
+        .value = batcher.get_submitted_value(),
+        .models = std::move(batch),
+        .textures = std::move(textures)
+    });
+}
+
+void Application::finish_model_uploads()
+{
+    const uint64_t retired_value = upload_context.batcher.get_retired_value();
+
+    while (!upload_context.pending_uploads.empty()
+        && upload_context.pending_uploads.front().value <= retired_value)
+    {
+        PendingUploads& uploads = upload_context.pending_uploads.front();
+
+        // The buffers are resident, so the models can be added to the scene
+        for (ModelUpload& upload : uploads.models)
+        {
+            const ModelHandle handle = models.insert(std::move(upload.model));
+            if (upload.on_loaded)
+            {
+                upload.on_loaded(handle);
+            }
+        }
+
+        // The images are too, so every frame can start sampling them
+        for (const uint32_t slot : uploads.textures)
+        {
+            Texture& texture = texture_cache.get(slot);
+            texture.resident = true;
+
+            upload_context.resident_textures.push_back(
+                { slot, texture.view });
+        }
+
+        upload_context.pending_uploads.pop_front();
+    }
+}
+
+bool Application::unload_model(ModelHandle handle)
+{
+    const std::optional<Model> model = models.remove(handle);
+    if (!model)
+    {
+        return false;
+    }
+
+    // Frames in flight may still draw the model, so only its ranges of the
+    // shared buffers are kept until they're done
+    const uint32_t vertex_offset = model->vertex_offset;
+    const uint32_t vertex_count = model->vertex_count;
+    const uint32_t first_index = model->first_index;
+    const uint32_t index_count = model->index_count;
+    const uint32_t meshlet_offset = model->meshlet_offset;
+    const uint32_t meshlet_count = model->meshlet_count;
+    const uint32_t material_offset = model->material_offset;
+    const uint32_t material_count = model->material_count;
+    release([=]()
+    {
+        std::lock_guard<std::mutex> lock(context.geometry_mutex);
+        context.vertex_allocator.free(vertex_offset, vertex_count);
+        context.index_allocator.free(first_index, index_count);
+        if (meshlet_count > 0)
+        {
+            context.meshlet_allocator.free(meshlet_offset, meshlet_count);
+        }
+        if (material_count > 0)
+        {
+            context.material_allocator.free(material_offset, material_count);
+        }
+    });
+
+    return true;
+}
+
+void Application::upload_materials(Model& model)
+{
+    const uint32_t material_count = (uint32_t)model.materials.size();
+    if (material_count == 0)
+    {
+        return;
+    }
+
+    // Released slots are freed from the render thread
+    uint64_t material_offset;
+    bool allocated;
+    {
+        std::lock_guard<std::mutex> lock(context.geometry_mutex);
+        allocated = context.material_allocator.allocate(
+            material_count, material_offset);
+    }
+
+    // Models that don't fit in the material buffer use the default material
+    if (!allocated)
+    {
+        std::cerr << "Out of material slots, model will use the default "
+                     "material.\n";
+        model.material_offset = 0;
+        for (Submesh& submesh : model.submeshes)
+        {
+            submesh.material_index = 0;
+        }
+        return;
+    }
+
+    model.material_offset = (uint32_t)material_offset;
+    model.material_count = material_count;
+
+    // Freed slots are only handed out again once the frames that drew with
+    // them have completed, so no frame in flight reads them
+    GPUMaterial* materials =
+        static_cast<GPUMaterial*>(context.material_buffer.mapped_data);
+
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+        const Material& material = model.materials[i];
+
+        materials[model.material_offset + i] = {
+            .base_color = material.base_color,
+            .texture_index = material.texture_path.empty()
+                ? DEFAULT_TEXTURE
+                : texture_cache.request(
+                    material.texture_path, texture_compression)
+        };
+    }
+
+    flush_mapped_buffer(context.material_buffer,
+        model.material_offset * sizeof(GPUMaterial),
+        model.materials.size() * sizeof(GPUMaterial));
+}
+
+void Application::init_textures()
+{
+    // Upload the default texture every texture slot starts out pointing at
+    Texture& texture = texture_cache.get(DEFAULT_TEXTURE);
+
+    UploadBatcher& batcher = upload_context.batcher;
+    upload_texture(texture);
+
+    // The descriptor sets are written with the default texture right after,
+    // so this is the one upload that's waited on
+    batcher.submit();
+    batcher.wait();
+
+    texture.data = {};
+    texture.resident = true;
+
+    // Trilinear filtering across the whole mip chain
+    const VkSamplerCreateInfo sampler_info =
+        vkinit::sampler_create_info(VK_FILTER_LINEAR);
+    VK_CHECK(vkCreateSampler(
+        context.device,
+        &sampler_info,
+        nullptr,
+        &context.texture_sampler)
+    );
+
+    deletion_queue.push(
+        [=]()
+        {
+            vkDestroySampler(context.device, context.texture_sampler, nullptr);
+        }
+    );
+}
+
+void Application::upload_texture(Texture& texture)
+{
+    const TextureData& data = texture.data;
+    const VkFormat format = get_texture_vk_format(data.format);
+    const VkExtent3D extent = { data.width, data.height, 1 };
+
+    texture.mip_levels = (uint32_t)data.levels.size();
+
+    VkImageCreateInfo image_info = vkinit::image_create_info(
+        format,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        extent
+    );
+    image_info.mipLevels = texture.mip_levels;
+
+    const VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY
+    };
+    VK_CHECK(vmaCreateImage(
+        context.allocator,
+        &image_info,
+        &alloc_info,
+        &texture.image.image,
+        &texture.image.allocation,
         nullptr)
     );
+    context.memory_tracker.track(
+        texture.image.allocation, MEMORY_CATEGORY_TEXTURES);
+
+    VkImageViewCreateInfo view_info = vkinit::imageview_create_info(
+        format, texture.image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = texture.mip_levels;
+    VK_CHECK(vkCreateImageView(
+        context.device, &view_info, nullptr, &texture.view));
+
+    // Copy every level, then hand the image over to be sampled
+    const uint32_t block_dim = is_block_compressed(data.format) ? 4 : 1;
+
+    ImageUpload upload = {
+        .image = texture.image.image,
+        .data = data.get_data(),
+        .levels = {},
+        .block_size = get_texture_block_size(data.format),
+        .block_width = block_dim,
+        .block_height = block_dim,
+        .final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        .dst_access_mask = VK_ACCESS_SHADER_READ_BIT
+    };
+    for (const TextureLevel& level : data.levels)
+    {
+        upload.levels.push_back({
+            .offset = level.offset,
+            .size = level.size,
+            .width = level.width,
+            .height = level.height
+        });
+    }
+
+    upload_context.batcher.copy_to_image(std::move(upload));
+}
+
+void Application::update_texture_descriptors(PerFrame& frame)
+{
+    if (frame.pending_textures.empty())
+    {
+        return;
+    }
+
+    // Reserved up front so the writes can point into it
+    std::vector<VkDescriptorImageInfo> image_infos;
+    image_infos.reserve(frame.pending_textures.size());
+
+    std::vector<VkWriteDescriptorSet> descriptor_writes;
+    for (const ResidentTexture& texture : frame.pending_textures)
+    {
+        image_infos.push_back({
+            .sampler = context.texture_sampler,
+            .imageView = texture.view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        });
+
+        VkWriteDescriptorSet write = vkinit::write_descriptor_image(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            frame.material_descriptor_set, &image_infos.back(), 1);
+        write.dstArrayElement = texture.slot;
+        descriptor_writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(context.device, (uint32_t)descriptor_writes.size(),
+        descriptor_writes.data(), 0, nullptr);
+
+    frame.pending_textures.clear();
+}
+
+MeshLod Application::select_lod(
+    const Model& model,
+    const Submesh& submesh
+) const
+{
+    // Submeshes without levels of detail only have the full mesh
+    if (submesh.lod_count == 0)
+    {
+        return { .index_offset = submesh.index_offset,
+            .index_count = submesh.index_count,
+            .meshlet_offset = 0,
+            .meshlet_count = 0,
+            .error = 0.0f };
+    }
+
+    const MeshLod* lods = model.lods.data() + submesh.lod_offset;
+
+    // World space bounding sphere of the model
+    const glm::mat3 linear(model.transform);
+    const float max_scale = std::max({ glm::length(linear[0]),
+        glm::length(linear[1]), glm::length(linear[2]) });
 
-    immediate_submit(
-        [=](VkCommandBuffer cmd)
+    const glm::vec3 center = glm::vec3(model.transform
+        * glm::vec4((model.bounds_min + model.bounds_max) * 0.5f, 1.0f));
+    const float radius =
+        glm::length(model.bounds_max - model.bounds_min) * 0.5f * max_scale;
+
+    // Pixels covered by one world unit at the closest point of the model
+    const float distance = std::max(
+        glm::length(center - camera.position) - radius, camera.znear);
+    const float pixels_per_unit = (float)window->extent.height
+        / (2.0f * distance * tanf(glm::radians(camera.fov) * 0.5f));
+
+    for (uint32_t i = submesh.lod_count - 1; i > 0; i--)
+    {
+        const float projected_error =
+            lods[i].error * max_scale * pixels_per_unit;
+        if (projected_error <= lod_error_threshold)
         {
-            VkBufferCopy copy;
-            copy.dstOffset = 0;
-            copy.srcOffset = 0;
-            copy.size = buf_sz;
-            vkCmdCopyBuffer(
-                cmd, 
-                staging_buffer.buffer,
-                model->vertex_buffer.buffer, 
-                1, 
-                &copy
-            );
+            return lods[i];
+        }
+    }
+
+    return lods[0];
+}
+
+void Application::cull_meshlets(
+    VkCommandBuffer cmd,
+    const PerFrame& frame,
+    const FramePacket& packet
+)
+{
+    // Reset every draw's count
+    vkCmdFillBuffer(cmd, frame.draw_count_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr
+    );
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, context.cull_pipeline);
+    vkCmdBindDescriptorSets(
+        cmd,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        context.cull_pipeline_layout,
+        0,
+        1,
+        &frame.cull_descriptor_set,
+        0,
+        nullptr
+    );
+
+    // The object transforms are read from the object buffer, so the frustum
+    // is culled against in world space
+    const Frustum frustum = extract_frustum(packet.vp_matrix);
+
+    MeshletCullPushConstants constants = {
+        .frustum_planes = frustum.planes,
+        .camera_position = glm::vec4(packet.camera_position, 1.0f)
+    };
+
+    // One dispatch per submesh, each writing to its own range of draws
+    for (size_t i = 0; i < packet.draws.size(); i++)
+    {
+        const MeshDraw& draw = packet.draws[i];
+        if (draw.lod.meshlet_count == 0)
+        {
+            continue;
         }
+
+        // Only the meshlets of the level of detail being drawn are culled
+        constants.object_index = draw.object_index;
+        constants.meshlet_offset = draw.first_meshlet;
+        constants.meshlet_count = draw.lod.meshlet_count;
+        constants.draw_index = (uint32_t)i;
+
+        vkCmdPushConstants(
+            cmd,
+            context.cull_pipeline_layout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(MeshletCullPushConstants),
+            &constants
+        );
+
+        const uint32_t group_count =
+            (constants.meshlet_count + MESHLET_CULL_GROUP_SIZE - 1)
+            / MESHLET_CULL_GROUP_SIZE;
+        vkCmdDispatch(cmd, group_count, 1, 1);
+    }
+
+    // Make the draws visible to the indirect draw calls
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr
     );
+}
 
-    vmaDestroyBuffer(
-        context.allocator, staging_buffer.buffer, staging_buffer.allocation);
+void Application::limit_latency()
+{
+    const uint64_t frames_ahead = std::clamp<uint64_t>(
+        max_frames_ahead.load(), 1, NUM_OVERLAPPING_FRAMES);
+    const uint64_t frame_number = current_frame + 1;
+    if (frame_number <= frames_ahead)
+    {
+        return;
+    }
 
-    // Add model to models in scene
-    models.push_back(std::move(model));
+    // Skipped frames come back here for a frame that's been waited for
+    const uint64_t target = frame_number - frames_ahead;
+    if (target <= latency_stats.last_frame)
+    {
+        return;
+    }
+
+    // A frame is seen once it's presented, which is waited for when possible.
+    // Present waits time out when nothing gets presented, like while the
+    // window is hidden, and then the frame completing has to do
+    const bool presented = context.wait_for_present
+        && context.swapchain_first_frame != 0
+        && target >= context.swapchain_first_frame
+        && context.wait_for_present(context.device, context.swapchain, target,
+            PRESENT_WAIT_TIMEOUT) == VK_SUCCESS;
+    if (!presented)
+    {
+        wait_for_frame(target);
+    }
+
+    // The frame was presented by now, but maybe well before if nothing had
+    // to be waited for, so the latency is an upper bound
+    const PerFrame& frame =
+        context.frames[(target - 1) % NUM_OVERLAPPING_FRAMES];
+    if (frame.number == target)
+    {
+        record_latency(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - frame.input_time));
+    }
+    latency_stats.last_frame = target;
+}
+
+void Application::record_latency(std::chrono::nanoseconds latency)
+{
+    latency_stats.total += latency;
+    latency_stats.max = std::max(latency_stats.max, latency);
+    latency_stats.frame_count++;
+
+    if (latency_report_interval == 0
+        || latency_stats.frame_count < latency_report_interval)
+    {
+        return;
+    }
+
+    using milliseconds = std::chrono::duration<double, std::milli>;
+    std::cout << "Input to present latency over "
+              << latency_stats.frame_count << " frames: "
+              << milliseconds(latency_stats.total / latency_stats.frame_count)
+                     .count()
+              << " ms average, "
+              << milliseconds(latency_stats.max).count() << " ms max, "
+              << max_frames_ahead.load() << " frames ahead\n";
+
+    latency_stats.total = {};
+    latency_stats.max = {};
+    latency_stats.frame_count = 0;
+}
+
+void Application::record_draws(
+    VkCommandBuffer cmd,
+    const PerFrame& frame,
+    const FramePacket& packet,
+    VkFramebuffer framebuffer,
+    uint32_t uniform_offset,
+    size_t first_draw,
+    size_t last_draw
+) const
+{
+    // The buffer continues the render pass begun by the primary one, inside
+    // the pipeline statistics query the primary one has active
+    const VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = nullptr,
+        .renderPass = context.render_pass,
+        .subpass = 0,
+        .framebuffer = framebuffer,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0,
+        .pipelineStatistics = context.gpu_profiler.get_statistics_flags()
+    };
+    const VkCommandBufferBeginInfo cmd_buf_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+            | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info
+    };
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_buf_begin_info));
+
+    // Secondary command buffers inherit no state, so each binds everything
+    // it draws with
+    vkCmdBindPipeline(
+        cmd,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        context.pipeline
+    );
+
+    vkCmdBindDescriptorSets(
+        cmd,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        context.pipeline_layout,
+        0,
+        1,
+        &frame.global_descriptor_set,
+        1,
+        &uniform_offset
+    );
+
+    // Bind object and material descriptor sets to pipline
+    const std::array<VkDescriptorSet, 2> draw_descriptor_sets = {
+        frame.object_descriptor_set,
+        frame.material_descriptor_set
+    };
+    vkCmdBindDescriptorSets(
+        cmd,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        context.pipeline_layout,
+        1,
+        (uint32_t)draw_descriptor_sets.size(),
+        draw_descriptor_sets.data(),
+        0,
+        nullptr
+    );
+
+    // The viewport follows the swapchain
+    const VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (float)context.swapchain_extent.width,
+        .height = (float)context.swapchain_extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    const VkRect2D scissor = { { 0, 0 }, context.swapchain_extent };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    // Every model's geometry is in the shared buffers, so they're bound once
+    const VkDeviceSize vertex_buffer_offset = 0;
+    vkCmdBindVertexBuffers(
+        cmd,
+        0,
+        1,
+        &context.vertex_buffer.buffer,
+        &vertex_buffer_offset
+    );
+    vkCmdBindIndexBuffer(
+        cmd,
+        context.index_buffer.buffer,
+        0,
+        VK_INDEX_TYPE_UINT32
+    );
+
+    for (size_t i = first_draw; i < last_draw; i++)
+    {
+        const MeshDraw& draw = packet.draws[i];
+
+        const MaterialPushConstants constants = {
+            .material_index = draw.material_index
+        };
+        vkCmdPushConstants(
+            cmd,
+            context.pipeline_layout,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            0,
+            sizeof(MaterialPushConstants),
+            &constants
+        );
+
+        // Draw the meshlets that survived culling, or the whole level of
+        // detail
+        const MeshLod& lod = draw.lod;
+        if (meshlet_culling && lod.meshlet_count > 0)
+        {
+            vkCmdDrawIndexedIndirectCount(
+                cmd,
+                frame.draw_command_buffer.buffer,
+                draw.first_meshlet * sizeof(VkDrawIndexedIndirectCommand),
+                frame.draw_count_buffer.buffer,
+                i * sizeof(uint32_t),
+                lod.meshlet_count,
+                sizeof(VkDrawIndexedIndirectCommand)
+            );
+        }
+        else
+        {
+            vkCmdDrawIndexed(
+                cmd,
+                lod.index_count,
+                1,
+                draw.first_index + lod.index_offset,
+                draw.vertex_offset,
+                draw.object_index
+            );
+        }
+    }
+
+    VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+void Application::release(std::function<void()>&& deleter)
+{
+    // Frame packets from now on don't use the resource. The render thread
+    // tags it with the last frame drawn before the next packet, and frames
+    // complete in order, so that frame completing is enough
+    frame_packets.get_back().releases.push_back(std::move(deleter));
+}
+
+void Application::collect_releases(uint64_t completed_frame)
+{
+    // Releases are queued in frame order, so the completed ones are in front
+    while (!frame_releases.empty()
+        && frame_releases.front().frame <= completed_frame)
+    {
+        frame_releases.front().deleter();
+        frame_releases.pop_front();
+    }
 }
 
 PerFrame& Application::get_current_frame()
@@ -1329,6 +3118,27 @@ PerFrame& Application::get_current_frame()
     return context.frames[current_frame % NUM_OVERLAPPING_FRAMES];
 }
 
+uint64_t Application::get_completed_frame() const
+{
+    uint64_t frame;
+    VK_CHECK(vkGetSemaphoreCounterValue(
+        context.device, context.frame_semaphore, &frame));
+    return frame;
+}
+
+void Application::wait_for_frame(uint64_t frame) const
+{
+    const VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &context.frame_semaphore,
+        .pValues = &frame
+    };
+    VK_CHECK(vkWaitSemaphores(context.device, &wait_info, TIMEOUT_PERIOD));
+}
+
 void Application::pipe_cleanup(
     PipelineBuilder &builder,
     std::vector<VkPipelineShaderStageCreateInfo> &shader_stages
@@ -1366,38 +3176,3 @@ size_t Application::pad_uniform_buffer_size(size_t size) const
 
     return aligned_size;
 }
-
-void Application::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
-{
-    VkCommandBuffer cmd = upload_context.command_buffer;
-
-    // Begin recording
-    const VkCommandBufferBeginInfo cmd_buf_begin_info =
-        vkinit::command_buffer_begin_info(
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_buf_begin_info));
-
-    // Execute the function
-    function(cmd);
-
-    // End recording
-    VK_CHECK(vkEndCommandBuffer(cmd));
-
-    VkSubmitInfo submit = vkinit::submit_info(&cmd);
-
-    // Submit command buffer to queue and execute it
-    VK_CHECK(vkQueueSubmit(
-        context.queue, 
-        1, 
-        &submit, 
-        upload_context.upload_fence)
-    );
-
-    // Fence will block until all commands in the buffer have been executed
-    vkWaitForFences(
-        context.device, 1, &upload_context.upload_fence, true, TIMEOUT_PERIOD);
-    vkResetFences(context.device, 1, &upload_context.upload_fence);
-
-    // Reset command pool
-    vkResetCommandPool(context.device, upload_context.command_pool, 0);
-}
@@ -1,7 +1,16 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <glm/mat4x4.hpp>
@@ -11,12 +20,61 @@
 #include "Camera/Camera.h"
 #include "Model/Model.h"
 #include "Scene/Scene.h"
+#include "Texture/TextureCache.h"
+#include "Utils/HandlePool.h"
+#include "Utils/SpscQueue.h"
+#include "Utils/TripleBuffer.h"
 #include "VulkanRenderer/DeletionQueue.h"
+#include "VulkanRenderer/GpuProfiler.h"
+#include "VulkanRenderer/MemoryTracker.h"
+#include "VulkanRenderer/RangeAllocator.h"
+#include "VulkanRenderer/UploadBatcher.h"
 #include "Window/Window.h"
 
+using ModelHandle = Handle<Model>;
+
+/** Called with the handle of a loaded model once it has joined the scene */
+using ModelLoadedCallback = std::function<void(ModelHandle)>;
+
 const int NUM_OVERLAPPING_FRAMES = 3;
-const int MAX_DESCRIPTOR_SETS = 10;
+const int MAX_DESCRIPTOR_SETS = 16;
 const int MAX_OBJECTS = 10000;
+const int MAX_MESHLETS = 1 << 18;
+const int MAX_MATERIALS = 4096;
+
+/** Capacity of the vertex and index buffers shared by every model */
+const uint32_t MAX_VERTICES = 1 << 21;
+const uint32_t MAX_INDICES = 1 << 23;
+
+/** Most submesh draws per frame, which is also the number of draw counts */
+const int MAX_DRAWS = 10000;
+
+/** Models updated or prepared for drawing by one job of the thread pool */
+const size_t MODELS_PER_JOB = 32;
+
+/** Fewest draws worth handing to a recording thread of their own */
+const size_t MIN_DRAWS_PER_SECONDARY = 128;
+
+/**
+ * Time between simulation steps. Camera and model motion advance by a step
+ * at a time, however fast frames are drawn.
+ */
+const std::chrono::nanoseconds SIMULATION_STEP(1000000000 / 60);
+
+/**
+ * Longest the latency limiter waits for a frame to be presented before
+ * falling back to waiting for it to complete
+ */
+const uint64_t PRESENT_WAIT_TIMEOUT = 100000000;
+
+/**
+ * Size of the staging ring uploads are copied through. Bigger uploads are
+ * split across several batches.
+ */
+const VkDeviceSize UPLOAD_STAGING_SIZE = 64 * 1024 * 1024;
+
+/** Threads per workgroup in cull_meshlets.comp */
+const uint32_t MESHLET_CULL_GROUP_SIZE = 64;
 
 struct MeshPushConstants
 {
@@ -27,24 +85,185 @@ struct MeshPushConstants
 struct GPUObjectData
 {
     glm::mat4 model_matrix;
+
+    /** Unpacking parameters for packed vertices: v * scale + offset */
+    glm::vec4 position_scale;
+    glm::vec4 position_offset;
+    glm::vec4 texcoord_scale_offset; // xy = scale, zw = offset
+};
+
+struct GPUMaterial
+{
+    glm::vec4 base_color;
+    uint32_t texture_index;
+    uint32_t padding[3];
+};
+
+/** Per-draw parameters of the fragment shader */
+struct MaterialPushConstants
+{
+    uint32_t material_index;
+};
+
+/** Per-draw parameters of the meshlet culling pass */
+struct MeshletCullPushConstants
+{
+    std::array<glm::vec4, 6> frustum_planes;
+    glm::vec4 camera_position;
+    uint32_t object_index;
+    uint32_t meshlet_offset;
+    uint32_t meshlet_count;
+    uint32_t draw_index;
+};
+
+/**
+ * One submesh of a model at the level of detail it's drawn at this frame,
+ * with everything needed to draw it from the shared buffers
+ */
+struct MeshDraw
+{
+    /** Position of the model in the scene, which is also its object index */
+    uint32_t object_index;
+    uint32_t material_index;
+
+    /** Where the model's geometry starts in the shared buffers */
+    uint32_t first_index;
+    int32_t vertex_offset;
+
+    /**
+     * First meshlet of the level of detail in the meshlet buffer. The level's
+     * meshlet count is 0 when the model has no meshlets.
+     */
+    uint32_t first_meshlet;
+    MeshLod lod;
+};
+
+/** A texture slot that became resident, and the view to write to it */
+struct ResidentTexture
+{
+    uint32_t slot;
+    VkImageView view;
+};
+
+/**
+ * Uploads that retired before a frame packet was published, handed to the
+ * render thread in order. Unlike frame packets none are ever skipped, so the
+ * render thread takes all of them before drawing any packet.
+ */
+struct UploadHandoff
+{
+    /** Timeline value of the uploads, which frames acquiring them wait on */
+    uint64_t value = 0;
+
+    /** Ownership of uploaded resources, acquired before anything is drawn */
+    UploadAcquires acquires;
+
+    /** Texture slots to write to every frame's set */
+    std::vector<ResidentTexture> resident_textures;
+};
+
+/**
+ * Everything the render thread needs to draw a frame, written by the
+ * simulation thread. The render thread only reads it, apart from the
+ * releases, which it empties as it hands them over. The simulation thread
+ * only ever appends to those, so a packet that's never drawn passes them on
+ * to the next one written in its place. Releases only ever go later that
+ * way, but uploads must not, so they go through UploadHandoff instead.
+ */
+struct FramePacket
+{
+    /** Simulation step the packet was written at */
+    uint64_t step = 0;
+
+    /** When the input the step used was sampled */
+    std::chrono::steady_clock::time_point input_time;
+
+    glm::mat4 vp_matrix = glm::mat4(1.0f);
+    glm::vec3 camera_position = glm::vec3(0.0f);
+    Scene scene_data = {};
+
+    std::vector<GPUObjectData> objects;
+    std::vector<MeshDraw> draws;
+
+    /** Timeline value of the uploads the draws need */
+    uint64_t upload_value = 0;
+
+    /** Resources to destroy once the frames drawn so far have completed */
+    std::vector<std::function<void()>> releases;
+};
+
+/** A resource to destroy once the GPU has completed a frame */
+struct FrameRelease
+{
+    uint64_t frame;
+    std::function<void()> deleter;
+};
+
+/** Input to present latency of a run of frames */
+struct LatencyStats
+{
+    std::chrono::nanoseconds total = {};
+    std::chrono::nanoseconds max = {};
+    uint32_t frame_count = 0;
+
+    /** Number of the last frame measured */
+    uint64_t last_frame = 0;
+};
+
+/** A model on its way into the scene, and who to tell when it gets there */
+struct ModelUpload
+{
+    Model model;
+    ModelLoadedCallback on_loaded;
+};
+
+/**
+ * Models and texture slots uploaded together. They join the scene once the
+ * batch signaling value retires.
+ */
+struct PendingUploads
+{
+    uint64_t value;
+    std::vector<ModelUpload> models;
+    std::vector<uint32_t> textures;
 };
 
 struct UploadContext {
-    VkFence upload_fence;
-    VkCommandPool command_pool;
-    VkCommandBuffer command_buffer;
+    UploadBatcher batcher;
+
+    /** Uploads whose batches are in flight, oldest first */
+    std::deque<PendingUploads> pending_uploads;
+
+    /** Texture slots that became resident since the last handoff */
+    std::vector<ResidentTexture> resident_textures;
 };
 
 
 /** Per-frame data */
 struct PerFrame
 {
-    VkFence queue_submit_fence = nullptr;
+    /**
+     * Number of the frame last drawn with this frame's resources, and when
+     * the input it shows was sampled.
+     */
+    uint64_t number = 0;
+    std::chrono::steady_clock::time_point input_time;
+
+    /** GPU timings of the frame, read back when the frame comes around */
+    FrameQueries queries;
 
     VkCommandPool primary_command_pool = nullptr;
 
     VkCommandBuffer primary_command_buffer = nullptr;
 
+    /**
+     * A pool and a secondary command buffer for every share of the draws
+     * recorded in parallel. Each share is recorded by one thread, so no pool
+     * is ever used by two threads at once.
+     */
+    std::vector<VkCommandPool> secondary_command_pools;
+    std::vector<VkCommandBuffer> secondary_command_buffers;
+
     VkSemaphore swapchain_acquire_semaphore = nullptr;
 
     VkSemaphore swapchain_release_semaphore = nullptr;
@@ -56,6 +275,24 @@ struct PerFrame
     Buffer object_storage_buffer = {};
 
     VkDescriptorSet object_descriptor_set = nullptr;
+
+    /**
+     * Indirect draws written by the meshlet culling pass. Each draw owns the
+     * range of draw commands matching its range in the meshlet buffer, and
+     * the draw count at its index in the frame's draw list.
+     */
+    Buffer draw_command_buffer = {};
+    Buffer draw_count_buffer = {};
+
+    VkDescriptorSet cull_descriptor_set = nullptr;
+
+    /**
+     * Materials and the texture array. Texture slots that became resident
+     * are written once the frame's previous submission has completed, since
+     * the set can't change while the GPU is using it.
+     */
+    VkDescriptorSet material_descriptor_set = nullptr;
+    std::vector<ResidentTexture> pending_textures;
 };
 
 /** Vulkan objects and global state */
@@ -64,6 +301,28 @@ struct Context
     /** The VMA allocator. Manages memory buffers. */
     VmaAllocator allocator = nullptr;
 
+    /** Whether VK_EXT_memory_budget is enabled for the allocator. */
+    bool memory_budget_supported = false;
+
+    /**
+     * vkWaitForPresentKHR, if VK_KHR_present_id and VK_KHR_present_wait are
+     * enabled. Frames are then presented with their number as present id.
+     */
+    PFN_vkWaitForPresentKHR wait_for_present = nullptr;
+
+    /**
+     * First frame presented to the swapchain, or 0 before any is. Present
+     * ids of earlier frames went to an older swapchain and can't be waited
+     * on.
+     */
+    uint64_t swapchain_first_frame = 0;
+
+    /** Times scopes of every frame's commands on the GPU. */
+    GpuProfiler gpu_profiler;
+
+    /** Sums up allocations by what they're used for. */
+    MemoryTracker memory_tracker;
+
     /** The Vulkan instance. Used to access Vulkan drivers. */
     VkInstance instance = nullptr;
 
@@ -86,6 +345,20 @@ struct Context
     /** The Vulkan device queue. */
     VkQueue queue = nullptr;
 
+    /**
+     * Timeline semaphore the queue sets to a frame's number, counting from 1,
+     * once the frame has completed. Frames are paced by waiting on it, and
+     * anything that has to outlive the frames using it is tagged with a frame
+     * number to compare against it.
+     */
+    VkSemaphore frame_semaphore = nullptr;
+
+    /**
+     * Locked around submits to queue when uploads share it, since they're
+     * submitted from the simulation thread.
+     */
+    std::mutex queue_mutex;
+
     /**
      * The Vulkan surface. Represents a platform-specific surface/window used
      * for displaying rendered graphics.
@@ -98,9 +371,30 @@ struct Context
     /** Pixel format of the swapchain. */
     VkFormat image_format = VK_FORMAT_UNDEFINED;
 
+    /**
+     * Size of the swapchain images, which the depth image, framebuffers and
+     * viewport follow.
+     */
+    VkExtent2D swapchain_extent = {};
+
+    /**
+     * Present mode the swapchain was made for, and the one it got. They
+     * differ when the surface doesn't support the mode asked for.
+     */
+    VkPresentModeKHR requested_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
     /** Index to the queue family graphics commands are submitted to. */
     int graphics_queue_index = -1;
 
+    /**
+     * The queue uploads are submitted to. A dedicated transfer queue when the
+     * GPU has one, otherwise the graphics queue.
+     */
+    VkQueue transfer_queue = nullptr;
+    int transfer_queue_index = -1;
+    VkExtent3D transfer_image_granularity = {};
+
     /**
      * Array for swap chain image views. In Vulkan, images are not directly
      * accesible by pipeline shaders for reading or writing to and must be
@@ -137,12 +431,18 @@ struct Context
     /** Pipeline layouts for resources. */
     VkPipelineLayout pipeline_layout = nullptr;
 
+    /** Compute pipeline that culls meshlets into indirect draws. */
+    VkPipeline cull_pipeline = nullptr;
+    VkPipelineLayout cull_pipeline_layout = nullptr;
+
     /** Per-frame data. */
     std::array<PerFrame, NUM_OVERLAPPING_FRAMES> frames;
 
     /** Describes layouts of the descriptor sets. */
     VkDescriptorSetLayout global_descriptor_set_layout = nullptr;
     VkDescriptorSetLayout object_descriptor_set_layout = nullptr;
+    VkDescriptorSetLayout cull_descriptor_set_layout = nullptr;
+    VkDescriptorSetLayout material_descriptor_set_layout = nullptr;
 
     /**
      * A pool of descriptor sets, which are allocated by the application at
@@ -156,6 +456,39 @@ struct Context
      */
     Scene scene_data;
     Buffer scene_data_buffer;
+
+    /**
+     * Vertices and indices of every uploaded model, so they're bound once
+     * per frame. Ranges are handed out in vertices and indices, and freed
+     * when models are unloaded.
+     */
+    Buffer vertex_buffer;
+    RangeAllocator vertex_allocator;
+    Buffer index_buffer;
+    RangeAllocator index_allocator;
+
+    /**
+     * Meshlets of every uploaded model. Slots are handed out in meshlets, and
+     * freed when models are unloaded.
+     */
+    Buffer meshlet_buffer;
+    RangeAllocator meshlet_allocator;
+
+    /**
+     * Materials of every uploaded model, with the default material in slot 0.
+     * Slots are handed out in materials, and freed when models are unloaded.
+     */
+    Buffer material_buffer;
+    RangeAllocator material_allocator;
+
+    /**
+     * Guards the allocators, which models are uploaded from on the simulation
+     * thread and released to from the render thread.
+     */
+    std::mutex geometry_mutex;
+
+    /** Sampler shared by every texture. */
+    VkSampler texture_sampler = nullptr;
 };
 
 enum ERenderMode
@@ -181,7 +514,30 @@ struct Application
 
     void update();
 
-    void render();
+    /**
+     * Writes the frame packet of the current simulation step and hands it
+     * to the render thread.
+     */
+    void publish_frame_packet();
+
+    /** Draws the latest frame packet until rendering stops. */
+    void render_loop();
+
+    /**
+     * Waits until the frame max_frames_ahead before the next one has been
+     * presented, or completed when present waits aren't supported, and
+     * measures its latency.
+     */
+    void limit_latency();
+
+    /** Adds a frame's latency to the stats and reports them when due. */
+    void record_latency(std::chrono::nanoseconds latency);
+
+    /**
+     * Draws a frame packet. Returns false if no frame could be drawn, which
+     * happens while the swapchain is being recreated.
+     */
+    bool render(FramePacket& packet);
 
     // SDL_Window* window = nullptr;
     // VkExtent2D window_extent = { 800, 600 };
@@ -190,11 +546,100 @@ struct Application
 
     std::unique_ptr<Window> window = std::make_unique<Window>();
 
-    int current_frame = 0;
+    /**
+     * Frames submitted by the render thread. The frame being recorded is
+     * number current_frame + 1 on the frame semaphore.
+     */
+    uint64_t current_frame = 0;
+
+    /** Steps taken by the simulation, which runs on the main thread */
+    uint64_t simulation_step = 0;
+
     bool running = false;
 
+    /**
+     * Frame packets going from the simulation to the render thread, which
+     * draws the latest one at its own pace until rendering is cleared.
+     */
+    TripleBuffer<FramePacket> frame_packets;
+
+    /**
+     * Retired uploads going from the simulation to the render thread, pushed
+     * before the packet that draws them is published.
+     */
+    SpscQueue<UploadHandoff> upload_handoffs;
+
+    /**
+     * Handed over uploads the render thread hasn't recorded acquires for
+     * yet, and the timeline value the frame recording them waits on.
+     */
+    std::vector<UploadHandoff> drained_handoffs;
+    UploadAcquires pending_acquires;
+    uint64_t pending_upload_value = 0;
+    std::thread render_thread;
+    std::atomic<bool> rendering = false;
+
     ERenderMode render_mode = SOLID;
 
+    /**
+     * Vertex layout models are imported and drawn with. Switch to
+     * VERTEX_FORMAT_PACKED for 16 byte quantized vertices.
+     */
+    EVertexFormat vertex_format = VERTEX_FORMAT_FULL;
+
+    /**
+     * Cull the meshlets of models on the GPU and only draw the visible ones.
+     * Models without meshlets are always drawn whole.
+     */
+    bool meshlet_culling = true;
+
+    /**
+     * How far in pixels a simplified level of detail may stray from the full
+     * mesh on screen before a finer level is drawn instead.
+     */
+    float lod_error_threshold = 1.0f;
+
+    /**
+     * Block compression textures are cooked with. Cooked textures are cached
+     * next to their image as .vtex files.
+     */
+    ETextureCompression texture_compression = TEXTURE_COMPRESSION_BC7;
+
+    /**
+     * GPU memory use as of the current frame. It's also logged and written to
+     * memory_report.json every memory_report_interval frames, or never at 0.
+     */
+    MemorySnapshot memory_snapshot;
+    uint32_t memory_report_interval = 600;
+
+    /**
+     * Present mode to use. Set before initialize to pick the startup mode.
+     * The render thread recreates the swapchain when it changes afterwards,
+     * falling back to FIFO when the surface doesn't support it.
+     */
+    std::atomic<VkPresentModeKHR> present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+    /**
+     * Frames the CPU may run ahead of the display, from 1 to
+     * NUM_OVERLAPPING_FRAMES. Frame N waits for frame N - max_frames_ahead to
+     * be presented before taking the latest frame packet, trading throughput
+     * for lower latency the smaller it is.
+     */
+    std::atomic<uint32_t> max_frames_ahead = NUM_OVERLAPPING_FRAMES;
+
+    /**
+     * Estimated input to present latency of the frames drawn since it was
+     * last reported, every latency_report_interval frames or never at 0.
+     */
+    LatencyStats latency_stats;
+    uint32_t latency_report_interval = 600;
+
+    /** GPU timings are logged every gpu_report_interval frames, or never at 0 */
+    uint32_t gpu_report_interval = 600;
+
+    /** When input was last sampled, on the simulation thread */
+    std::chrono::steady_clock::time_point input_time;
+
     void init_instance();
 
     void init_allocator();
@@ -205,12 +650,37 @@ struct Application
 
     void init_framebuffers();
 
+    /**
+     * Makes a swapchain in the present mode asked for, with a depth image to
+     * match. The current swapchain, if any, is handed over as the old one and
+     * destroyed.
+     */
+    void create_swapchain();
+
+    /** Destroys the swapchain's image views and the depth image. */
+    void destroy_swapchain_images();
+
+    void create_framebuffers();
+    void destroy_framebuffers();
+
+    /**
+     * Replaces the swapchain and everything sized after it once the frames
+     * in flight are done with them. Returns false, keeping the swapchain,
+     * while the surface has no area to present to.
+     */
+    bool recreate_swapchain();
+
     VkShaderModule load_shader_module(const char *filename) const;
 
     void init_per_frames();
 
     void init_pipelines();
 
+    void init_cull_pipeline();
+
+    /** Uploads the default texture and creates the texture sampler. */
+    void init_textures();
+
     void pipe_cleanup(
         PipelineBuilder &builder,
         std::vector<VkPipelineShaderStageCreateInfo> &shader_stages
@@ -220,6 +690,15 @@ struct Application
 
     void init_descriptors();
 
+    /**
+     * Takes the frame's memory snapshot. Warns when a heap nears its budget
+     * and reports the snapshot when it's due.
+     */
+    void update_memory_snapshot();
+
+    /** Creates the vertex and index buffers shared by every model. */
+    void init_geometry_buffers();
+
     void destroy_vulkan_resources();
 
     //void destroy_per_frames();
@@ -232,25 +711,215 @@ struct Application
 
     void load_models();
 
+    /**
+     * Loads a model into the scene and remembers where it came from, so
+     * reload_models can load it again.
+     */
+    void load_scene_model(
+        const char* filename,
+        const glm::vec3& rotation = glm::vec3(0.0f),
+        const glm::vec3& scale = glm::vec3(1.0f),
+        const glm::vec3& translation = glm::vec3(0.0f)
+    );
+
+    /**
+     * Loads every scene model again, picking up edits to their files, and
+     * replaces each with its new version once that has joined the scene.
+     */
+    void reload_models();
+
+    /**
+     * Loads a scene model from its source. Of the versions that have finished
+     * loading, only the most recently requested one stays in the scene, and
+     * every other one is unloaded.
+     */
+    void request_scene_model(size_t source);
+
+    /**
+     * Parses a model on the thread pool. It's uploaded once it's ready, and
+     * on_loaded is called on the simulation thread with its handle once it
+     * has joined the scene. Models that fail to load never call it.
+     */
+    void load_model_async(
+        const char* filename,
+        const glm::vec3& rotation = glm::vec3(0.0f),
+        const glm::vec3& scale = glm::vec3(1.0f),
+        const glm::vec3& translation = glm::vec3(0.0f),
+        ModelLoadedCallback on_loaded = {}
+    );
+
+    /**
+     * Polls background model loading. Retires the upload batches that have
+     * completed, then submits every model that finished parsing since. Only
+     * blocks when the staging ring is full.
+     */
+    void process_model_uploads();
+
     [[nodiscard]]
     Buffer create_buffer(
         size_t alloc_size,
         VkBufferUsageFlags usage, 
-        VmaMemoryUsage memory_usage
+        VmaMemoryUsage memory_usage,
+        EMemoryCategory category
+    );
+
+    /**
+     * Creates a buffer the CPU only writes, front to back, and maps it for
+     * its whole lifetime.
+     */
+    [[nodiscard]]
+    Buffer create_mapped_buffer(
+        size_t alloc_size,
+        VkBufferUsageFlags usage,
+        EMemoryCategory category
+    );
+
+    /**
+     * Makes writes through a mapped buffer visible to the GPU. Only calls
+     * into VMA when the buffer's memory isn't host coherent.
+     */
+    void flush_mapped_buffer(
+        const Buffer& buffer,
+        VkDeviceSize offset,
+        VkDeviceSize size
     ) const;
 
-    void upload_model(std::shared_ptr<Model> &model);
+    /**
+     * Destroys a resource once no frame in flight can use it anymore, without
+     * waiting on the GPU. Called from the simulation thread, the deleter runs
+     * on the render thread.
+     */
+    void release(std::function<void()>&& deleter);
+
+    /** Runs the deleters of the releases whose frame has completed. */
+    void collect_releases(uint64_t completed_frame);
+
+    /**
+     * Resources waiting on the frames that can still use them, by frame.
+     * Only touched by the render thread.
+     */
+    std::deque<FrameRelease> frame_releases;
+
+    /**
+     * Queues the copies of a batch of models and loaded textures and submits
+     * them together.
+     */
+    void upload_models(
+        std::vector<ModelUpload> &batch,
+        std::vector<uint32_t> &textures
+    );
+
+    /**
+     * Adds the models and textures of every retired upload to the scene, and
+     * hands the models' handles to their loaders.
+     */
+    void finish_model_uploads();
+
+    /**
+     * Removes a model from the scene. Its geometry is released, to be reused
+     * once the frames in flight are done with it. Returns false if the
+     * handle is stale.
+     */
+    bool unload_model(ModelHandle handle);
+
+    /**
+     * Hands out material slots to a model's materials and writes them to the
+     * material buffer, requesting their textures.
+     */
+    void upload_materials(Model& model);
+
+    /**
+     * Creates the image of a texture and queues the copy of its levels,
+     * followed by the release of the image to the graphics queue.
+     */
+    void upload_texture(Texture& texture);
+
+    /** Writes texture slots that became resident to the frame's set. */
+    void update_texture_descriptors(PerFrame& frame);
+
+    /**
+     * Picks the coarsest level of detail of a submesh whose simplification
+     * error projects to no more than lod_error_threshold pixels.
+     */
+    [[nodiscard]]
+    MeshLod select_lod(const Model& model, const Submesh& submesh) const;
+
+    /** Records the compute pass that fills the frame's indirect draws. */
+    void cull_meshlets(
+        VkCommandBuffer cmd,
+        const PerFrame& frame,
+        const FramePacket& packet
+    );
+
+    /**
+     * Records draws [first_draw, last_draw) into a secondary command buffer
+     * that continues the frame's render pass. Safe to call from several
+     * threads at once with different command buffers.
+     */
+    void record_draws(
+        VkCommandBuffer cmd,
+        const PerFrame& frame,
+        const FramePacket& packet,
+        VkFramebuffer framebuffer,
+        uint32_t uniform_offset,
+        size_t first_draw,
+        size_t last_draw
+    ) const;
 
     PerFrame &get_current_frame();
 
+    /** Number of the last frame the GPU has completed. */
+    uint64_t get_completed_frame() const;
+
+    /** Blocks until the GPU has completed a frame. */
+    void wait_for_frame(uint64_t frame) const;
+
     Model triangle = {};
 
-    std::vector<std::shared_ptr<Model>> models;
+    /**
+     * Models in the scene, packed together in no particular order. Anything
+     * that outlives a frame refers to them by handle.
+     */
+    HandlePool<Model> models;
+
+    /** Index of the first draw of every model, and the draw count last */
+    std::vector<size_t> first_draws;
+
+    /**
+     * Models and draws the last packet left out for want of slots in the
+     * object and draw buffers, so the warning is only given when it changes
+     */
+    size_t dropped_object_count = 0;
+    size_t dropped_draw_count = 0;
+
+    TextureCache texture_cache;
+
+    /**
+     * Where a scene model was loaded from, and its handle once it's in. Loads
+     * are numbered by request, and handle is the one loaded_request made.
+     */
+    struct ModelSource
+    {
+        std::string filename;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+        glm::vec3 translation;
+        ModelHandle handle = {};
+        uint32_t last_request = 0;
+        uint32_t loaded_request = 0;
+    };
+    std::vector<ModelSource> model_sources;
+
+    /** A model still being parsed on the thread pool */
+    struct ModelLoad
+    {
+        std::future<std::optional<Model>> model;
+        ModelLoadedCallback on_loaded;
+    };
+    std::vector<ModelLoad> loading_models;
 
     Camera camera;
 
     [[nodiscard]]
     size_t pad_uniform_buffer_size(size_t size) const;
-
-    void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
 };
\ No newline at end of file
@@ -0,0 +1,497 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "Model.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/file_ops.h"
+
+namespace
+{
+    /** Blobs are aligned so they can be copied with wide loads. */
+    constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint32_t get_vertex_stride(EVertexFormat format)
+    {
+        return format == VERTEX_FORMAT_PACKED
+            ? (uint32_t)sizeof(PackedVertex)
+            : (uint32_t)sizeof(Vertex);
+    }
+
+    struct MaterialRecord
+    {
+        glm::vec4 base_color;
+        uint32_t name_length;
+        uint32_t texture_path_length;
+    };
+
+    std::vector<char> encode_materials(const std::vector<Material>& materials)
+    {
+        std::vector<char> bytes;
+        for (const Material& material : materials)
+        {
+            const MaterialRecord record = {
+                material.base_color,
+                (uint32_t)material.name.size(),
+                (uint32_t)material.texture_path.size()
+            };
+            const char* record_bytes = reinterpret_cast<const char*>(&record);
+
+            bytes.insert(
+                bytes.end(), record_bytes, record_bytes + sizeof(record));
+            bytes.insert(
+                bytes.end(), material.name.begin(), material.name.end());
+            bytes.insert(bytes.end(),
+                material.texture_path.begin(), material.texture_path.end());
+        }
+        return bytes;
+    }
+
+    bool decode_materials(
+        const char* bytes,
+        uint64_t size,
+        uint32_t count,
+        std::vector<Material>& materials
+    )
+    {
+        materials.clear();
+        materials.reserve(count);
+
+        uint64_t offset = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            MaterialRecord record;
+            if (offset + sizeof(record) > size)
+            {
+                return false;
+            }
+            memcpy(&record, bytes + offset, sizeof(record));
+            offset += sizeof(record);
+
+            if (offset + record.name_length + record.texture_path_length > size)
+            {
+                return false;
+            }
+
+            Material material;
+            material.base_color = record.base_color;
+            material.name.assign(bytes + offset, record.name_length);
+            offset += record.name_length;
+            material.texture_path.assign(
+                bytes + offset, record.texture_path_length);
+            offset += record.texture_path_length;
+
+            materials.push_back(std::move(material));
+        }
+
+        return true;
+    }
+
+    struct MaterialFileRecord
+    {
+        uint64_t size;
+        int64_t mtime;
+        uint32_t path_length;
+        uint32_t padding;
+    };
+
+    /** Libraries that don't exist get a stamp no file on disk can match */
+    MaterialFileRecord get_material_file_stamp(const std::string& path)
+    {
+        MaterialFileRecord record = {};
+        if (!get_file_stamp(path.c_str(), record.size, record.mtime))
+        {
+            record.size = UINT64_MAX;
+            record.mtime = 0;
+        }
+        record.path_length = (uint32_t)path.size();
+        return record;
+    }
+
+    std::vector<char> encode_material_files(
+        const std::vector<std::string>& material_files)
+    {
+        std::vector<char> bytes;
+        for (const std::string& path : material_files)
+        {
+            const MaterialFileRecord record = get_material_file_stamp(path);
+            const char* record_bytes = reinterpret_cast<const char*>(&record);
+
+            bytes.insert(
+                bytes.end(), record_bytes, record_bytes + sizeof(record));
+            bytes.insert(bytes.end(), path.begin(), path.end());
+        }
+        return bytes;
+    }
+
+    /**
+     * Reads the material libraries back. Fails if the blob is truncated or
+     * any library changed since the cache was written.
+     */
+    bool decode_material_files(
+        const char* bytes,
+        uint64_t size,
+        uint32_t count,
+        std::vector<std::string>& material_files
+    )
+    {
+        material_files.clear();
+        material_files.reserve(count);
+
+        uint64_t offset = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            MaterialFileRecord record;
+            if (offset + sizeof(record) > size)
+            {
+                return false;
+            }
+            memcpy(&record, bytes + offset, sizeof(record));
+            offset += sizeof(record);
+
+            if (offset + record.path_length > size)
+            {
+                return false;
+            }
+
+            std::string path(bytes + offset, record.path_length);
+            offset += record.path_length;
+
+            const MaterialFileRecord stamp = get_material_file_stamp(path);
+            if (stamp.size != record.size || stamp.mtime != record.mtime)
+            {
+                return false;
+            }
+
+            material_files.push_back(std::move(path));
+        }
+
+        return true;
+    }
+
+    /** Whether [offset, offset + size) lies within [0, limit). */
+    bool is_range_inside(uint64_t offset, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    }
+
+    /**
+     * Whether every index and range of a loaded mesh stays inside the arrays
+     * it refers to, so a corrupt cache can't send out of range indices to
+     * the GPU or make the CPU read past an array.
+     */
+    bool validate_mesh(const Model& model)
+    {
+        const uint64_t vertex_count = model.get_vertex_count();
+        for (const uint32_t index : model.indices)
+        {
+            if (index >= vertex_count)
+            {
+                return false;
+            }
+        }
+
+        const uint64_t index_count = model.indices.size();
+        for (const Submesh& submesh : model.submeshes)
+        {
+            if (submesh.material_index >= model.materials.size()
+                || !is_range_inside(
+                    submesh.index_offset, submesh.index_count, index_count)
+                || !is_range_inside(
+                    submesh.lod_offset, submesh.lod_count, model.lods.size()))
+            {
+                return false;
+            }
+        }
+
+        for (const MeshLod& lod : model.lods)
+        {
+            if (!is_range_inside(lod.index_offset, lod.index_count, index_count)
+                || !is_range_inside(lod.meshlet_offset, lod.meshlet_count,
+                    model.meshlets.size()))
+            {
+                return false;
+            }
+        }
+
+        for (const Meshlet& meshlet : model.meshlets)
+        {
+            if (!is_range_inside(
+                    meshlet.index_offset, meshlet.index_count, index_count)
+                || meshlet.vertex_offset != 0
+                || meshlet.vertex_count > vertex_count)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /** Empties what a cache that turned out to be unusable filled in. */
+    void clear_mesh(Model& model)
+    {
+        model.vertices = {};
+        model.packed_vertices = {};
+        model.indices = {};
+        model.meshlets = {};
+        model.lods = {};
+        model.submeshes = {};
+        model.materials = {};
+        model.material_files = {};
+    }
+} // namespace
+
+std::string get_mesh_cache_path(const char* filename)
+{
+    return std::string(filename) + ".vmesh";
+}
+
+bool read_mesh_cache(const char* filename, Model& model)
+{
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!get_file_stamp(filename, source_size, source_mtime))
+    {
+        return false;
+    }
+
+    const std::string cache_path = get_mesh_cache_path(filename);
+
+    MappedFile file;
+    if (!file.open(cache_path.c_str()) || file.size() < sizeof(VMeshHeader))
+    {
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(file.data());
+
+    VMeshHeader header;
+    memcpy(&header, bytes, sizeof(VMeshHeader));
+
+    // Reject caches from other versions or for a different source file
+    if (header.magic != VMESH_MAGIC || header.version != VMESH_VERSION
+        || header.vertex_format != model.vertex_format
+        || header.vertex_stride != get_vertex_stride(model.vertex_format)
+        || header.source_size != source_size
+        || header.source_mtime != source_mtime)
+    {
+        return false;
+    }
+
+    const uint64_t vertex_bytes =
+        (uint64_t)header.vertex_count * header.vertex_stride;
+    const uint64_t index_bytes =
+        (uint64_t)header.index_count * sizeof(uint32_t);
+    const uint64_t meshlet_bytes =
+        (uint64_t)header.meshlet_count * sizeof(Meshlet);
+    const uint64_t lod_bytes = (uint64_t)header.lod_count * sizeof(MeshLod);
+    const uint64_t submesh_bytes =
+        (uint64_t)header.submesh_count * sizeof(Submesh);
+
+    // The materials are baked in, so edits to their libraries make it stale
+    // too
+    if (header.material_file_offset > file.size()
+        || !decode_material_files(bytes + header.material_file_offset,
+            file.size() - header.material_file_offset,
+            header.material_file_count, model.material_files))
+    {
+        clear_mesh(model);
+        return false;
+    }
+
+    if (!is_range_inside(header.vertex_offset, vertex_bytes, file.size())
+        || !is_range_inside(header.index_offset, index_bytes, file.size())
+        || !is_range_inside(header.meshlet_offset, meshlet_bytes, file.size())
+        || !is_range_inside(header.lod_offset, lod_bytes, file.size())
+        || !is_range_inside(header.submesh_offset, submesh_bytes, file.size())
+        || header.material_offset > file.size()
+        || !decode_materials(bytes + header.material_offset,
+            file.size() - header.material_offset, header.material_count,
+            model.materials))
+    {
+        std::cerr << "Truncated mesh cache " << cache_path << ".\n";
+        clear_mesh(model);
+        return false;
+    }
+
+    // Copy the blobs straight out of the mapping
+    if (model.vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        const PackedVertex* vertices =
+            reinterpret_cast<const PackedVertex*>(bytes + header.vertex_offset);
+        model.packed_vertices.assign(vertices, vertices + header.vertex_count);
+    }
+    else
+    {
+        const Vertex* vertices =
+            reinterpret_cast<const Vertex*>(bytes + header.vertex_offset);
+        model.vertices.assign(vertices, vertices + header.vertex_count);
+    }
+
+    const uint32_t* indices =
+        reinterpret_cast<const uint32_t*>(bytes + header.index_offset);
+    model.indices.assign(indices, indices + header.index_count);
+
+    const Meshlet* meshlets =
+        reinterpret_cast<const Meshlet*>(bytes + header.meshlet_offset);
+    model.meshlets.assign(meshlets, meshlets + header.meshlet_count);
+
+    const MeshLod* lods =
+        reinterpret_cast<const MeshLod*>(bytes + header.lod_offset);
+    model.lods.assign(lods, lods + header.lod_count);
+
+    const Submesh* submeshes =
+        reinterpret_cast<const Submesh*>(bytes + header.submesh_offset);
+    model.submeshes.assign(submeshes, submeshes + header.submesh_count);
+
+    if (!validate_mesh(model))
+    {
+        std::cerr << "Corrupt mesh cache " << cache_path << ".\n";
+        clear_mesh(model);
+        return false;
+    }
+
+    model.bounds_min = header.bounds_min;
+    model.bounds_max = header.bounds_max;
+    model.quantization.position_offset = header.position_offset;
+    model.quantization.position_scale = header.position_scale;
+    model.quantization.texcoord_offset = header.texcoord_offset;
+    model.quantization.texcoord_scale = header.texcoord_scale;
+
+    std::cout << "Loaded " << cache_path << "\n";
+
+    return true;
+}
+
+bool write_mesh_cache(const char* filename, const Model& model)
+{
+    VMeshHeader header = {};
+    if (!get_file_stamp(filename, header.source_size, header.source_mtime))
+    {
+        return false;
+    }
+
+    const uint64_t vertex_bytes = model.get_vertex_data_size();
+    const uint64_t index_bytes = model.indices.size() * sizeof(uint32_t);
+    const uint64_t meshlet_bytes = model.meshlets.size() * sizeof(Meshlet);
+    const uint64_t lod_bytes = model.lods.size() * sizeof(MeshLod);
+    const uint64_t submesh_bytes = model.submeshes.size() * sizeof(Submesh);
+    const std::vector<char> material_bytes = encode_materials(model.materials);
+    const std::vector<char> material_file_bytes =
+        encode_material_files(model.material_files);
+
+    header.magic = VMESH_MAGIC;
+    header.version = VMESH_VERSION;
+    header.vertex_format = model.vertex_format;
+    header.vertex_stride = get_vertex_stride(model.vertex_format);
+    header.vertex_count = (uint32_t)(vertex_bytes / header.vertex_stride);
+    header.index_count = (uint32_t)model.indices.size();
+    header.meshlet_count = (uint32_t)model.meshlets.size();
+    header.lod_count = (uint32_t)model.lods.size();
+    header.submesh_count = (uint32_t)model.submeshes.size();
+    header.material_count = (uint32_t)model.materials.size();
+    header.material_file_count = (uint32_t)model.material_files.size();
+    header.vertex_offset = align_up(sizeof(VMeshHeader), BLOB_ALIGNMENT);
+    header.index_offset =
+        align_up(header.vertex_offset + vertex_bytes, BLOB_ALIGNMENT);
+    header.meshlet_offset =
+        align_up(header.index_offset + index_bytes, BLOB_ALIGNMENT);
+    header.lod_offset =
+        align_up(header.meshlet_offset + meshlet_bytes, BLOB_ALIGNMENT);
+    header.submesh_offset =
+        align_up(header.lod_offset + lod_bytes, BLOB_ALIGNMENT);
+    header.material_offset =
+        align_up(header.submesh_offset + submesh_bytes, BLOB_ALIGNMENT);
+    header.material_file_offset =
+        align_up(header.material_offset + material_bytes.size(),
+            BLOB_ALIGNMENT);
+    header.bounds_min = model.bounds_min;
+    header.bounds_max = model.bounds_max;
+    header.position_offset = model.quantization.position_offset;
+    header.position_scale = model.quantization.position_scale;
+    header.texcoord_offset = model.quantization.texcoord_offset;
+    header.texcoord_scale = model.quantization.texcoord_scale;
+
+    // Write to a temporary file first so a crash never leaves a half written
+    // cache behind
+    const std::string cache_path = get_mesh_cache_path(filename);
+    const std::string temp_path = cache_path + ".tmp";
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to write " << temp_path << ".\n";
+            return false;
+        }
+
+        const char padding[BLOB_ALIGNMENT] = {};
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(VMeshHeader));
+        file.write(padding,
+            (std::streamsize)(header.vertex_offset - sizeof(VMeshHeader)));
+        file.write(
+            static_cast<const char*>(model.get_vertex_data()),
+            (std::streamsize)vertex_bytes
+        );
+        file.write(padding, (std::streamsize)(header.index_offset
+            - header.vertex_offset - vertex_bytes));
+        file.write(
+            reinterpret_cast<const char*>(model.indices.data()),
+            (std::streamsize)index_bytes
+        );
+        file.write(padding, (std::streamsize)(header.meshlet_offset
+            - header.index_offset - index_bytes));
+        file.write(
+            reinterpret_cast<const char*>(model.meshlets.data()),
+            (std::streamsize)meshlet_bytes
+        );
+        file.write(padding, (std::streamsize)(header.lod_offset
+            - header.meshlet_offset - meshlet_bytes));
+        file.write(
+            reinterpret_cast<const char*>(model.lods.data()),
+            (std::streamsize)lod_bytes
+        );
+        file.write(padding, (std::streamsize)(header.submesh_offset
+            - header.lod_offset - lod_bytes));
+        file.write(
+            reinterpret_cast<const char*>(model.submeshes.data()),
+            (std::streamsize)submesh_bytes
+        );
+        file.write(padding, (std::streamsize)(header.material_offset
+            - header.submesh_offset - submesh_bytes));
+        file.write(material_bytes.data(),
+            (std::streamsize)material_bytes.size());
+        file.write(padding, (std::streamsize)(header.material_file_offset
+            - header.material_offset - material_bytes.size()));
+        file.write(material_file_bytes.data(),
+            (std::streamsize)material_file_bytes.size());
+
+        if (!file.good())
+        {
+            std::cerr << "Failed to write " << temp_path << ".\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, cache_path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}
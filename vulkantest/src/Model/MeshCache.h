@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+struct Model;
+
+/**
+ * Cooked binary mesh (.vmesh) written next to the source OBJ the first time it
+ * is imported. The file is a header followed by the vertex, index, meshlet,
+ * LOD and submesh blobs in the exact layout they are used in, so loading them
+ * is a single copy out of a memory mapped file. Materials come last, as
+ * records of the base color and the lengths of the name and texture path
+ * followed by the two strings. Then the material libraries they were read
+ * from, as records of the library's size, modification time and path length
+ * followed by the path, so editing a .mtl invalidates the cache too.
+ */
+constexpr uint32_t VMESH_MAGIC = 0x4853454D; // "MESH"
+
+/**
+ * Bump whenever the layout of the header, Vertex or the blobs changes, or the
+ * import pipeline starts producing different data.
+ */
+constexpr uint32_t VMESH_VERSION = 7;
+
+struct VMeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    /** Size and modification time of the source file it was cooked from */
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    uint32_t vertex_format;
+    uint32_t vertex_stride;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t meshlet_count;
+    uint32_t lod_count;
+    uint32_t submesh_count;
+    uint32_t material_count;
+    uint32_t material_file_count;
+
+    /** Byte offsets of the blobs from the start of the file */
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t meshlet_offset;
+    uint64_t lod_offset;
+    uint64_t submesh_offset;
+    uint64_t material_offset;
+    uint64_t material_file_offset;
+
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+
+    /** Unpacking parameters, for VERTEX_FORMAT_PACKED */
+    glm::vec3 position_offset;
+    glm::vec3 position_scale;
+    glm::vec2 texcoord_offset;
+    glm::vec2 texcoord_scale;
+};
+
+/** Returns the path of the cooked mesh for a source file. */
+std::string get_mesh_cache_path(const char* filename);
+
+/**
+ * Loads a model from its cooked mesh. Fails if the cache doesn't exist, was
+ * written by another version, holds a different vertex format than the one
+ * the model asks for or is stale relative to the source file or its material
+ * libraries. Also fails if any index or range points outside the arrays it
+ * refers to, leaving the model empty so it can be imported again.
+ */
+bool read_mesh_cache(const char* filename, Model& model);
+
+/** Writes the cooked mesh for a model imported from a source file. */
+bool write_mesh_cache(const char* filename, const Model& model);
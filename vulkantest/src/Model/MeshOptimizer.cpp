@@ -0,0 +1,460 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+    constexpr uint32_t NO_VERTEX = UINT32_MAX;
+
+    /** Triangles referencing each vertex, as offsets into a flat array. */
+    struct TriangleAdjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> triangles;
+    };
+
+    TriangleAdjacency build_adjacency(
+        const uint32_t* indices,
+        size_t index_count,
+        size_t vertex_count
+    )
+    {
+        TriangleAdjacency adjacency;
+        adjacency.offsets.resize(vertex_count + 1, 0);
+        adjacency.counts.resize(vertex_count, 0);
+        adjacency.triangles.resize(index_count);
+
+        for (size_t i = 0; i < index_count; i++)
+        {
+            adjacency.counts[indices[i]]++;
+        }
+
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            adjacency.offsets[v + 1] = adjacency.offsets[v] + adjacency.counts[v];
+        }
+
+        std::vector<uint32_t> fill(adjacency.offsets.begin(),
+            adjacency.offsets.end() - 1);
+        for (size_t i = 0; i < index_count; i++)
+        {
+            adjacency.triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+        }
+
+        return adjacency;
+    }
+
+    /** Pops dead end vertices, then scans forward for any live vertex. */
+    uint32_t skip_dead_end(
+        const std::vector<uint32_t>& live_triangles,
+        std::vector<uint32_t>& dead_end_stack,
+        uint32_t& cursor
+    )
+    {
+        while (!dead_end_stack.empty())
+        {
+            const uint32_t vertex = dead_end_stack.back();
+            dead_end_stack.pop_back();
+
+            if (live_triangles[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+
+        while (cursor < live_triangles.size())
+        {
+            if (live_triangles[cursor] > 0)
+            {
+                return cursor;
+            }
+            cursor++;
+        }
+
+        return NO_VERTEX;
+    }
+
+    /**
+     * Picks the next fanning vertex among the vertices of the triangles just
+     * emitted: the oldest one that will still be in the cache after all of
+     * its remaining triangles have been emitted.
+     */
+    uint32_t get_next_vertex(
+        const std::vector<uint32_t>& candidates,
+        const std::vector<uint32_t>& live_triangles,
+        const std::vector<uint32_t>& cache_time,
+        std::vector<uint32_t>& dead_end_stack,
+        uint32_t& cursor,
+        uint32_t timestamp,
+        uint32_t cache_size
+    )
+    {
+        uint32_t best_vertex = NO_VERTEX;
+        int64_t best_priority = -1;
+
+        for (const uint32_t vertex : candidates)
+        {
+            if (live_triangles[vertex] == 0)
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (timestamp - cache_time[vertex] + 2 * live_triangles[vertex]
+                <= cache_size)
+            {
+                priority = timestamp - cache_time[vertex];
+            }
+
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                best_vertex = vertex;
+            }
+        }
+
+        if (best_vertex == NO_VERTEX)
+        {
+            best_vertex = skip_dead_end(live_triangles, dead_end_stack, cursor);
+        }
+
+        return best_vertex;
+    }
+
+    /**
+     * Splits a cache optimized triangle list where the cache restarts, i.e.
+     * at triangles whose three vertices all miss. Returns the first triangle
+     * of every cluster.
+     */
+    std::vector<uint32_t> find_cluster_starts(
+        const uint32_t* indices,
+        size_t index_count,
+        size_t vertex_count,
+        uint32_t cache_size
+    )
+    {
+        std::vector<uint32_t> cache_time(vertex_count, 0);
+        uint32_t timestamp = cache_size + 1;
+
+        std::vector<uint32_t> cluster_starts;
+        const size_t triangle_count = index_count / 3;
+
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            uint32_t misses = 0;
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t vertex = indices[3 * t + k];
+                if (timestamp - cache_time[vertex] > cache_size)
+                {
+                    cache_time[vertex] = timestamp++;
+                    misses++;
+                }
+            }
+
+            if (t == 0 || misses == 3)
+            {
+                cluster_starts.push_back((uint32_t)t);
+            }
+        }
+
+        return cluster_starts;
+    }
+} // namespace
+
+VertexCacheStatistics analyze_vertex_cache(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    uint32_t cache_size
+)
+{
+    VertexCacheStatistics stats;
+
+    if (index_count == 0)
+    {
+        return stats;
+    }
+
+    // FIFO cache: a vertex is a hit if fewer than cache_size vertices have
+    // been inserted since it was
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<bool> used(vertex_count, false);
+    uint32_t timestamp = cache_size + 1;
+    size_t unique_vertices = 0;
+
+    for (size_t i = 0; i < index_count; i++)
+    {
+        const uint32_t vertex = indices[i];
+
+        if (timestamp - cache_time[vertex] > cache_size)
+        {
+            cache_time[vertex] = timestamp++;
+            stats.vertices_transformed++;
+        }
+
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            unique_vertices++;
+        }
+    }
+
+    stats.acmr = (float)stats.vertices_transformed / (float)(index_count / 3);
+    stats.atvr = (float)stats.vertices_transformed / (float)unique_vertices;
+
+    return stats;
+}
+
+VertexFetchStatistics analyze_vertex_fetch(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    size_t vertex_size
+)
+{
+    constexpr size_t CACHE_LINE_SIZE = 64;
+    constexpr uint32_t CACHE_LINES = 64;
+
+    VertexFetchStatistics stats;
+
+    if (vertex_count == 0)
+    {
+        return stats;
+    }
+
+    const size_t line_count =
+        (vertex_count * vertex_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+    std::vector<uint32_t> line_time(line_count, 0);
+    uint32_t timestamp = CACHE_LINES + 1;
+
+    for (size_t i = 0; i < index_count; i++)
+    {
+        const size_t first_byte = indices[i] * vertex_size;
+        const size_t first_line = first_byte / CACHE_LINE_SIZE;
+        const size_t last_line = (first_byte + vertex_size - 1) / CACHE_LINE_SIZE;
+
+        for (size_t line = first_line; line <= last_line; line++)
+        {
+            if (timestamp - line_time[line] > CACHE_LINES)
+            {
+                line_time[line] = timestamp++;
+                stats.bytes_fetched += CACHE_LINE_SIZE;
+            }
+        }
+    }
+
+    stats.overfetch =
+        (float)stats.bytes_fetched / (float)(vertex_count * vertex_size);
+
+    return stats;
+}
+
+void optimize_vertex_cache(
+    uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    uint32_t cache_size
+)
+{
+    const size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    const TriangleAdjacency adjacency =
+        build_adjacency(indices, index_count, vertex_count);
+
+    std::vector<uint32_t> live_triangles = adjacency.counts;
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end_stack;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+
+    uint32_t timestamp = cache_size + 1;
+    uint32_t cursor = 0;
+    uint32_t fanning_vertex =
+        skip_dead_end(live_triangles, dead_end_stack, cursor);
+
+    while (fanning_vertex != NO_VERTEX)
+    {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        const uint32_t begin = adjacency.offsets[fanning_vertex];
+        const uint32_t end = adjacency.offsets[fanning_vertex + 1];
+        for (uint32_t a = begin; a < end; a++)
+        {
+            const uint32_t triangle = adjacency.triangles[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t vertex = indices[3 * triangle + k];
+
+                output.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+
+                if (timestamp - cache_time[vertex] > cache_size)
+                {
+                    cache_time[vertex] = timestamp++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        fanning_vertex = get_next_vertex(candidates, live_triangles,
+            cache_time, dead_end_stack, cursor, timestamp, cache_size);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_overdraw(
+    uint32_t* indices,
+    size_t index_count,
+    const std::vector<Vertex>& vertices,
+    float acmr_threshold
+)
+{
+    const size_t triangle_count = index_count / 3;
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    const std::vector<uint32_t> cluster_starts = find_cluster_starts(
+        indices, index_count, vertices.size(), VERTEX_CACHE_SIZE);
+    const size_t cluster_count = cluster_starts.size();
+
+    if (cluster_count < 2)
+    {
+        return;
+    }
+
+    // Area weighted centroid and normal of the whole mesh and every cluster
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+
+    std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+    std::vector<float> cluster_areas(cluster_count, 0.0f);
+
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        const size_t first = cluster_starts[c];
+        const size_t last =
+            c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+
+        for (size_t t = first; t < last; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+
+            const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(cross) * 0.5f;
+            const glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+            cluster_centroids[c] += centroid * area;
+            cluster_normals[c] += cross;
+            cluster_areas[c] += area;
+        }
+
+        mesh_centroid += cluster_centroids[c];
+        mesh_area += cluster_areas[c];
+    }
+
+    if (mesh_area > 0.0f)
+    {
+        mesh_centroid /= mesh_area;
+    }
+
+    // Clusters facing away from the center on the outside of the mesh are
+    // the ones most likely to occlude the rest, so they sort first
+    std::vector<float> sort_keys(cluster_count, 0.0f);
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        if (cluster_areas[c] <= 0.0f)
+        {
+            continue;
+        }
+
+        const glm::vec3 centroid = cluster_centroids[c] / cluster_areas[c];
+        const float normal_length = glm::length(cluster_normals[c]);
+        const glm::vec3 normal = normal_length > 0.0f
+            ? cluster_normals[c] / normal_length
+            : glm::vec3(0.0f);
+
+        sort_keys[c] = glm::dot(centroid - mesh_centroid, normal);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    for (const uint32_t c : order)
+    {
+        const size_t first = cluster_starts[c];
+        const size_t last =
+            c + 1 < cluster_count ? cluster_starts[c + 1] : triangle_count;
+
+        output.insert(output.end(), indices + 3 * first, indices + 3 * last);
+    }
+
+    // Only keep the new order if it doesn't cost too much vertex reuse
+    const VertexCacheStatistics before =
+        analyze_vertex_cache(indices, index_count, vertices.size());
+    const VertexCacheStatistics after =
+        analyze_vertex_cache(output.data(), output.size(), vertices.size());
+
+    if (after.acmr <= before.acmr * acmr_threshold)
+    {
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
+
+std::vector<uint32_t> optimize_vertex_fetch_remap(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count
+)
+{
+    std::vector<uint32_t> remap(vertex_count, NO_VERTEX);
+    uint32_t next_vertex = 0;
+
+    for (size_t i = 0; i < index_count; i++)
+    {
+        if (remap[indices[i]] == NO_VERTEX)
+        {
+            remap[indices[i]] = next_vertex++;
+        }
+    }
+
+    for (uint32_t& new_index : remap)
+    {
+        if (new_index == NO_VERTEX)
+        {
+            new_index = next_vertex++;
+        }
+    }
+
+    return remap;
+}
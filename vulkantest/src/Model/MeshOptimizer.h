@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+/** FIFO cache size used for reordering and analysis, typical of GPUs. */
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+/**
+ * How much an overdraw reorder may worsen the ACMR relative to the vertex
+ * cache optimized order before it's rejected.
+ */
+constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+struct VertexCacheStatistics
+{
+    /** Vertex shader invocations with a simulated post-transform cache */
+    uint32_t vertices_transformed = 0;
+
+    /** Average cache miss ratio: transformed vertices per triangle */
+    float acmr = 0.0f;
+
+    /** Average transform to vertex ratio: transformed per unique vertex */
+    float atvr = 0.0f;
+};
+
+struct VertexFetchStatistics
+{
+    /** Bytes read from the vertex buffer with a simulated fetch cache */
+    uint64_t bytes_fetched = 0;
+
+    /** Bytes fetched relative to the size of the vertex buffer */
+    float overfetch = 0.0f;
+};
+
+/** Simulates a FIFO post-transform cache over a triangle list. */
+VertexCacheStatistics analyze_vertex_cache(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    uint32_t cache_size = VERTEX_CACHE_SIZE
+);
+
+/** Simulates a small cache of 64 byte lines in front of the vertex buffer. */
+VertexFetchStatistics analyze_vertex_fetch(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    size_t vertex_size
+);
+
+/**
+ * Reorders triangles for post-transform cache locality using Tipsify (Sander,
+ * Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+ * Overdraw"). Works in place.
+ */
+void optimize_vertex_cache(
+    uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count,
+    uint32_t cache_size = VERTEX_CACHE_SIZE
+);
+
+/**
+ * Reorders clusters of a cache optimized triangle list so outward facing
+ * clusters on the outside of the mesh are drawn first, which lets early depth
+ * testing reject more of what's behind them from any viewpoint. Keeps the
+ * original order if the ACMR would rise by more than the threshold.
+ */
+void optimize_overdraw(
+    uint32_t* indices,
+    size_t index_count,
+    const std::vector<Vertex>& vertices,
+    float acmr_threshold = OVERDRAW_ACMR_THRESHOLD
+);
+
+/**
+ * Returns a remap table that renumbers vertices in the order the triangles
+ * first reference them, so vertex fetches walk the buffer linearly. Vertices
+ * that are never referenced are moved to the end.
+ */
+std::vector<uint32_t> optimize_vertex_fetch_remap(
+    const uint32_t* indices,
+    size_t index_count,
+    size_t vertex_count
+);
@@ -0,0 +1,252 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+
+namespace
+{
+    constexpr uint32_t NOT_IN_MESHLET = UINT32_MAX;
+
+    /** Triangles whose normals are this far apart disable the cone test. */
+    constexpr float MIN_CONE_SPREAD = 0.1f;
+
+    /**
+     * Fills in the bounding sphere and normal cone of a finished meshlet from
+     * its triangles.
+     */
+    void compute_meshlet_bounds(
+        Meshlet& meshlet,
+        const std::vector<uint32_t>& indices,
+        const std::vector<Vertex>& vertices
+    )
+    {
+        const uint32_t first = meshlet.index_offset;
+        const uint32_t last = meshlet.index_offset + meshlet.index_count;
+
+        // Sphere around the center of the bounding box
+        glm::vec3 bounds_min = vertices[indices[first]].position;
+        glm::vec3 bounds_max = bounds_min;
+        for (uint32_t i = first; i < last; i++)
+        {
+            bounds_min = glm::min(bounds_min, vertices[indices[i]].position);
+            bounds_max = glm::max(bounds_max, vertices[indices[i]].position);
+        }
+
+        const glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = first; i < last; i++)
+        {
+            radius = std::max(radius,
+                glm::length(vertices[indices[i]].position - center));
+        }
+
+        meshlet.bounding_sphere = glm::vec4(center, radius);
+
+        // Cone around the average face normal wide enough to hold every
+        // face normal
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.index_count / 3);
+        glm::vec3 axis(0.0f);
+
+        for (uint32_t i = first; i < last; i += 3)
+        {
+            const glm::vec3& p0 = vertices[indices[i + 0]].position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].position;
+
+            const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            const float length = glm::length(cross);
+
+            // Degenerate triangles have no facing
+            if (length == 0.0f)
+            {
+                continue;
+            }
+
+            normals.push_back(cross / length);
+            axis += normals.back();
+        }
+
+        const float axis_length = glm::length(axis);
+        if (normals.empty() || axis_length == 0.0f)
+        {
+            meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            return;
+        }
+        axis /= axis_length;
+
+        float min_dot = 1.0f;
+        for (const glm::vec3& normal : normals)
+        {
+            min_dot = std::min(min_dot, glm::dot(axis, normal));
+        }
+
+        // The cutoff is the sine of the cone's half angle
+        const float cutoff = min_dot <= MIN_CONE_SPREAD
+            ? 1.0f
+            : std::sqrt(1.0f - min_dot * min_dot);
+
+        meshlet.cone = glm::vec4(axis, cutoff);
+    }
+} // namespace
+
+std::vector<Meshlet> build_meshlets(
+    const std::vector<uint32_t>& indices,
+    const std::vector<Vertex>& vertices,
+    uint32_t first_index,
+    uint32_t index_count
+)
+{
+    std::vector<Meshlet> meshlets;
+
+    // Local slot of every vertex in the meshlet being built
+    std::vector<uint32_t> meshlet_vertex(vertices.size(), NOT_IN_MESHLET);
+    std::vector<uint32_t> meshlet_vertices;
+    meshlet_vertices.reserve(MESHLET_MAX_VERTICES);
+
+    Meshlet meshlet = {};
+    meshlet.index_offset = first_index;
+
+    const auto finish_meshlet = [&]()
+    {
+        compute_meshlet_bounds(meshlet, indices, vertices);
+        meshlet.vertex_count = (uint32_t)meshlet_vertices.size();
+        meshlets.push_back(meshlet);
+
+        for (const uint32_t vertex : meshlet_vertices)
+        {
+            meshlet_vertex[vertex] = NOT_IN_MESHLET;
+        }
+        meshlet_vertices.clear();
+
+        meshlet = {};
+        meshlet.index_offset = meshlets.back().index_offset
+            + meshlets.back().index_count;
+    };
+
+    const size_t last_index = (size_t)first_index + index_count;
+    for (size_t i = first_index; i + 2 < last_index; i += 3)
+    {
+        uint32_t new_vertices = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            new_vertices += meshlet_vertex[indices[i + k]] == NOT_IN_MESHLET;
+        }
+
+        // Start a new meshlet if this triangle doesn't fit
+        if (meshlet_vertices.size() + new_vertices > MESHLET_MAX_VERTICES
+            || meshlet.index_count / 3 == MESHLET_MAX_TRIANGLES)
+        {
+            finish_meshlet();
+        }
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            const uint32_t vertex = indices[i + k];
+            if (meshlet_vertex[vertex] == NOT_IN_MESHLET)
+            {
+                meshlet_vertex[vertex] = (uint32_t)meshlet_vertices.size();
+                meshlet_vertices.push_back(vertex);
+            }
+        }
+
+        meshlet.index_count += 3;
+    }
+
+    if (meshlet.index_count > 0)
+    {
+        finish_meshlet();
+    }
+
+    return meshlets;
+}
+
+Frustum extract_frustum(const glm::mat4& view_projection)
+{
+    // Gribb-Hartmann: each plane is a sum or difference of the rows of the
+    // matrix. glm is column major, so row i is (m[0][i], m[1][i], ...)
+    const glm::mat4 m = glm::transpose(view_projection);
+
+    Frustum frustum;
+    frustum.planes = {
+        m[3] + m[0], // left
+        m[3] - m[0], // right
+        m[3] + m[1], // bottom
+        m[3] - m[1], // top
+        m[2],        // near, z >= 0
+        m[3] - m[2], // far
+    };
+
+    // Normalize so plane distances are in world units
+    for (glm::vec4& plane : frustum.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+bool is_sphere_in_frustum(
+    const Frustum& frustum,
+    const glm::vec3& center,
+    float radius
+)
+{
+    for (const glm::vec4& plane : frustum.planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool is_cone_backfacing(
+    const glm::vec4& cone,
+    const glm::vec3& center,
+    float radius,
+    const glm::vec3& camera_position
+)
+{
+    const glm::vec3 view = center - camera_position;
+    return glm::dot(view, glm::vec3(cone))
+        >= cone.w * glm::length(view) + radius;
+}
+
+bool is_meshlet_visible(
+    const Meshlet& meshlet,
+    const glm::mat4& transform,
+    const Frustum& frustum,
+    const glm::vec3& camera_position
+)
+{
+    const glm::mat3 linear(transform);
+    const glm::vec3 scale(
+        glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+    const float max_scale = std::max(scale.x, std::max(scale.y, scale.z));
+    const float min_scale = std::min(scale.x, std::min(scale.y, scale.z));
+
+    const glm::vec3 center =
+        glm::vec3(transform * glm::vec4(glm::vec3(meshlet.bounding_sphere), 1.0f));
+    const float radius = meshlet.bounding_sphere.w * max_scale;
+
+    if (!is_sphere_in_frustum(frustum, center, radius))
+    {
+        return false;
+    }
+
+    if (max_scale - min_scale > max_scale * 1e-3f || meshlet.cone.w >= 1.0f)
+    {
+        return true;
+    }
+
+    const glm::vec3 axis = glm::normalize(linear * glm::vec3(meshlet.cone));
+    return !is_cone_backfacing(
+        glm::vec4(axis, meshlet.cone.w), center, radius, camera_position);
+}
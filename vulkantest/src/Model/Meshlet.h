@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "Vertex.h"
+
+/** Cluster size limits. 124 triangles keeps the index count under 384. */
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * A cluster of triangles that's culled as a unit. Each meshlet is a contiguous
+ * range of the model's indices, so a visible meshlet is a single indexed
+ * draw. Matches the std430 layout in cull_meshlets.comp.
+ */
+struct Meshlet
+{
+    /** Object space bounding sphere: xyz = center, w = radius */
+    glm::vec4 bounding_sphere;
+
+    /**
+     * Normal cone: xyz = axis, w = cutoff. The meshlet faces away from any
+     * viewer with dot(center - eye, axis) >= cutoff * |center - eye| + radius.
+     * A cutoff of 1 means the triangles are too spread out to ever cull.
+     */
+    glm::vec4 cone;
+
+    /**
+     * Relative to the model's indices and vertices. The copies uploaded to
+     * the meshlet buffer are rebased onto the shared index and vertex buffers.
+     */
+    uint32_t index_offset;
+    uint32_t index_count;
+    uint32_t vertex_count;
+    int32_t vertex_offset;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the shader layout");
+
+/** World space frustum planes, xyz = inward normal, w = distance. */
+struct Frustum
+{
+    std::array<glm::vec4, 6> planes;
+};
+
+/**
+ * Splits a range of a triangle list into meshlets in the order the triangles
+ * are drawn. Run it on a cache optimized index buffer so neighbouring
+ * triangles, and so each meshlet, stay spatially compact.
+ */
+std::vector<Meshlet> build_meshlets(
+    const std::vector<uint32_t>& indices,
+    const std::vector<Vertex>& vertices,
+    uint32_t first_index,
+    uint32_t index_count
+);
+
+/**
+ * Extracts the frustum planes from a view projection matrix with Vulkan's
+ * [0, 1] depth range.
+ */
+Frustum extract_frustum(const glm::mat4& view_projection);
+
+[[nodiscard]]
+bool is_sphere_in_frustum(
+    const Frustum& frustum,
+    const glm::vec3& center,
+    float radius
+);
+
+[[nodiscard]]
+bool is_cone_backfacing(
+    const glm::vec4& cone,
+    const glm::vec3& center,
+    float radius,
+    const glm::vec3& camera_position
+);
+
+/**
+ * CPU version of the test cull_meshlets.comp runs. The cone test is skipped
+ * for non-uniformly scaled models, which don't preserve cone angles.
+ */
+[[nodiscard]]
+bool is_meshlet_visible(
+    const Meshlet& meshlet,
+    const glm::mat4& transform,
+    const Frustum& frustum,
+    const glm::vec3& camera_position
+);
@@ -2,17 +2,195 @@
 
 #define FAST_OBJ_IMPLEMENTATION
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <system_error>
+#include <unordered_map>
 
 #include <fast_obj/fast_obj.h>
+#include <glm/common.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Simplify.h"
+#include "ObjParser.h"
 #include "../Utils/Colors.h"
 #include "../Utils/string_ops.h"
 
+namespace
+{
+    struct FastObjIndexHash
+    {
+        size_t operator()(const fastObjIndex& index) const
+        {
+            // Combine the three attribute indices, FNV-1a style
+            size_t hash = 14695981039346656037ull;
+            hash = (hash ^ index.p) * 1099511628211ull;
+            hash = (hash ^ index.t) * 1099511628211ull;
+            hash = (hash ^ index.n) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    struct FastObjIndexEqual
+    {
+        bool operator()(const fastObjIndex& a, const fastObjIndex& b) const
+        {
+            return a.p == b.p && a.t == b.t && a.n == b.n;
+        }
+    };
+
+    void log_vertex_cache_step(
+        const char* step,
+        const VertexCacheStatistics& before,
+        const VertexCacheStatistics& after
+    )
+    {
+        std::cout << "  " << step << ": ACMR " << before.acmr << " -> "
+                  << after.acmr << ", ATVR " << before.atvr << " -> "
+                  << after.atvr << "\n";
+    }
+
+    Material make_material(const fastObjMaterial& source)
+    {
+        Material material;
+        material.name = source.name ? source.name : "";
+        material.base_color =
+            glm::vec4(source.Kd[0], source.Kd[1], source.Kd[2], source.d);
+
+        if (source.map_Kd.path)
+        {
+            material.texture_path = source.map_Kd.path;
+        }
+
+        return material;
+    }
+
+    /**
+     * File for fast_obj's callbacks that's either on disk or, for the OBJ
+     * itself, a string in memory.
+     */
+    struct CallbackFile
+    {
+        FILE* file = nullptr;
+        const std::string* contents = nullptr;
+        size_t position = 0;
+    };
+
+    /**
+     * The OBJ fast_obj reads, which is only its material lines when they're
+     * given, and the material libraries it opens along the way.
+     */
+    struct ObjSource
+    {
+        const char* filename;
+        const std::string* material_lines;
+        std::vector<std::string>* material_files;
+    };
+
+    void* open_callback_file(const char* path, void* user_data)
+    {
+        const ObjSource* source = static_cast<const ObjSource*>(user_data);
+
+        CallbackFile* file = new CallbackFile;
+        if (strcmp(path, source->filename) == 0)
+        {
+            if (source->material_lines)
+            {
+                file->contents = source->material_lines;
+                return file;
+            }
+        }
+        else
+        {
+            // Anything else is a material library. Ones that fail to open
+            // are recorded too, since they may turn up later
+            std::vector<std::string>& material_files = *source->material_files;
+            if (std::find(material_files.begin(), material_files.end(), path)
+                == material_files.end())
+            {
+                material_files.push_back(path);
+            }
+        }
+
+        file->file = fopen(path, "rb");
+        if (!file->file)
+        {
+            delete file;
+            return nullptr;
+        }
+        return file;
+    }
+
+    void close_callback_file(void* handle, void*)
+    {
+        CallbackFile* file = static_cast<CallbackFile*>(handle);
+        if (file->file)
+        {
+            fclose(file->file);
+        }
+        delete file;
+    }
+
+    size_t read_callback_file(void* handle, void* dst, size_t bytes, void*)
+    {
+        CallbackFile* file = static_cast<CallbackFile*>(handle);
+        if (file->file)
+        {
+            return fread(dst, 1, bytes, file->file);
+        }
+
+        const size_t count =
+            std::min(bytes, file->contents->size() - file->position);
+        memcpy(dst, file->contents->data() + file->position, count);
+        file->position += count;
+        return count;
+    }
+
+    unsigned long get_callback_file_size(void* handle, void*)
+    {
+        CallbackFile* file = static_cast<CallbackFile*>(handle);
+        if (!file->file)
+        {
+            return (unsigned long)file->contents->size();
+        }
+
+        const long position = ftell(file->file);
+        fseek(file->file, 0, SEEK_END);
+        const long size = ftell(file->file);
+        fseek(file->file, position, SEEK_SET);
+        return (unsigned long)size;
+    }
+
+    fastObjCallbacks get_obj_callbacks()
+    {
+        fastObjCallbacks callbacks;
+        callbacks.file_open = open_callback_file;
+        callbacks.file_close = close_callback_file;
+        callbacks.file_read = read_callback_file;
+        callbacks.file_size = get_callback_file_size;
+        return callbacks;
+    }
+} // namespace
+
 bool Model::load_from_obj(const char* filename)
 {
-    fastObjMesh* fast_mesh = fast_obj_read(filename);
+    // Large files are parsed across all cores instead
+    std::error_code ec;
+    const uintmax_t file_size = std::filesystem::file_size(filename, ec);
+    if (!ec && file_size >= PARALLEL_OBJ_THRESHOLD)
+    {
+        return parse_obj_parallel(filename, *this);
+    }
+
+    ObjSource source = { filename, nullptr, &material_files };
+    fastObjCallbacks callbacks = get_obj_callbacks();
+    fastObjMesh* fast_mesh =
+        fast_obj_read_with_callbacks(filename, &callbacks, &source);
 
     if (!fast_mesh)
     {
@@ -20,47 +198,91 @@ bool Model::load_from_obj(const char* filename)
         return false;
     }
 
+    // Maps each unique (position, texcoord, normal) tuple to the index of the
+    // vertex that was created for it, so shared corners are only stored once
+    std::unordered_map<fastObjIndex, uint32_t, FastObjIndexHash, FastObjIndexEqual>
+        unique_vertices;
+    unique_vertices.reserve(fast_mesh->index_count);
+    indices.reserve(fast_mesh->index_count);
+
+    std::vector<uint32_t> triangle_materials;
+    triangle_materials.reserve(fast_mesh->index_count / 3);
+
     Vertex vertex = {};
 
     // For each mesh
     for (uint32_t i = 0; i < fast_mesh->object_count; i++)
     {
         const fastObjGroup object = fast_mesh->objects[i];
-        int idx = 0;
+        uint32_t idx = 0;
 
-        // For each triangle
+        // For each face
         for (uint32_t j = 0; j < object.face_count; j++)
         {
-            // For each vertex
-            for (uint32_t k = 0; k < 3; k++)
+            const uint32_t face_vertices =
+                fast_mesh->face_vertices[object.face_offset + j];
+            const uint32_t face_material =
+                fast_mesh->face_materials[object.face_offset + j];
+
+            // For each vertex. Faces with more than three vertices are split
+            // into a triangle fan
+            for (uint32_t k = 2; k < face_vertices; k++)
             {
-                const fastObjIndex index = fast_mesh->indices[object.index_offset + idx];
-
-                vertex.position = glm::vec3(
-                    fast_mesh->positions[3 * index.p + 0],
-                    fast_mesh->positions[3 * index.p + 1],
-                    fast_mesh->positions[3 * index.p + 2]
-                );
-                vertex.texcoord = glm::vec2(
-                    fast_mesh->texcoords[2 * index.t + 0],
-                    fast_mesh->texcoords[2 * index.t + 1]
-                );
-                vertex.normal = glm::vec3(
-                    fast_mesh->normals[3 * index.n + 0],
-                    fast_mesh->normals[3 * index.n + 1],
-                    fast_mesh->normals[3 * index.n + 2]
-                );
-                vertex.color = Colors::WHITE;
-
-                // Add new vertex to the moel
-                vertices.push_back(vertex);
-
-                idx++;
+                const std::array<uint32_t, 3> corners = { 0, k - 1, k };
+                triangle_materials.push_back(face_material);
+
+                for (const uint32_t corner : corners)
+                {
+                    const fastObjIndex index =
+                        fast_mesh->indices[object.index_offset + idx + corner];
+
+                    // Reuse the vertex if we've already seen this combination
+                    const auto it = unique_vertices.find(index);
+                    if (it != unique_vertices.end())
+                    {
+                        indices.push_back(it->second);
+                        continue;
+                    }
+
+                    vertex.position = glm::vec3(
+                        fast_mesh->positions[3 * index.p + 0],
+                        fast_mesh->positions[3 * index.p + 1],
+                        fast_mesh->positions[3 * index.p + 2]
+                    );
+                    vertex.texcoord = glm::vec2(
+                        fast_mesh->texcoords[2 * index.t + 0],
+                        fast_mesh->texcoords[2 * index.t + 1]
+                    );
+                    vertex.normal = glm::vec3(
+                        fast_mesh->normals[3 * index.n + 0],
+                        fast_mesh->normals[3 * index.n + 1],
+                        fast_mesh->normals[3 * index.n + 2]
+                    );
+                    vertex.color = Colors::WHITE;
+
+                    // Add new vertex to the model
+                    const uint32_t new_index = (uint32_t)vertices.size();
+                    vertices.push_back(vertex);
+                    unique_vertices.emplace(index, new_index);
+                    indices.push_back(new_index);
+                }
             }
+
+            idx += face_vertices;
         }
     }
 
-    std::cout << "Loaded " << filename << "\n";
+    for (uint32_t i = 0; i < fast_mesh->material_count; i++)
+    {
+        materials.push_back(make_material(fast_mesh->materials[i]));
+    }
+
+    build_submeshes(triangle_materials);
+    compute_bounds();
+
+    std::cout << "Loaded " << filename << " (" << vertices.size()
+              << " vertices, " << indices.size() << " indices, "
+              << materials.size() << " materials)\n";
 
     // Destroy the fastobj mesh once we've imported it
     fast_obj_destroy(fast_mesh);
@@ -68,6 +290,285 @@ bool Model::load_from_obj(const char* filename)
     return true;
 }
 
+void Model::build_submeshes(const std::vector<uint32_t>& triangle_materials)
+{
+    submeshes.clear();
+
+    // OBJs without a material library still need something to draw with
+    if (materials.empty())
+    {
+        materials.push_back({ .name = "default" });
+    }
+
+    const auto get_material = [&](size_t triangle)
+    {
+        const uint32_t material = triangle_materials[triangle];
+        return material < materials.size() ? material : 0;
+    };
+
+    // Counting sort of the triangles by material, which keeps the triangles
+    // of each material in file order
+    const size_t triangle_count = indices.size() / 3;
+    std::vector<uint32_t> offsets(materials.size() + 1, 0);
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        offsets[get_material(t) + 1]++;
+    }
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        offsets[m + 1] += offsets[m];
+    }
+
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        const uint32_t triangles = offsets[m + 1] - offsets[m];
+        if (triangles > 0)
+        {
+            submeshes.push_back({ .material_index = (uint32_t)m,
+                .index_offset = 3 * offsets[m],
+                .index_count = 3 * triangles });
+        }
+    }
+
+    std::vector<uint32_t> sorted(indices.size());
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        const uint32_t slot = offsets[get_material(t)]++;
+        sorted[3 * slot + 0] = indices[3 * t + 0];
+        sorted[3 * slot + 1] = indices[3 * t + 1];
+        sorted[3 * slot + 2] = indices[3 * t + 2];
+    }
+    indices = std::move(sorted);
+}
+
+void Model::compute_bounds()
+{
+    if (vertices.empty())
+    {
+        bounds_min = glm::vec3(0.0f);
+        bounds_max = glm::vec3(0.0f);
+        return;
+    }
+
+    bounds_min = vertices[0].position;
+    bounds_max = vertices[0].position;
+
+    for (const Vertex& vertex : vertices)
+    {
+        bounds_min = glm::min(bounds_min, vertex.position);
+        bounds_max = glm::max(bounds_max, vertex.position);
+    }
+}
+
+void Model::optimize()
+{
+    if (indices.empty())
+    {
+        return;
+    }
+
+    uint32_t* index_data = indices.data();
+    const size_t index_count = indices.size();
+    const size_t vertex_count = vertices.size();
+
+    std::cout << "Optimizing " << index_count / 3 << " triangles in "
+              << submeshes.size() << " submeshes\n";
+
+    const VertexCacheStatistics original =
+        analyze_vertex_cache(index_data, index_count, vertex_count);
+
+    // Triangles only move within their submesh
+    for (const Submesh& submesh : submeshes)
+    {
+        optimize_vertex_cache(index_data + submesh.index_offset,
+            submesh.index_count, vertex_count);
+    }
+    const VertexCacheStatistics cache_optimized =
+        analyze_vertex_cache(index_data, index_count, vertex_count);
+    log_vertex_cache_step("vertex cache", original, cache_optimized);
+
+    for (const Submesh& submesh : submeshes)
+    {
+        optimize_overdraw(index_data + submesh.index_offset,
+            submesh.index_count, vertices);
+    }
+    const VertexCacheStatistics overdraw_optimized =
+        analyze_vertex_cache(index_data, index_count, vertex_count);
+    log_vertex_cache_step("overdraw", cache_optimized, overdraw_optimized);
+
+    // Renumber the vertices in the order they're first used
+    const VertexFetchStatistics fetch_before = analyze_vertex_fetch(
+        index_data, index_count, vertex_count, sizeof(Vertex));
+
+    const std::vector<uint32_t> remap =
+        optimize_vertex_fetch_remap(index_data, index_count, vertex_count);
+
+    std::vector<Vertex> remapped_vertices(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++)
+    {
+        remapped_vertices[remap[i]] = vertices[i];
+    }
+    vertices = std::move(remapped_vertices);
+
+    for (uint32_t& index : indices)
+    {
+        index = remap[index];
+    }
+
+    const VertexCacheStatistics fetch_optimized =
+        analyze_vertex_cache(index_data, index_count, vertex_count);
+    const VertexFetchStatistics fetch_after = analyze_vertex_fetch(
+        index_data, index_count, vertex_count, sizeof(Vertex));
+    log_vertex_cache_step("vertex fetch", overdraw_optimized, fetch_optimized);
+    std::cout << "  vertex fetch: overfetch " << fetch_before.overfetch
+              << " -> " << fetch_after.overfetch << "\n";
+}
+
+void Model::generate_lods()
+{
+    lods.clear();
+
+    const float max_error =
+        glm::length(bounds_max - bounds_min) * LOD_MAX_ERROR;
+
+    for (size_t s = 0; s < submeshes.size(); s++)
+    {
+        Submesh& submesh = submeshes[s];
+        submesh.lod_offset = (uint32_t)lods.size();
+
+        lods.push_back({ .index_offset = submesh.index_offset,
+            .index_count = submesh.index_count });
+
+        generate_submesh_lods(s, max_error);
+
+        submesh.lod_count = (uint32_t)lods.size() - submesh.lod_offset;
+    }
+}
+
+void Model::generate_submesh_lods(size_t submesh_index, float max_error)
+{
+    const Submesh& submesh = submeshes[submesh_index];
+
+    std::vector<uint32_t> lod_indices(
+        indices.begin() + submesh.index_offset,
+        indices.begin() + submesh.index_offset + submesh.index_count);
+    float lod_error = 0.0f;
+
+    // Every level is simplified from the previous one, so the errors add up
+    while (lods.size() - submesh.lod_offset < MAX_LODS)
+    {
+        const size_t target_index_count =
+            (size_t)((float)lod_indices.size() * LOD_REDUCTION) / 3 * 3;
+
+        float error;
+        std::vector<uint32_t> simplified = simplify(lod_indices, vertices,
+            target_index_count, max_error - lod_error, error);
+
+        // Stop once the simplifier can't make meaningful progress
+        if (simplified.empty()
+            || simplified.size() > lod_indices.size() * 9 / 10)
+        {
+            break;
+        }
+
+        optimize_vertex_cache(simplified.data(), simplified.size(),
+            vertices.size());
+
+        lod_error += error;
+        lods.push_back({ .index_offset = (uint32_t)indices.size(),
+            .index_count = (uint32_t)simplified.size(), .error = lod_error });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+
+        std::cout << "  submesh " << submesh_index << " LOD "
+                  << lods.size() - 1 - submesh.lod_offset << ": "
+                  << simplified.size() / 3 << " triangles, error "
+                  << lod_error << "\n";
+
+        lod_indices = std::move(simplified);
+    }
+}
+
+void Model::generate_meshlets()
+{
+    meshlets.clear();
+
+    for (MeshLod& lod : lods)
+    {
+        const std::vector<Meshlet> lod_meshlets = build_meshlets(
+            indices, vertices, lod.index_offset, lod.index_count);
+
+        lod.meshlet_offset = (uint32_t)meshlets.size();
+        lod.meshlet_count = (uint32_t)lod_meshlets.size();
+        meshlets.insert(
+            meshlets.end(), lod_meshlets.begin(), lod_meshlets.end());
+    }
+
+    if (meshlets.empty())
+    {
+        return;
+    }
+
+    uint32_t cone_cullable = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        cone_cullable += meshlet.cone.w < 1.0f;
+    }
+
+    std::cout << "Built " << meshlets.size() << " meshlets, "
+              << (float)indices.size() / 3.0f / (float)meshlets.size()
+              << " triangles each on average, " << cone_cullable
+              << " with a usable normal cone\n";
+}
+
+void Model::quantize()
+{
+    quantization = compute_quantization_params(vertices);
+    const QuantizationError error =
+        quantize_vertices(vertices, quantization, packed_vertices);
+    const QuantizationError bound = get_quantization_error_bound(quantization);
+
+    std::cout << "Quantized " << vertices.size() << " vertices, max error"
+              << " position " << error.position << " (bound " << bound.position
+              << "), normal " << error.normal << " rad (bound " << bound.normal
+              << "), texcoord " << error.texcoord << " (bound " << bound.texcoord
+              << ")\n";
+
+    if (error.position > bound.position || error.normal > bound.normal
+        || error.texcoord > bound.texcoord)
+    {
+        std::cerr << "Quantization error exceeds its bound.\n";
+    }
+
+    // The full precision vertices aren't uploaded, so don't keep them around.
+    // This also matches what loading a packed model from the cache gives
+    vertex_format = VERTEX_FORMAT_PACKED;
+    vertices.clear();
+    vertices.shrink_to_fit();
+}
+
+const void* Model::get_vertex_data() const
+{
+    if (vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        return packed_vertices.data();
+    }
+    return vertices.data();
+}
+
+size_t Model::get_vertex_data_size() const
+{
+    return get_vertex_count() * get_vertex_size(vertex_format);
+}
+
+size_t Model::get_vertex_count() const
+{
+    if (vertex_format == VERTEX_FORMAT_PACKED)
+    {
+        return packed_vertices.size();
+    }
+    return vertices.size();
+}
+
 void Model::update()
 {
     const glm::mat4 translation_matrix =
@@ -90,24 +591,75 @@ void Model::update()
     transform = translation_matrix * rotation_matrix * scale_matrix;
 }
 
-std::shared_ptr<Model> create_model(
+std::vector<Material> read_obj_materials(
+    const char* filename,
+    const std::string& material_lines,
+    std::vector<std::string>& material_files
+)
+{
+    // Let fast_obj read an OBJ made of just the material lines, so materials
+    // are resolved and numbered exactly like a full import
+    ObjSource source = { filename, &material_lines, &material_files };
+    fastObjCallbacks callbacks = get_obj_callbacks();
+    fastObjMesh* fast_mesh =
+        fast_obj_read_with_callbacks(filename, &callbacks, &source);
+
+    std::vector<Material> materials;
+    if (!fast_mesh)
+    {
+        return materials;
+    }
+
+    for (uint32_t i = 0; i < fast_mesh->material_count; i++)
+    {
+        materials.push_back(make_material(fast_mesh->materials[i]));
+    }
+
+    fast_obj_destroy(fast_mesh);
+
+    return materials;
+}
+
+std::optional<Model> create_model(
     const char* filename,
     const glm::vec3& rotation,
     const glm::vec3& scale,
-    const glm::vec3& translation
+    const glm::vec3& translation,
+    EVertexFormat vertex_format
 )
 {
-    std::shared_ptr<Model> model = std::make_shared<Model>();
-    const bool success = model->load_from_obj(filename);
+    Model model;
+    model.vertex_format = vertex_format;
 
-    if (!success)
+    // Use the cooked mesh if it's still up to date, otherwise import the OBJ
+    // and cook it for next time
+    if (!read_mesh_cache(filename, model))
     {
-        return nullptr;
+        const bool success = model.load_from_obj(filename);
+
+        if (!success)
+        {
+            return std::nullopt;
+        }
+
+        model.optimize();
+        model.generate_lods();
+        model.generate_meshlets();
+
+        if (vertex_format == VERTEX_FORMAT_PACKED)
+        {
+            model.quantize();
+        }
+
+        if (!write_mesh_cache(filename, model))
+        {
+            std::cerr << "Failed to write mesh cache for " << filename << ".\n";
+        }
     }
 
-    model->rotation = rotation;
-    model->scale = scale;
-    model->translation = translation;
+    model.rotation = rotation;
+    model.scale = scale;
+    model.translation = translation;
 
     return model;
 }
@@ -1,25 +1,126 @@
 #pragma once
 
 #include <array>
-#include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
 
+#include "Meshlet.h"
+#include "Quantize.h"
 #include "Vertex.h"
-#include "../VulkanRenderer/vktypes.h"
 
+/** Most levels of detail generated per model, including the full mesh */
+constexpr uint32_t MAX_LODS = 4;
+
+/** Fraction of the previous level's triangles each level of detail aims for */
+constexpr float LOD_REDUCTION = 0.5f;
+
+/** Largest simplification error allowed, relative to the bounds diagonal */
+constexpr float LOD_MAX_ERROR = 0.05f;
+
+/** One level of detail: a range of the shared index buffer and its meshlets */
+struct MeshLod
+{
+    uint32_t index_offset;
+    uint32_t index_count;
+    uint32_t meshlet_offset;
+    uint32_t meshlet_count;
+
+    /** Object space distance the surface may have moved from the full mesh */
+    float error;
+};
+
+/** Surface parameters imported from an OBJ's material library */
 struct Material
 {
-    VkPipeline pipeline;
-    VkPipelineLayout pipeline_layout;
+    std::string name;
+
+    /** Diffuse color (Kd), multiplied with the texture */
+    glm::vec4 base_color = glm::vec4(1.0f);
+
+    /** Path of the diffuse texture (map_Kd), empty if it has none */
+    std::string texture_path;
+};
+
+/** The triangles of a model drawn with one material */
+struct Submesh
+{
+    uint32_t material_index;
+
+    /** Range of the full detail triangles in the index buffer */
+    uint32_t index_offset;
+    uint32_t index_count;
+
+    /** Range of the submesh's levels of detail in Model::lods */
+    uint32_t lod_offset;
+    uint32_t lod_count;
 };
 
+/**
+ * A mesh and where it lives on the GPU. The vertices, indices and meshlets
+ * are emptied once they're staged for upload, after which the counts and
+ * ranges below describe them.
+ */
 struct Model
 {
     std::vector<Vertex> vertices;
-    Buffer vertex_buffer;
-    std::unique_ptr<Material> material;
+
+    /**
+     * Index ranges of every submesh and level of detail. The full detail
+     * submeshes come first, sorted by material.
+     */
+    std::vector<uint32_t> indices;
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+
+    /** Materials the submeshes index */
+    std::vector<Material> materials;
+
+    /**
+     * Material libraries the materials were read from, including ones that
+     * couldn't be opened, so cooked meshes can tell when they change.
+     */
+    std::vector<std::string> material_files;
+
+    /**
+     * Layout the vertices are uploaded in. Packed models keep their vertices
+     * in packed_vertices only, along with the parameters to unpack them.
+     */
+    EVertexFormat vertex_format = VERTEX_FORMAT_FULL;
+    std::vector<PackedVertex> packed_vertices;
+    QuantizationParams quantization;
+
+    /**
+     * Clusters of the index buffer for GPU culling, grouped by level of
+     * detail. Empty for models that weren't imported, which are always drawn
+     * whole.
+     */
+    std::vector<Meshlet> meshlets;
+
+    /**
+     * Ranges of the model's vertices and indices in the renderer's shared
+     * vertex and index buffers, counted in vertices and indices
+     */
+    uint32_t vertex_offset = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+
+    /**
+     * Slots of the model's meshlets and materials in the renderer's meshlet
+     * and material buffers. The counts are 0 when they didn't fit
+     */
+    uint32_t meshlet_offset = 0;
+    uint32_t meshlet_count = 0;
+    uint32_t material_offset = 0;
+    uint32_t material_count = 0;
+
+    /** Object space bounding box of the vertices */
+    glm::vec3 bounds_min = glm::vec3(0.0f);
+    glm::vec3 bounds_max = glm::vec3(0.0f);
 
     glm::vec3 rotation = glm::vec3(0.0f);
     glm::vec3 scale = glm::vec3(1.0f);
@@ -27,12 +128,56 @@ struct Model
     glm::mat4 transform;
 
     bool load_from_obj(const char *filename);
+
+    /**
+     * Sorts the triangles by material, given the material of every triangle,
+     * and creates a submesh for every material that's used.
+     */
+    void build_submeshes(const std::vector<uint32_t>& triangle_materials);
+    void compute_bounds();
+
+    /**
+     * Reorders triangles for post-transform cache reuse and overdraw, then
+     * vertices for fetch locality. Logs the cache statistics of every step.
+     */
+    void optimize();
+
+    /**
+     * Appends progressively simplified copies of every submesh to the index
+     * buffer. The vertex buffer is shared by every level.
+     */
+    void generate_lods();
+    void generate_submesh_lods(size_t submesh_index, float max_error);
+    void generate_meshlets();
+    void quantize();
+
+    /** Vertex data in the model's vertex format, ready for upload. */
+    [[nodiscard]]
+    const void *get_vertex_data() const;
+    [[nodiscard]]
+    size_t get_vertex_data_size() const;
+    [[nodiscard]]
+    size_t get_vertex_count() const;
     void update();
 };
 
-std::shared_ptr<Model> create_model(
+/**
+ * Reads the materials an OBJ's mtllib and usemtl lines refer to, numbered the
+ * same way fast_obj numbers them while importing. material_lines holds only
+ * those lines, in file order. The libraries the lines name are added to
+ * material_files.
+ */
+std::vector<Material> read_obj_materials(
+    const char* filename,
+    const std::string& material_lines,
+    std::vector<std::string>& material_files
+);
+
+/** Returns nothing when the model fails to import. */
+std::optional<Model> create_model(
     const char* filename,
     const glm::vec3& rotation = glm::vec3(0.0f),
     const glm::vec3& scale = glm::vec3(1.0f),
-    const glm::vec3& translation = glm::vec3(0.0f)
+    const glm::vec3& translation = glm::vec3(0.0f),
+    EVertexFormat vertex_format = VERTEX_FORMAT_FULL
 );
\ No newline at end of file
@@ -0,0 +1,605 @@
+#include "ObjParser.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+#include "../Utils/Colors.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/ThreadPool.h"
+
+namespace
+{
+    /** Chunks smaller than this aren't worth handing to another thread. */
+    constexpr size_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+    /** Number of chunks per pool thread, to even out uneven lines. */
+    constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    /**
+     * Face corner as written in the file. Negative (relative) indices can't be
+     * resolved until the attribute counts of the preceding chunks are known,
+     * so they're stored relative to the start of the chunk and flagged.
+     */
+    struct RawIndex
+    {
+        int64_t p;
+        int64_t t;
+        int64_t n;
+        uint8_t relative; // bit 0 = p, bit 1 = t, bit 2 = n
+    };
+
+    /** A usemtl line: the material of every face from face onwards. */
+    struct MaterialSwitch
+    {
+        uint32_t face; // Relative to the chunk
+        std::string name;
+    };
+
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+
+        std::vector<float> positions;
+        std::vector<float> texcoords;
+        std::vector<float> normals;
+        std::vector<uint32_t> face_vertices;
+        std::vector<RawIndex> indices;
+
+        // The chunk's mtllib and usemtl lines, in file order
+        std::string material_lines;
+        std::vector<MaterialSwitch> material_switches;
+
+        // Offsets into the merged arrays, filled by the prefix sums
+        size_t position_offset = 0;
+        size_t texcoord_offset = 0;
+        size_t normal_offset = 0;
+        size_t index_offset = 0;
+    };
+
+    /** Identifies a vertex by its (position, texcoord, normal) indices. */
+    struct ObjIndex
+    {
+        uint32_t p;
+        uint32_t t;
+        uint32_t n;
+
+        bool operator==(const ObjIndex& other) const
+        {
+            return p == other.p && t == other.t && n == other.n;
+        }
+    };
+
+    struct ObjIndexHash
+    {
+        size_t operator()(const ObjIndex& index) const
+        {
+            size_t hash = 14695981039346656037ull;
+            hash = (hash ^ index.p) * 1099511628211ull;
+            hash = (hash ^ index.t) * 1099511628211ull;
+            hash = (hash ^ index.n) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    // The token parsers below mirror the ones in fast_obj exactly so both
+    // import paths produce bit identical floats and indices
+
+    constexpr int MAX_POWER = 20;
+
+    constexpr std::array<double, MAX_POWER> POWER_10_POS = {
+        1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,
+        1.0e7,  1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13,
+        1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18, 1.0e19,
+    };
+
+    constexpr std::array<double, MAX_POWER> POWER_10_NEG = {
+        1.0e0,   1.0e-1,  1.0e-2,  1.0e-3,  1.0e-4,  1.0e-5,  1.0e-6,
+        1.0e-7,  1.0e-8,  1.0e-9,  1.0e-10, 1.0e-11, 1.0e-12, 1.0e-13,
+        1.0e-14, 1.0e-15, 1.0e-16, 1.0e-17, 1.0e-18, 1.0e-19,
+    };
+
+    bool is_whitespace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    const char* skip_whitespace(const char* ptr)
+    {
+        while (is_whitespace(*ptr))
+        {
+            ptr++;
+        }
+        return ptr;
+    }
+
+    bool is_end_of_name(char c)
+    {
+        return c == '\t' || c == '\r' || c == '\n';
+    }
+
+    const char* skip_line(const char* ptr)
+    {
+        while (*ptr++ != '\n')
+        {
+        }
+        return ptr;
+    }
+
+    bool is_keyword(const char* ptr, const char* keyword, size_t length)
+    {
+        return strncmp(ptr, keyword, length) == 0 && is_whitespace(ptr[length]);
+    }
+
+    const char* parse_int(const char* ptr, int64_t& value)
+    {
+        int64_t sign = 1;
+        if (*ptr == '-')
+        {
+            sign = -1;
+            ptr++;
+        }
+
+        int64_t num = 0;
+        while (is_digit(*ptr))
+        {
+            num = 10 * num + (*ptr++ - '0');
+        }
+
+        value = sign * num;
+
+        return ptr;
+    }
+
+    const char* parse_float(const char* ptr, float& value)
+    {
+        ptr = skip_whitespace(ptr);
+
+        double sign = 1.0;
+        if (*ptr == '+')
+        {
+            ptr++;
+        }
+        else if (*ptr == '-')
+        {
+            sign = -1.0;
+            ptr++;
+        }
+
+        double num = 0.0;
+        while (is_digit(*ptr))
+        {
+            num = 10.0 * num + (double)(*ptr++ - '0');
+        }
+
+        if (*ptr == '.')
+        {
+            ptr++;
+        }
+
+        double fra = 0.0;
+        double div = 1.0;
+        while (is_digit(*ptr))
+        {
+            fra = 10.0 * fra + (double)(*ptr++ - '0');
+            div *= 10.0;
+        }
+
+        num += fra / div;
+
+        if (*ptr == 'e' || *ptr == 'E')
+        {
+            ptr++;
+
+            const std::array<double, MAX_POWER>* powers = &POWER_10_POS;
+            if (*ptr == '+')
+            {
+                ptr++;
+            }
+            else if (*ptr == '-')
+            {
+                powers = &POWER_10_NEG;
+                ptr++;
+            }
+
+            unsigned int eval = 0;
+            while (is_digit(*ptr))
+            {
+                eval = 10 * eval + (*ptr++ - '0');
+            }
+
+            num *= (eval >= MAX_POWER) ? 0.0 : (*powers)[eval];
+        }
+
+        value = (float)(sign * num);
+
+        return ptr;
+    }
+
+    const char* parse_floats(const char* ptr, std::vector<float>& out, int count)
+    {
+        float value;
+        for (int i = 0; i < count; i++)
+        {
+            ptr = parse_float(ptr, value);
+            out.push_back(value);
+        }
+        return ptr;
+    }
+
+    const char* parse_face(ObjChunk& chunk, const char* ptr)
+    {
+        // Attribute counts so far in this chunk, for relative indices
+        const int64_t num_positions = (int64_t)chunk.positions.size() / 3;
+        const int64_t num_texcoords = (int64_t)chunk.texcoords.size() / 2;
+        const int64_t num_normals = (int64_t)chunk.normals.size() / 3;
+
+        ptr = skip_whitespace(ptr);
+
+        uint32_t count = 0;
+        while (*ptr != '\n')
+        {
+            const char* start = ptr;
+
+            int64_t v = 0;
+            int64_t t = 0;
+            int64_t n = 0;
+
+            ptr = parse_int(ptr, v);
+            if (*ptr == '/')
+            {
+                ptr++;
+                if (*ptr != '/')
+                {
+                    ptr = parse_int(ptr, t);
+                }
+                if (*ptr == '/')
+                {
+                    ptr++;
+                    ptr = parse_int(ptr, n);
+                }
+            }
+
+            RawIndex index = { v, t, n, 0 };
+            if (v < 0)
+            {
+                index.p = num_positions + v;
+                index.relative |= 1;
+            }
+            if (t < 0)
+            {
+                index.t = num_texcoords + t;
+                index.relative |= 2;
+            }
+            if (n < 0)
+            {
+                index.n = num_normals + n;
+                index.relative |= 4;
+            }
+
+            chunk.indices.push_back(index);
+            count++;
+
+            ptr = skip_whitespace(ptr);
+
+            // Stop on malformed faces instead of spinning on the same token
+            if (ptr == start)
+            {
+                break;
+            }
+        }
+
+        chunk.face_vertices.push_back(count);
+
+        return ptr;
+    }
+
+    void parse_chunk(ObjChunk& chunk)
+    {
+        const char* p = chunk.begin;
+        while (p != chunk.end)
+        {
+            p = skip_whitespace(p);
+
+            if (p[0] == 'v')
+            {
+                if (p[1] == ' ' || p[1] == '\t')
+                {
+                    p = parse_floats(p + 2, chunk.positions, 3);
+                }
+                else if (p[1] == 't')
+                {
+                    p = parse_floats(p + 2, chunk.texcoords, 2);
+                }
+                else if (p[1] == 'n')
+                {
+                    p = parse_floats(p + 2, chunk.normals, 3);
+                }
+            }
+            else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                p = parse_face(chunk, p + 2);
+            }
+            else if (is_keyword(p, "usemtl", 6))
+            {
+                const char* name = skip_whitespace(p + 6);
+                const char* name_end = name;
+                while (!is_end_of_name(*name_end))
+                {
+                    name_end++;
+                }
+
+                chunk.material_switches.push_back({
+                    (uint32_t)chunk.face_vertices.size(),
+                    std::string(name, name_end) });
+                chunk.material_lines.append(p, skip_line(p));
+            }
+            else if (is_keyword(p, "mtllib", 6))
+            {
+                chunk.material_lines.append(p, skip_line(p));
+            }
+
+            // Objects and groups don't affect the geometry
+            p = skip_line(p);
+        }
+    }
+
+    uint32_t resolve_index(int64_t value, bool relative, size_t chunk_offset)
+    {
+        // Chunk offsets include the dummy attribute at index 0
+        return relative ? (uint32_t)((int64_t)chunk_offset + value)
+                        : (uint32_t)value;
+    }
+} // namespace
+
+bool parse_obj_parallel(const char* filename, Model& model)
+{
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        std::cerr << "Failed to load " << filename << ".\n";
+        return false;
+    }
+
+    ThreadPool& pool = get_thread_pool();
+
+    const char* data = static_cast<const char*>(file.data());
+    const size_t size = file.size();
+
+    // Only the part up to the last newline can be parsed in place, since the
+    // parser relies on every line being newline terminated
+    size_t body_size = size;
+    while (body_size > 0 && data[body_size - 1] != '\n')
+    {
+        body_size--;
+    }
+    const std::string tail = std::string(data + body_size, size - body_size) + "\n";
+
+    // Split the body into chunks at line boundaries
+    const size_t target_chunks = std::max<size_t>(
+        1, std::min(body_size / MIN_CHUNK_SIZE,
+            (size_t)pool.get_thread_count() * CHUNKS_PER_THREAD));
+    const size_t target_size = body_size / target_chunks + 1;
+
+    std::vector<ObjChunk> chunks;
+    size_t begin = 0;
+    while (begin < body_size)
+    {
+        size_t end = std::min(begin + target_size, body_size);
+        while (data[end - 1] != '\n')
+        {
+            end++;
+        }
+
+        ObjChunk chunk;
+        chunk.begin = data + begin;
+        chunk.end = data + end;
+        chunks.push_back(std::move(chunk));
+
+        begin = end;
+    }
+
+    if (size > body_size)
+    {
+        ObjChunk chunk;
+        chunk.begin = tail.data();
+        chunk.end = tail.data() + tail.size();
+        chunks.push_back(std::move(chunk));
+    }
+
+    // Parse every chunk independently
+    pool.parallel_for(chunks.size(), [&](size_t i) { parse_chunk(chunks[i]); });
+
+    // Prefix sums give each chunk its place in the merged arrays. Attribute
+    // arrays start with the same dummy entry fast_obj adds at index 0
+    std::vector<float> positions = { 0.0f, 0.0f, 0.0f };
+    std::vector<float> texcoords = { 0.0f, 0.0f };
+    std::vector<float> normals = { 0.0f, 0.0f, 1.0f };
+
+    size_t position_count = positions.size();
+    size_t texcoord_count = texcoords.size();
+    size_t normal_count = normals.size();
+    size_t index_count = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.position_offset = position_count;
+        chunk.texcoord_offset = texcoord_count;
+        chunk.normal_offset = normal_count;
+        chunk.index_offset = index_count;
+
+        position_count += chunk.positions.size();
+        texcoord_count += chunk.texcoords.size();
+        normal_count += chunk.normals.size();
+        index_count += chunk.indices.size();
+    }
+
+    positions.resize(position_count);
+    texcoords.resize(texcoord_count);
+    normals.resize(normal_count);
+    std::vector<ObjIndex> indices(index_count);
+
+    // Merge attributes and resolve face indices into the global index space
+    pool.parallel_for(chunks.size(),
+        [&](size_t i)
+        {
+            const ObjChunk& chunk = chunks[i];
+
+            std::copy(chunk.positions.begin(), chunk.positions.end(),
+                positions.begin() + (ptrdiff_t)chunk.position_offset);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+                texcoords.begin() + (ptrdiff_t)chunk.texcoord_offset);
+            std::copy(chunk.normals.begin(), chunk.normals.end(),
+                normals.begin() + (ptrdiff_t)chunk.normal_offset);
+
+            for (size_t j = 0; j < chunk.indices.size(); j++)
+            {
+                const RawIndex& raw = chunk.indices[j];
+                indices[chunk.index_offset + j] = {
+                    resolve_index(raw.p, raw.relative & 1, chunk.position_offset / 3),
+                    resolve_index(raw.t, raw.relative & 2, chunk.texcoord_offset / 2),
+                    resolve_index(raw.n, raw.relative & 4, chunk.normal_offset / 3)
+                };
+            }
+        }
+    );
+
+    // Weld vertices. This has to walk the faces in file order to number the
+    // vertices the same way as the serial importer, so it stays on one thread
+    std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> unique_vertices;
+    unique_vertices.reserve(index_count);
+
+    std::vector<ObjIndex> vertex_sources;
+    model.indices.clear();
+    model.indices.reserve(index_count);
+
+    // Materials are resolved like fast_obj does: by reading every material
+    // line in order, with usemtl picking the first material of that name
+    std::string material_lines;
+    for (const ObjChunk& chunk : chunks)
+    {
+        material_lines += chunk.material_lines;
+    }
+    model.materials = material_lines.empty()
+        ? std::vector<Material>()
+        : read_obj_materials(filename, material_lines, model.material_files);
+
+    const auto find_material = [&](const std::string& name)
+    {
+        for (size_t m = 0; m < model.materials.size(); m++)
+        {
+            if (model.materials[m].name == name)
+            {
+                return (uint32_t)m;
+            }
+        }
+        return 0u;
+    };
+
+    std::vector<uint32_t> triangle_materials;
+    triangle_materials.reserve(index_count / 3);
+    uint32_t material = 0;
+
+    size_t idx = 0;
+    for (const ObjChunk& chunk : chunks)
+    {
+        size_t next_switch = 0;
+
+        for (size_t f = 0; f < chunk.face_vertices.size(); f++)
+        {
+            while (next_switch < chunk.material_switches.size()
+                && chunk.material_switches[next_switch].face == f)
+            {
+                material = find_material(
+                    chunk.material_switches[next_switch].name);
+                next_switch++;
+            }
+
+            const uint32_t face_vertices = chunk.face_vertices[f];
+            for (uint32_t k = 2; k < face_vertices; k++)
+            {
+                const std::array<uint32_t, 3> corners = { 0, k - 1, k };
+                triangle_materials.push_back(material);
+
+                for (const uint32_t corner : corners)
+                {
+                    const ObjIndex& index = indices[idx + corner];
+
+                    const auto [it, inserted] = unique_vertices.emplace(
+                        index, (uint32_t)vertex_sources.size());
+                    if (inserted)
+                    {
+                        vertex_sources.push_back(index);
+                    }
+                    model.indices.push_back(it->second);
+                }
+            }
+
+            idx += face_vertices;
+        }
+
+        // Switches after the chunk's last face carry over to the next chunk
+        if (next_switch < chunk.material_switches.size())
+        {
+            material = find_material(chunk.material_switches.back().name);
+        }
+    }
+
+    // Gather the attributes of each unique vertex
+    model.vertices.resize(vertex_sources.size());
+
+    const size_t vertices_per_task = 64 * 1024;
+    const size_t num_tasks =
+        (vertex_sources.size() + vertices_per_task - 1) / vertices_per_task;
+
+    pool.parallel_for(num_tasks,
+        [&](size_t task)
+        {
+            const size_t first = task * vertices_per_task;
+            const size_t last =
+                std::min(first + vertices_per_task, vertex_sources.size());
+
+            for (size_t i = first; i < last; i++)
+            {
+                const ObjIndex& index = vertex_sources[i];
+                Vertex& vertex = model.vertices[i];
+
+                vertex.position = glm::vec3(
+                    positions[3 * index.p + 0],
+                    positions[3 * index.p + 1],
+                    positions[3 * index.p + 2]
+                );
+                vertex.texcoord = glm::vec2(
+                    texcoords[2 * index.t + 0],
+                    texcoords[2 * index.t + 1]
+                );
+                vertex.normal = glm::vec3(
+                    normals[3 * index.n + 0],
+                    normals[3 * index.n + 1],
+                    normals[3 * index.n + 2]
+                );
+                vertex.color = Colors::WHITE;
+            }
+        }
+    );
+
+    model.build_submeshes(triangle_materials);
+    model.compute_bounds();
+
+    std::cout << "Loaded " << filename << " (" << model.vertices.size()
+              << " vertices, " << model.indices.size() << " indices, "
+              << model.materials.size() << " materials, " << chunks.size()
+              << " chunks)\n";
+
+    return true;
+}
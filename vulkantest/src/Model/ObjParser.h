@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+struct Model;
+
+/** Files at least this large are imported with the parallel parser. */
+constexpr uint64_t PARALLEL_OBJ_THRESHOLD = 16 * 1024 * 1024;
+
+/**
+ * Imports an OBJ using every thread in the shared thread pool. The file is
+ * memory mapped and split at line boundaries into chunks that are parsed
+ * independently, then the per-chunk attribute and face arrays are stitched
+ * together with prefix sums. Produces the same vertices and indices as
+ * Model::load_from_obj.
+ */
+bool parse_obj_parallel(const char* filename, Model& model);
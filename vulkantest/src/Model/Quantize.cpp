@@ -0,0 +1,226 @@
+#include "Quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "../Utils/Colors.h"
+
+namespace
+{
+    constexpr float SNORM16_MAX = 32767.0f;
+    constexpr float UNORM16_MAX = 65535.0f;
+
+    /** Bounds smaller than this are treated as flat on that axis. */
+    constexpr float MIN_EXTENT = 1e-8f;
+
+    /**
+     * Worst case angular error of 16 bit octahedral normals. Sweeping the
+     * sphere gives about 6.4e-5 radians, this leaves some headroom.
+     */
+    constexpr float OCT16_MAX_ANGLE_ERROR = 7.5e-5f;
+
+    int16_t to_snorm16(float value)
+    {
+        return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX);
+    }
+
+    uint16_t to_unorm16(float value)
+    {
+        return (uint16_t)std::lround(std::clamp(value, 0.0f, 1.0f) * UNORM16_MAX);
+    }
+
+    // Conversions as specified for the Vulkan SNORM and UNORM formats
+    float from_snorm16(int16_t value)
+    {
+        return std::max((float)value / SNORM16_MAX, -1.0f);
+    }
+
+    float from_unorm16(uint16_t value)
+    {
+        return (float)value / UNORM16_MAX;
+    }
+
+    float sign_not_zero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+} // namespace
+
+QuantizationParams compute_quantization_params(
+    const std::vector<Vertex>& vertices)
+{
+    QuantizationParams params;
+
+    if (vertices.empty())
+    {
+        return params;
+    }
+
+    glm::vec3 pos_min = vertices[0].position;
+    glm::vec3 pos_max = vertices[0].position;
+    glm::vec2 uv_min = vertices[0].texcoord;
+    glm::vec2 uv_max = vertices[0].texcoord;
+
+    for (const Vertex& vertex : vertices)
+    {
+        pos_min = glm::min(pos_min, vertex.position);
+        pos_max = glm::max(pos_max, vertex.position);
+        uv_min = glm::min(uv_min, vertex.texcoord);
+        uv_max = glm::max(uv_max, vertex.texcoord);
+    }
+
+    // Positions map [-1, 1] onto the bounds, texcoords map [0, 1]
+    params.position_offset = (pos_min + pos_max) * 0.5f;
+    params.position_scale =
+        glm::max((pos_max - pos_min) * 0.5f, glm::vec3(MIN_EXTENT));
+    params.texcoord_offset = uv_min;
+    params.texcoord_scale = glm::max(uv_max - uv_min, glm::vec2(MIN_EXTENT));
+
+    return params;
+}
+
+QuantizationError get_quantization_error_bound(
+    const QuantizationParams& params)
+{
+    const glm::vec3 position_step = params.position_scale / SNORM16_MAX;
+    const glm::vec2 texcoord_step = params.texcoord_scale / UNORM16_MAX;
+
+    // Allow for fp32 rounding in the scale and offset math, a couple of ulps
+    // of the largest magnitude involved
+    const float epsilon = 2.0f * std::numeric_limits<float>::epsilon();
+    const glm::vec3 position_slack =
+        epsilon * (glm::abs(params.position_offset) + params.position_scale);
+    const glm::vec2 texcoord_slack =
+        epsilon * (glm::abs(params.texcoord_offset) + params.texcoord_scale);
+
+    QuantizationError bound;
+    bound.position = glm::length(position_step * 0.5f + position_slack);
+    bound.normal = OCT16_MAX_ANGLE_ERROR;
+    bound.texcoord = glm::length(texcoord_step * 0.5f + texcoord_slack);
+
+    return bound;
+}
+
+glm::vec2 oct_encode(const glm::vec3& normal)
+{
+    const float length_l1 =
+        std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+    // Degenerate normals get the same default fast_obj uses
+    if (length_l1 < MIN_EXTENT)
+    {
+        return glm::vec2(0.0f);
+    }
+
+    // Project onto the octahedron, then fold the lower half over the upper
+    glm::vec2 p = glm::vec2(normal.x, normal.y) / length_l1;
+    if (normal.z < 0.0f)
+    {
+        p = glm::vec2(
+            (1.0f - std::abs(p.y)) * sign_not_zero(p.x),
+            (1.0f - std::abs(p.x)) * sign_not_zero(p.y)
+        );
+    }
+
+    return p;
+}
+
+glm::vec3 oct_decode(const glm::vec2& encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y,
+        1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return glm::normalize(n);
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const QuantizationParams& params)
+{
+    const glm::vec3 position =
+        (vertex.position - params.position_offset) / params.position_scale;
+    const glm::vec2 texcoord =
+        (vertex.texcoord - params.texcoord_offset) / params.texcoord_scale;
+    const glm::vec2 normal = oct_encode(vertex.normal);
+
+    PackedVertex packed;
+    packed.position[0] = to_snorm16(position.x);
+    packed.position[1] = to_snorm16(position.y);
+    packed.position[2] = to_snorm16(position.z);
+    packed.position[3] = 0;
+    packed.normal[0] = to_snorm16(normal.x);
+    packed.normal[1] = to_snorm16(normal.y);
+    packed.texcoord[0] = to_unorm16(texcoord.x);
+    packed.texcoord[1] = to_unorm16(texcoord.y);
+
+    return packed;
+}
+
+Vertex unpack_vertex(const PackedVertex& packed, const QuantizationParams& params)
+{
+    // Mirrors the dequantization in tri_mesh.vert
+    const glm::vec3 position(
+        from_snorm16(packed.position[0]),
+        from_snorm16(packed.position[1]),
+        from_snorm16(packed.position[2])
+    );
+    const glm::vec2 texcoord(
+        from_unorm16(packed.texcoord[0]),
+        from_unorm16(packed.texcoord[1])
+    );
+    const glm::vec2 normal(
+        from_snorm16(packed.normal[0]),
+        from_snorm16(packed.normal[1])
+    );
+
+    Vertex vertex;
+    vertex.position = position * params.position_scale + params.position_offset;
+    vertex.texcoord = texcoord * params.texcoord_scale + params.texcoord_offset;
+    vertex.normal = oct_decode(normal);
+    vertex.color = Colors::WHITE;
+
+    return vertex;
+}
+
+QuantizationError quantize_vertices(
+    const std::vector<Vertex>& vertices,
+    const QuantizationParams& params,
+    std::vector<PackedVertex>& packed_vertices
+)
+{
+    QuantizationError error;
+
+    packed_vertices.resize(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        packed_vertices[i] = pack_vertex(vertices[i], params);
+
+        // Measure the round trip error
+        const Vertex unpacked = unpack_vertex(packed_vertices[i], params);
+
+        error.position = std::max(error.position,
+            glm::length(unpacked.position - vertices[i].position));
+        error.texcoord = std::max(error.texcoord,
+            glm::length(unpacked.texcoord - vertices[i].texcoord));
+
+        const float normal_length = glm::length(vertices[i].normal);
+        if (normal_length > MIN_EXTENT)
+        {
+            // atan2 stays accurate for the tiny angles involved, acos doesn't
+            const glm::vec3 normal = vertices[i].normal / normal_length;
+            const float angle = std::atan2(
+                glm::length(glm::cross(unpacked.normal, normal)),
+                glm::dot(unpacked.normal, normal));
+            error.normal = std::max(error.normal, angle);
+        }
+    }
+
+    return error;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Vertex.h"
+
+/** Maps normalized packed attributes back to mesh space: v * scale + offset */
+struct QuantizationParams
+{
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+    glm::vec2 texcoord_offset = glm::vec2(0.0f);
+    glm::vec2 texcoord_scale = glm::vec2(1.0f);
+};
+
+/** Largest round trip error over a set of vertices */
+struct QuantizationError
+{
+    float position = 0.0f; // distance in mesh units
+    float normal = 0.0f;   // angle in radians
+    float texcoord = 0.0f; // distance in texture space
+};
+
+/** Picks parameters so the vertices exactly span the packed ranges. */
+QuantizationParams compute_quantization_params(
+    const std::vector<Vertex>& vertices);
+
+/**
+ * The largest error quantize_vertices can introduce for the given parameters:
+ * half a quantization step along each axis, plus the octahedral mapping error
+ * for normals.
+ */
+QuantizationError get_quantization_error_bound(
+    const QuantizationParams& params);
+
+glm::vec2 oct_encode(const glm::vec3& normal);
+glm::vec3 oct_decode(const glm::vec2& encoded);
+
+PackedVertex pack_vertex(const Vertex& vertex, const QuantizationParams& params);
+Vertex unpack_vertex(const PackedVertex& packed, const QuantizationParams& params);
+
+/** Packs every vertex and returns the measured round trip error. */
+QuantizationError quantize_vertices(
+    const std::vector<Vertex>& vertices,
+    const QuantizationParams& params,
+    std::vector<PackedVertex>& packed_vertices
+);
@@ -0,0 +1,422 @@
+#include "Simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+    /**
+     * Symmetric 4x4 matrix summing squared distances to a set of planes. Only
+     * the upper triangle is stored.
+     */
+    struct Quadric
+    {
+        double a00, a01, a02, a03;
+        double a11, a12, a13;
+        double a22, a23;
+        double a33;
+    };
+
+    Quadric make_plane_quadric(const glm::vec3& normal, float distance)
+    {
+        const double a = normal.x;
+        const double b = normal.y;
+        const double c = normal.z;
+        const double d = distance;
+
+        return {
+            a * a, a * b, a * c, a * d,
+            b * b, b * c, b * d,
+            c * c, c * d,
+            d * d
+        };
+    }
+
+    void add_quadric(Quadric& q, const Quadric& r)
+    {
+        q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+        q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+        q.a22 += r.a22; q.a23 += r.a23;
+        q.a33 += r.a33;
+    }
+
+    /** Sum of squared distances from a point to the quadric's planes */
+    double evaluate_quadric(const Quadric& q, const glm::vec3& p)
+    {
+        const double x = p.x;
+        const double y = p.y;
+        const double z = p.z;
+
+        const double error = q.a00 * x * x + 2.0 * q.a01 * x * y
+            + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+            + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+            + q.a22 * z * z + 2.0 * q.a23 * z
+            + q.a33;
+
+        // Rounding can push a perfect fit slightly negative
+        return std::max(error, 0.0);
+    }
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t bits[3];
+            memcpy(bits, &p, sizeof(bits));
+
+            size_t hash = 14695981039346656037ull;
+            for (const uint32_t b : bits)
+            {
+                hash = (hash ^ b) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+
+    uint64_t make_edge_key(uint32_t a, uint32_t b)
+    {
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        return ((uint64_t)a << 32) | b;
+    }
+} // namespace
+
+std::vector<uint32_t> simplify(
+    const std::vector<uint32_t>& indices,
+    const std::vector<Vertex>& vertices,
+    size_t target_index_count,
+    float max_error,
+    float& result_error
+)
+{
+    result_error = 0.0f;
+
+    const size_t vertex_count = vertices.size();
+    std::vector<uint32_t> result = indices;
+
+    // Vertices split by seams share a position. Collapses work on positions,
+    // identified by the first vertex that has them
+    std::vector<uint32_t> position_ids(vertex_count);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> first_vertex;
+        first_vertex.reserve(vertex_count);
+
+        for (uint32_t v = 0; v < (uint32_t)vertex_count; v++)
+        {
+            position_ids[v] = first_vertex.emplace(vertices[v].position, v)
+                .first->second;
+        }
+    }
+
+    // Accumulate the planes of the triangles around every position
+    std::vector<Quadric> quadrics(vertex_count, Quadric{});
+    for (size_t i = 0; i + 2 < result.size(); i += 3)
+    {
+        const glm::vec3& p0 = vertices[result[i + 0]].position;
+        const glm::vec3& p1 = vertices[result[i + 1]].position;
+        const glm::vec3& p2 = vertices[result[i + 2]].position;
+
+        const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(cross);
+        if (length == 0.0f)
+        {
+            continue;
+        }
+
+        const glm::vec3 normal = cross / length;
+        const Quadric quadric = make_plane_quadric(normal, -glm::dot(normal, p0));
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            add_quadric(quadrics[position_ids[result[i + k]]], quadric);
+        }
+    }
+
+    // Lock positions on open borders and non-manifold edges, which are the
+    // ones that would visibly tear or shrink
+    std::vector<bool> locked(vertex_count, false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edge_counts;
+        edge_counts.reserve(result.size());
+
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t a = position_ids[result[i + k]];
+                const uint32_t b = position_ids[result[i + (k + 1) % 3]];
+                edge_counts[make_edge_key(a, b)]++;
+            }
+        }
+
+        for (const auto& [key, count] : edge_counts)
+        {
+            if (count != 2)
+            {
+                locked[key >> 32] = true;
+                locked[key & 0xFFFFFFFF] = true;
+            }
+        }
+    }
+
+    const double max_cost = (double)max_error * (double)max_error;
+
+    std::vector<uint32_t> collapse_remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<std::pair<uint32_t, uint32_t>> wedge_moves;
+
+    while (result.size() > target_index_count)
+    {
+        const size_t triangle_count = result.size() / 3;
+
+        // Triangles around every position
+        std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+        for (const uint32_t index : result)
+        {
+            adjacency_offsets[position_ids[index] + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+        }
+
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(adjacency_offsets.begin(),
+            adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+            adjacency[fill[position_ids[result[i]]]++] = (uint32_t)(i / 3);
+        }
+
+        // Rank both directions of every edge by the error the collapse adds
+        collapses.clear();
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t a = position_ids[result[3 * t + k]];
+                const uint32_t b = position_ids[result[3 * t + (k + 1) % 3]];
+
+                // Each edge is seen from both of its triangles, keep one
+                if (a > b)
+                {
+                    continue;
+                }
+
+                Quadric quadric = quadrics[a];
+                add_quadric(quadric, quadrics[b]);
+
+                if (!locked[a])
+                {
+                    collapses.push_back({ a, b,
+                        evaluate_quadric(quadric, vertices[b].position) });
+                }
+                if (!locked[b])
+                {
+                    collapses.push_back({ b, a,
+                        evaluate_quadric(quadric, vertices[a].position) });
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        for (uint32_t v = 0; v < (uint32_t)vertex_count; v++)
+        {
+            collapse_remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t index_count = result.size();
+        size_t collapse_count = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > max_cost || index_count <= target_index_count)
+            {
+                break;
+            }
+
+            const uint32_t from = collapse.from;
+            const uint32_t to = collapse.to;
+
+            // Only one collapse per neighbourhood per pass, so every check
+            // below sees the mesh as it was at the start of the pass
+            if (touched[from] || touched[to])
+            {
+                continue;
+            }
+
+            // Find which vertex of the target every split vertex of the
+            // source moves to, via the triangles on the collapsed edge
+            wedge_moves.clear();
+            uint32_t removed_triangles = 0;
+
+            for (uint32_t a = adjacency_offsets[from];
+                a < adjacency_offsets[from + 1]; a++)
+            {
+                const uint32_t* triangle = &result[3 * adjacency[a]];
+
+                uint32_t from_wedge = UINT32_MAX;
+                uint32_t to_wedge = UINT32_MAX;
+                for (size_t k = 0; k < 3; k++)
+                {
+                    if (position_ids[triangle[k]] == from)
+                    {
+                        from_wedge = triangle[k];
+                    }
+                    else if (position_ids[triangle[k]] == to)
+                    {
+                        to_wedge = triangle[k];
+                    }
+                }
+
+                if (to_wedge == UINT32_MAX)
+                {
+                    continue;
+                }
+
+                removed_triangles++;
+
+                const auto move = std::find_if(wedge_moves.begin(),
+                    wedge_moves.end(),
+                    [&](const auto& m) { return m.first == from_wedge; });
+                if (move == wedge_moves.end())
+                {
+                    wedge_moves.emplace_back(from_wedge, to_wedge);
+                }
+            }
+
+            // Every split vertex of the source has to land on the target,
+            // otherwise the collapse would tear a seam
+            bool valid = removed_triangles > 0;
+            for (uint32_t a = adjacency_offsets[from];
+                valid && a < adjacency_offsets[from + 1]; a++)
+            {
+                const uint32_t* triangle = &result[3 * adjacency[a]];
+
+                for (size_t k = 0; k < 3; k++)
+                {
+                    if (position_ids[triangle[k]] != from)
+                    {
+                        continue;
+                    }
+
+                    valid = std::any_of(wedge_moves.begin(), wedge_moves.end(),
+                        [&](const auto& m) { return m.first == triangle[k]; });
+                }
+            }
+
+            // Reject collapses that would flip a triangle that survives
+            for (uint32_t a = adjacency_offsets[from];
+                valid && a < adjacency_offsets[from + 1]; a++)
+            {
+                const uint32_t* triangle = &result[3 * adjacency[a]];
+
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                bool has_target = false;
+
+                for (size_t k = 0; k < 3; k++)
+                {
+                    const uint32_t position = position_ids[triangle[k]];
+                    has_target |= position == to;
+
+                    before[k] = vertices[triangle[k]].position;
+                    after[k] = position == from
+                        ? vertices[to].position
+                        : before[k];
+                }
+
+                if (has_target)
+                {
+                    continue;
+                }
+
+                const glm::vec3 normal_before = glm::cross(
+                    before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normal_after = glm::cross(
+                    after[1] - after[0], after[2] - after[0]);
+
+                // Thin triangles can turn sharply without quite flipping,
+                // so require them to stay within about 75 degrees
+                valid = glm::dot(normal_before, normal_after) > 0.25f
+                    * glm::length(normal_before) * glm::length(normal_after);
+            }
+
+            if (!valid)
+            {
+                continue;
+            }
+
+            for (const auto& [from_wedge, to_wedge] : wedge_moves)
+            {
+                collapse_remap[from_wedge] = to_wedge;
+            }
+
+            add_quadric(quadrics[to], quadrics[from]);
+            result_error = std::max(result_error, (float)std::sqrt(collapse.cost));
+
+            // Everything around the source changes shape
+            for (uint32_t a = adjacency_offsets[from];
+                a < adjacency_offsets[from + 1]; a++)
+            {
+                const uint32_t* triangle = &result[3 * adjacency[a]];
+                for (size_t k = 0; k < 3; k++)
+                {
+                    touched[position_ids[triangle[k]]] = true;
+                }
+            }
+
+            index_count -= 3 * removed_triangles;
+            collapse_count++;
+        }
+
+        if (collapse_count == 0)
+        {
+            break;
+        }
+
+        // Apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = collapse_remap[result[i + 0]];
+            const uint32_t b = collapse_remap[result[i + 1]];
+            const uint32_t c = collapse_remap[result[i + 2]];
+
+            const uint32_t pa = position_ids[a];
+            const uint32_t pb = position_ids[b];
+            const uint32_t pc = position_ids[c];
+
+            if (pa == pb || pb == pc || pc == pa)
+            {
+                continue;
+            }
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Vertex.h"
+
+/**
+ * Simplifies a triangle list with quadric error metric edge collapses
+ * (Garland and Heckbert, "Surface Simplification Using Quadric Error
+ * Metrics"). Vertices are only ever collapsed onto one of their neighbours,
+ * so the result indexes the same vertex buffer and can share it with the
+ * original.
+ *
+ * Open borders and non-manifold edges are kept in place, and vertices that
+ * are split by UV or normal seams only slide along their seam.
+ *
+ * Stops at target_index_count or once the next collapse would move the
+ * surface by more than max_error. result_error receives the largest error
+ * that was accepted, in the same units as the positions.
+ */
+std::vector<uint32_t> simplify(
+    const std::vector<uint32_t>& indices,
+    const std::vector<Vertex>& vertices,
+    size_t target_index_count,
+    float max_error,
+    float& result_error
+);
@@ -2,8 +2,58 @@
 
 #include "../VulkanRenderer/vkinit.h"
 
-VertexInputDescription get_vertex_input_description()
+namespace
 {
+    VertexInputDescription get_packed_vertex_input_description()
+    {
+        VertexInputDescription description;
+
+        const VkVertexInputBindingDescription input_binding = {
+            .binding = 0,
+            .stride = sizeof(PackedVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        };
+
+        description.bindings.push_back(input_binding);
+
+        // The normalized formats convert to floats on fetch, the shader then
+        // applies the per mesh scale and offset
+        const VkVertexInputAttributeDescription pos_attr = {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16B16A16_SNORM,
+            .offset = offsetof(PackedVertex, position)
+        };
+
+        const VkVertexInputAttributeDescription texcoord_attr = {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16_UNORM,
+            .offset = offsetof(PackedVertex, texcoord)
+        };
+
+        const VkVertexInputAttributeDescription normal_attr = {
+            .location = 2,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16_SNORM,
+            .offset = offsetof(PackedVertex, normal)
+        };
+
+        description.attributes.push_back(pos_attr);
+        description.attributes.push_back(texcoord_attr);
+        description.attributes.push_back(normal_attr);
+
+        return description;
+    }
+} // namespace
+
+VertexInputDescription get_vertex_input_description(EVertexFormat format)
+{
+    if (format == VERTEX_FORMAT_PACKED)
+    {
+        return get_packed_vertex_input_description();
+    }
+
     VertexInputDescription description;
 
     // One binding with addressing done per instance
@@ -60,3 +110,12 @@ VertexInputDescription get_vertex_input_description()
 
     return description;
 }
+
+uint32_t get_vertex_size(EVertexFormat format)
+{
+    if (format == VERTEX_FORMAT_PACKED)
+    {
+        return sizeof(PackedVertex);
+    }
+    return sizeof(Vertex);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include <glm/vec2.hpp>
@@ -13,6 +14,13 @@ struct VertexInputDescription
 	VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+/** Layout of the vertices uploaded to the GPU */
+enum EVertexFormat : uint32_t
+{
+	VERTEX_FORMAT_FULL,   // Vertex, 44 bytes of fp32
+	VERTEX_FORMAT_PACKED, // PackedVertex, 16 bytes
+};
+
 struct Vertex
 {
 	glm::vec3 position;
@@ -21,4 +29,24 @@ struct Vertex
 	glm::vec3 color;
 };
 
-VertexInputDescription get_vertex_input_description();
\ No newline at end of file
+/**
+ * Quantized vertex. Positions are snorm16 relative to the mesh bounds and
+ * texcoords are unorm16 relative to the mesh texcoord bounds, both scaled back
+ * in the vertex shader. Normals are octahedral encoded. There is no color, the
+ * shader uses white.
+ */
+struct PackedVertex
+{
+	int16_t position[4]; // w is padding
+	int16_t normal[2];
+	uint16_t texcoord[2];
+};
+
+static_assert(sizeof(PackedVertex) == 16);
+
+VertexInputDescription get_vertex_input_description(
+	EVertexFormat format = VERTEX_FORMAT_FULL);
+
+/** Bytes per vertex in a vertex format. */
+[[nodiscard]]
+uint32_t get_vertex_size(EVertexFormat format);
@@ -0,0 +1,167 @@
+#include "CookedTexture.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <system_error>
+
+#include "../Utils/MappedFile.h"
+#include "../Utils/file_ops.h"
+
+namespace
+{
+    /** Level data is aligned like the levels inside it. */
+    constexpr uint64_t DATA_ALIGNMENT = 16;
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+} // namespace
+
+std::string get_cooked_texture_path(const std::string& filename)
+{
+    return filename + ".vtex";
+}
+
+bool read_cooked_texture(
+    const std::string& filename,
+    ETextureCompression compression,
+    TextureData& texture
+)
+{
+    uint64_t source_size;
+    int64_t source_mtime;
+    if (!get_file_stamp(filename.c_str(), source_size, source_mtime))
+    {
+        return false;
+    }
+
+    const std::string cooked_path = get_cooked_texture_path(filename);
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(cooked_path.c_str()) || file->size() < sizeof(VTexHeader))
+    {
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(file->data());
+
+    VTexHeader header;
+    memcpy(&header, bytes, sizeof(VTexHeader));
+
+    // Reject textures from other versions, settings or source files
+    if (header.magic != VTEX_MAGIC || header.version != VTEX_VERSION
+        || header.compression != (uint32_t)compression
+        || header.format > TEXTURE_FORMAT_BC7
+        || header.source_size != source_size
+        || header.source_mtime != source_mtime)
+    {
+        return false;
+    }
+
+    const uint64_t table_size =
+        (uint64_t)header.level_count * sizeof(TextureLevel);
+    if (header.level_count == 0 || header.width == 0 || header.height == 0
+        || sizeof(VTexHeader) + table_size > header.data_offset
+        || header.data_offset + header.data_size > file->size())
+    {
+        std::cerr << "Truncated cooked texture " << cooked_path << ".\n";
+        return false;
+    }
+
+    const TextureLevel* levels =
+        reinterpret_cast<const TextureLevel*>(bytes + sizeof(VTexHeader));
+    for (uint32_t level = 0; level < header.level_count; level++)
+    {
+        if (levels[level].offset + levels[level].size > header.data_size)
+        {
+            std::cerr << "Truncated cooked texture " << cooked_path << ".\n";
+            return false;
+        }
+    }
+
+    texture = {};
+    texture.format = (ETextureFormat)header.format;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.levels.assign(levels, levels + header.level_count);
+    texture.mapped_data = bytes + header.data_offset;
+    texture.mapped_size = header.data_size;
+    texture.file = std::move(file);
+
+    return true;
+}
+
+bool write_cooked_texture(
+    const std::string& filename,
+    ETextureCompression compression,
+    const TextureData& texture
+)
+{
+    VTexHeader header = {};
+    if (!get_file_stamp(filename.c_str(), header.source_size,
+        header.source_mtime))
+    {
+        return false;
+    }
+
+    const uint64_t table_size = texture.levels.size() * sizeof(TextureLevel);
+
+    header.magic = VTEX_MAGIC;
+    header.version = VTEX_VERSION;
+    header.compression = (uint32_t)compression;
+    header.format = (uint32_t)texture.format;
+    header.width = texture.width;
+    header.height = texture.height;
+    header.level_count = (uint32_t)texture.levels.size();
+    header.data_offset =
+        align_up(sizeof(VTexHeader) + table_size, DATA_ALIGNMENT);
+    header.data_size = texture.get_size();
+
+    // Write to a temporary file first so a crash never leaves a half written
+    // texture behind
+    const std::string cooked_path = get_cooked_texture_path(filename);
+    const std::string temp_path = cooked_path + ".tmp";
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to write " << temp_path << ".\n";
+            return false;
+        }
+
+        const char padding[DATA_ALIGNMENT] = {};
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(VTexHeader));
+        file.write(
+            reinterpret_cast<const char*>(texture.levels.data()),
+            (std::streamsize)table_size
+        );
+        file.write(padding, (std::streamsize)(header.data_offset
+            - sizeof(VTexHeader) - table_size));
+        file.write(
+            reinterpret_cast<const char*>(texture.get_data()),
+            (std::streamsize)header.data_size
+        );
+
+        if (!file.good())
+        {
+            std::cerr << "Failed to write " << temp_path << ".\n";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, cooked_path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}
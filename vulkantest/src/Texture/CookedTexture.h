@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "TextureData.h"
+
+/**
+ * Cooked texture (.vtex) written next to the source image the first time it
+ * is loaded. The file is a header, the table of levels, then every level in
+ * the exact layout it's copied to the GPU in, so loading it is a memory
+ * mapping that the upload copies straight into staging.
+ */
+constexpr uint32_t VTEX_MAGIC = 0x58455456; // "VTEX"
+
+/**
+ * Bump whenever the layout of the header or the levels changes, or the cooker
+ * starts producing different blocks.
+ */
+constexpr uint32_t VTEX_VERSION = 1;
+
+struct VTexHeader
+{
+    uint32_t magic;
+    uint32_t version;
+
+    /** Size and modification time of the image the texture was cooked from */
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    /** The compression setting the texture was cooked for */
+    uint32_t compression;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t padding;
+
+    /** Byte range of the level data. Level offsets are relative to it. */
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+[[nodiscard]]
+std::string get_cooked_texture_path(const std::string& filename);
+
+/**
+ * Maps the cooked texture of an image if it's up to date with the image and
+ * was cooked with the same compression. The returned data keeps the mapping
+ * alive.
+ */
+bool read_cooked_texture(
+    const std::string& filename,
+    ETextureCompression compression,
+    TextureData& texture
+);
+
+bool write_cooked_texture(
+    const std::string& filename,
+    ETextureCompression compression,
+    const TextureData& texture
+);
@@ -0,0 +1,174 @@
+#include "TextureCache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#pragma warning(push, 0)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image/stb_image.h>
+#pragma warning(pop)
+
+#include "CookedTexture.h"
+#include "TextureCooker.h"
+#include "../Utils/ThreadPool.h"
+
+TextureData load_texture_data(const std::string& path)
+{
+    TextureData data;
+
+    int width;
+    int height;
+    int channels;
+    stbi_uc* pixels =
+        stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+        std::cerr << "Failed to load texture " << path << ": "
+                  << stbi_failure_reason() << "\n";
+        return data;
+    }
+
+    data.width = (uint32_t)width;
+    data.height = (uint32_t)height;
+    data.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+    data.levels.push_back(
+        { data.width, data.height, 0, (uint64_t)data.pixels.size() });
+
+    stbi_image_free(pixels);
+
+    return data;
+}
+
+TextureData load_texture(
+    const std::string& path,
+    ETextureCompression compression
+)
+{
+    TextureData cooked;
+    if (compression != TEXTURE_COMPRESSION_NONE
+        && read_cooked_texture(path, compression, cooked))
+    {
+        return cooked;
+    }
+
+    TextureData image = load_texture_data(path);
+    if (image.empty())
+    {
+        return image;
+    }
+
+    // Uploads may run on a transfer queue, which can't blit, so uncompressed
+    // textures get their mips on the CPU as well. They're cheap enough to not
+    // be cached
+    if (compression == TEXTURE_COMPRESSION_NONE)
+    {
+        return cook_texture(image, TEXTURE_FORMAT_RGBA8);
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    cooked = cook_texture(image, choose_texture_format(image, compression));
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const auto duration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+    const std::vector<uint8_t> decoded = decode_texture_level(cooked, 0);
+    const double psnr = compute_psnr(image.get_data(), decoded.data(),
+        (size_t)image.width * image.height,
+        cooked.format != TEXTURE_FORMAT_BC1);
+
+    std::cout << "Cooked " << path << " ("
+              << get_texture_format_name(cooked.format) << ", "
+              << cooked.levels.size() << " levels, " << psnr << " dB PSNR, "
+              << duration.count() << " ms)\n";
+
+    write_cooked_texture(path, compression, cooked);
+
+    return cooked;
+}
+
+TextureCache::TextureCache()
+{
+    // The default texture is ready to upload from the start
+    Texture texture;
+    texture.data.width = 1;
+    texture.data.height = 1;
+    texture.data.levels = { { 1, 1, 0, 4 } };
+    texture.data.pixels = { 255, 255, 255, 255 };
+    textures.push_back(std::move(texture));
+}
+
+uint32_t TextureCache::request(
+    const std::string& path,
+    ETextureCompression compression
+)
+{
+    std::error_code ec;
+    std::string key =
+        std::filesystem::weakly_canonical(std::filesystem::path(path), ec)
+            .string();
+    if (ec)
+    {
+        key = path;
+    }
+
+    const auto it = slots.find(key);
+    if (it != slots.end())
+    {
+        return it->second;
+    }
+
+    if (textures.size() >= MAX_TEXTURES)
+    {
+        std::cerr << "Out of texture slots, " << path
+                  << " will not be loaded.\n";
+        slots.emplace(key, DEFAULT_TEXTURE);
+        return DEFAULT_TEXTURE;
+    }
+
+    const uint32_t slot = (uint32_t)textures.size();
+    slots.emplace(key, slot);
+
+    Texture texture;
+    texture.path = key;
+    texture.decoding = get_thread_pool().submit(
+        [key, compression]() { return load_texture(key, compression); });
+    textures.push_back(std::move(texture));
+
+    return slot;
+}
+
+std::vector<uint32_t> TextureCache::collect_decoded()
+{
+    std::vector<uint32_t> decoded;
+    for (uint32_t slot = 0; slot < (uint32_t)textures.size(); slot++)
+    {
+        Texture& texture = textures[slot];
+
+        if (texture.decoding.valid()
+            && texture.decoding.wait_for(std::chrono::seconds(0))
+                == std::future_status::ready)
+        {
+            texture.data = texture.decoding.get();
+            if (!texture.data.empty())
+            {
+                decoded.push_back(slot);
+            }
+        }
+    }
+    return decoded;
+}
+
+void TextureCache::wait_all()
+{
+    for (Texture& texture : textures)
+    {
+        if (texture.decoding.valid())
+        {
+            texture.decoding.wait();
+        }
+    }
+}
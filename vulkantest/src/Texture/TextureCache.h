@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "TextureData.h"
+#include "../VulkanRenderer/vktypes.h"
+
+/** Size of the texture array materials index into */
+constexpr uint32_t MAX_TEXTURES = 256;
+
+/** Slot of the 1x1 white texture materials without a texture use */
+constexpr uint32_t DEFAULT_TEXTURE = 0;
+
+/**
+ * Decodes an image file with stb_image to its top RGBA8 level. Returns no
+ * levels on failure.
+ */
+[[nodiscard]]
+TextureData load_texture_data(const std::string& path);
+
+/**
+ * Loads a texture and its mip chain with the given compression. Cooked
+ * textures are mapped from their .vtex file if it's up to date, otherwise the
+ * image is decoded, cooked and the file rewritten. Uncompressed textures are
+ * decoded and downsampled every time.
+ */
+[[nodiscard]]
+TextureData load_texture(
+    const std::string& path,
+    ETextureCompression compression
+);
+
+struct Texture
+{
+    std::string path;
+
+    /** Levels waiting to be uploaded, and the load producing them */
+    TextureData data;
+    std::future<TextureData> decoding;
+
+    Image image = {};
+    VkImageView view = nullptr;
+    uint32_t mip_levels = 0;
+
+    /** Whether the image has been uploaded and can be sampled */
+    bool resident = false;
+};
+
+/**
+ * Textures referenced by materials, each decoded once no matter how many
+ * materials or models use it. Every texture owns a slot in the texture array,
+ * so a material's texture is known as soon as it's requested and is drawn
+ * with the default texture until its upload completes.
+ */
+class TextureCache
+{
+public:
+    TextureCache();
+
+    /**
+     * Returns the slot of the texture at path and starts loading it on the
+     * thread pool if it's new. Paths are compared after canonicalization, so
+     * different spellings of the same file share a slot.
+     */
+    uint32_t request(const std::string& path, ETextureCompression compression);
+
+    /**
+     * Returns the slots whose loading has finished since the last call and
+     * whose levels are ready to upload. Never blocks. Textures that fail to
+     * load keep showing the default texture.
+     */
+    std::vector<uint32_t> collect_decoded();
+
+    /** Blocks until every load in flight has finished. */
+    void wait_all();
+
+    [[nodiscard]]
+    Texture& get(uint32_t slot) { return textures[slot]; }
+
+    [[nodiscard]]
+    std::vector<Texture>& get_textures() { return textures; }
+
+private:
+    std::vector<Texture> textures;
+    std::unordered_map<std::string, uint32_t> slots;
+};
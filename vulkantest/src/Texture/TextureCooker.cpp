@@ -0,0 +1,1162 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// SSE2 is part of x64, so only 32 bit builds without /arch:SSE2 fall back to
+// the scalar loops. Both produce the same results, and the scalar ones are
+// always built so tests can check that
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COOKER_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "../Utils/ThreadPool.h"
+
+namespace
+{
+    constexpr uint32_t BLOCK_PIXELS = 16;
+
+    /** Levels start at this alignment, which suits every block size. */
+    constexpr uint64_t LEVEL_ALIGNMENT = 16;
+
+    /** Least squares endpoint refinements tried per block */
+    constexpr int MAX_REFINEMENTS = 2;
+
+    /** Power iterations when searching for the principal axis */
+    constexpr int AXIS_ITERATIONS = 8;
+
+    /** BC1 and BC3 palette entries, as weights towards the second endpoint */
+    constexpr std::array<float, 4> BC1_WEIGHTS = {
+        0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f
+    };
+
+    /** BC7 interpolation weights for 4 bit indices, out of 64 */
+    constexpr std::array<uint32_t, 16> BC7_WEIGHTS = {
+        0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+    };
+
+    constexpr uint32_t BC7_MODE_6 = 1 << 6;
+
+#ifdef TEXTURE_COOKER_SSE2
+    std::atomic<bool> sse2_enabled = true;
+#endif
+
+    using Color = std::array<float, 4>;
+
+    /**
+     * Pixels of a block as floats, one array per channel, so four pixels can
+     * be processed at once.
+     */
+    struct BlockColors
+    {
+        alignas(16) float channels[4][BLOCK_PIXELS];
+    };
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    float clamp_channel(float value)
+    {
+        return std::clamp(value, 0.0f, 255.0f);
+    }
+
+    BlockColors load_block_colors(const uint8_t* pixels)
+    {
+        BlockColors colors;
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                colors.channels[c][i] = (float)pixels[4 * i + c];
+            }
+        }
+        return colors;
+    }
+
+    /**
+     * Mean and principal axis of the first channel_count channels of a block.
+     * The axis is zero for blocks of a single color.
+     */
+    void compute_principal_axis(
+        const BlockColors& colors,
+        uint32_t channel_count,
+        Color& mean,
+        Color& axis
+    )
+    {
+        mean = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (uint32_t c = 0; c < channel_count; c++)
+        {
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+            {
+                mean[c] += colors.channels[c][i];
+            }
+            mean[c] /= (float)BLOCK_PIXELS;
+        }
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            for (uint32_t a = 0; a < channel_count; a++)
+            {
+                const float da = colors.channels[a][i] - mean[a];
+                for (uint32_t b = 0; b < channel_count; b++)
+                {
+                    covariance[a][b] += da * (colors.channels[b][i] - mean[b]);
+                }
+            }
+        }
+
+        // Power iteration, starting from the channel that varies the most
+        uint32_t start = 0;
+        for (uint32_t c = 1; c < channel_count; c++)
+        {
+            if (covariance[c][c] > covariance[start][start])
+            {
+                start = c;
+            }
+        }
+
+        axis = { 0.0f, 0.0f, 0.0f, 0.0f };
+        if (covariance[start][start] <= 0.0f)
+        {
+            return;
+        }
+        for (uint32_t c = 0; c < channel_count; c++)
+        {
+            axis[c] = covariance[start][c];
+        }
+
+        for (int iteration = 0; iteration < AXIS_ITERATIONS; iteration++)
+        {
+            Color next = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float length = 0.0f;
+            for (uint32_t a = 0; a < channel_count; a++)
+            {
+                for (uint32_t b = 0; b < channel_count; b++)
+                {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length += next[a] * next[a];
+            }
+
+            length = sqrtf(length);
+            if (length < 1e-8f)
+            {
+                break;
+            }
+            for (uint32_t c = 0; c < channel_count; c++)
+            {
+                axis[c] = next[c] / length;
+            }
+        }
+    }
+
+    /** Range of the block's pixels along an axis through the mean. */
+    void project_onto_axis(
+        const BlockColors& colors,
+        const Color& mean,
+        const Color& axis,
+        float& min_t,
+        float& max_t
+    )
+    {
+#ifdef TEXTURE_COOKER_SSE2
+        if (sse2_enabled.load(std::memory_order_relaxed))
+        {
+            __m128 min_v = _mm_set1_ps(FLT_MAX);
+            __m128 max_v = _mm_set1_ps(-FLT_MAX);
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i += 4)
+            {
+                __m128 t = _mm_setzero_ps();
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    const __m128 offset = _mm_sub_ps(
+                        _mm_load_ps(&colors.channels[c][i]),
+                        _mm_set1_ps(mean[c]));
+                    t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(axis[c])));
+                }
+                min_v = _mm_min_ps(min_v, t);
+                max_v = _mm_max_ps(max_v, t);
+            }
+
+            alignas(16) float mins[4];
+            alignas(16) float maxs[4];
+            _mm_store_ps(mins, min_v);
+            _mm_store_ps(maxs, max_v);
+
+            min_t = std::min({ mins[0], mins[1], mins[2], mins[3] });
+            max_t = std::max({ maxs[0], maxs[1], maxs[2], maxs[3] });
+            return;
+        }
+#endif
+
+        min_t = FLT_MAX;
+        max_t = -FLT_MAX;
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            float t = 0.0f;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                t += (colors.channels[c][i] - mean[c]) * axis[c];
+            }
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+    }
+
+    /**
+     * Picks the closest palette entry for every pixel, over the first
+     * channel_count channels. Returns the summed squared error.
+     */
+    float fit_palette(
+        const BlockColors& colors,
+        const Color* palette,
+        uint32_t palette_size,
+        uint32_t channel_count,
+        uint8_t* indices
+    )
+    {
+        float total_error = 0.0f;
+
+#ifdef TEXTURE_COOKER_SSE2
+        if (sse2_enabled.load(std::memory_order_relaxed))
+        {
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i += 4)
+            {
+                __m128 best_error = _mm_set1_ps(FLT_MAX);
+                __m128 best_index = _mm_setzero_ps();
+
+                for (uint32_t p = 0; p < palette_size; p++)
+                {
+                    __m128 error = _mm_setzero_ps();
+                    for (uint32_t c = 0; c < channel_count; c++)
+                    {
+                        const __m128 difference = _mm_sub_ps(
+                            _mm_load_ps(&colors.channels[c][i]),
+                            _mm_set1_ps(palette[p][c]));
+                        error = _mm_add_ps(
+                            error, _mm_mul_ps(difference, difference));
+                    }
+
+                    // Earlier entries win ties, like in the scalar loop
+                    const __m128 closer = _mm_cmplt_ps(error, best_error);
+                    best_error = _mm_min_ps(error, best_error);
+                    best_index = _mm_or_ps(
+                        _mm_and_ps(closer, _mm_set1_ps((float)p)),
+                        _mm_andnot_ps(closer, best_index));
+                }
+
+                alignas(16) float errors[4];
+                alignas(16) float best_indices[4];
+                _mm_store_ps(errors, best_error);
+                _mm_store_ps(best_indices, best_index);
+
+                for (uint32_t k = 0; k < 4; k++)
+                {
+                    indices[i + k] = (uint8_t)best_indices[k];
+                    total_error += errors[k];
+                }
+            }
+            return total_error;
+        }
+#endif
+
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            float best_error = FLT_MAX;
+            for (uint32_t p = 0; p < palette_size; p++)
+            {
+                float error = 0.0f;
+                for (uint32_t c = 0; c < channel_count; c++)
+                {
+                    const float difference =
+                        colors.channels[c][i] - palette[p][c];
+                    error += difference * difference;
+                }
+
+                if (error < best_error)
+                {
+                    best_error = error;
+                    indices[i] = (uint8_t)p;
+                }
+            }
+            total_error += best_error;
+        }
+
+        return total_error;
+    }
+
+    /**
+     * Least squares endpoints for the block, given the palette entry of every
+     * pixel as a weight towards the second endpoint. Fails when every pixel
+     * uses the same weight.
+     */
+    bool fit_endpoints(
+        const BlockColors& colors,
+        const uint8_t* indices,
+        const float* weights,
+        uint32_t channel_count,
+        Color& e0,
+        Color& e1
+    )
+    {
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        Color ax = { 0.0f, 0.0f, 0.0f, 0.0f };
+        Color bx = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            const float b = weights[indices[i]];
+            const float a = 1.0f - b;
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (uint32_t c = 0; c < channel_count; c++)
+            {
+                ax[c] += a * colors.channels[c][i];
+                bx[c] += b * colors.channels[c][i];
+            }
+        }
+
+        const float determinant = aa * bb - ab * ab;
+        if (fabsf(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        for (uint32_t c = 0; c < channel_count; c++)
+        {
+            e0[c] = clamp_channel((bb * ax[c] - ab * bx[c]) / determinant);
+            e1[c] = clamp_channel((aa * bx[c] - ab * ax[c]) / determinant);
+        }
+
+        return true;
+    }
+
+    /** Initial endpoints: the extremes of the block along its principal axis */
+    void get_axis_endpoints(
+        const BlockColors& colors,
+        uint32_t channel_count,
+        Color& e0,
+        Color& e1
+    )
+    {
+        Color mean;
+        Color axis;
+        compute_principal_axis(colors, channel_count, mean, axis);
+
+        float min_t;
+        float max_t;
+        project_onto_axis(colors, mean, axis, min_t, max_t);
+
+        e0 = { 0.0f, 0.0f, 0.0f, 255.0f };
+        e1 = { 0.0f, 0.0f, 0.0f, 255.0f };
+        for (uint32_t c = 0; c < channel_count; c++)
+        {
+            e0[c] = clamp_channel(mean[c] + axis[c] * min_t);
+            e1[c] = clamp_channel(mean[c] + axis[c] * max_t);
+        }
+    }
+
+    /** Writes bit fields into a block, least significant bit first */
+    struct BitWriter
+    {
+        uint8_t* data;
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t bit_count)
+        {
+            for (uint32_t bit = 0; bit < bit_count; bit++, position++)
+            {
+                if ((value >> bit) & 1)
+                {
+                    data[position / 8] |= (uint8_t)(1 << (position % 8));
+                }
+            }
+        }
+    };
+
+    struct BitReader
+    {
+        const uint8_t* data;
+        uint32_t position = 0;
+
+        uint32_t read(uint32_t bit_count)
+        {
+            uint32_t value = 0;
+            for (uint32_t bit = 0; bit < bit_count; bit++, position++)
+            {
+                value |= (uint32_t)((data[position / 8] >> (position % 8)) & 1)
+                    << bit;
+            }
+            return value;
+        }
+    };
+
+    // BC1 color blocks, also the color half of BC3
+
+    uint16_t to_565(const Color& color)
+    {
+        const uint32_t r = (uint32_t)lroundf(color[0] * 31.0f / 255.0f);
+        const uint32_t g = (uint32_t)lroundf(color[1] * 63.0f / 255.0f);
+        const uint32_t b = (uint32_t)lroundf(color[2] * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    std::array<uint32_t, 3> from_565(uint16_t color)
+    {
+        const uint32_t r = (color >> 11) & 31;
+        const uint32_t g = (color >> 5) & 63;
+        const uint32_t b = color & 31;
+        return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+    }
+
+    struct Bc1Fit
+    {
+        uint16_t c0;
+        uint16_t c1;
+        std::array<uint8_t, BLOCK_PIXELS> indices;
+        float error;
+    };
+
+    Bc1Fit fit_bc1(const BlockColors& colors, const Color& e0, const Color& e1)
+    {
+        Bc1Fit fit;
+        fit.c0 = to_565(e0);
+        fit.c1 = to_565(e1);
+
+        // The four color palette, rounded like the decoder rounds it
+        const std::array<uint32_t, 3> a = from_565(fit.c0);
+        const std::array<uint32_t, 3> b = from_565(fit.c1);
+
+        Color palette[4];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            palette[0][c] = (float)a[c];
+            palette[1][c] = (float)b[c];
+            palette[2][c] = (float)((2 * a[c] + b[c]) / 3);
+            palette[3][c] = (float)((a[c] + 2 * b[c]) / 3);
+        }
+
+        fit.error = fit_palette(colors, palette, 4, 3, fit.indices.data());
+
+        return fit;
+    }
+
+    void encode_bc1_colors(const BlockColors& colors, uint8_t* block)
+    {
+        Color e0;
+        Color e1;
+        get_axis_endpoints(colors, 3, e0, e1);
+
+        Bc1Fit best = fit_bc1(colors, e0, e1);
+        for (int i = 0; i < MAX_REFINEMENTS; i++)
+        {
+            if (!fit_endpoints(colors, best.indices.data(), BC1_WEIGHTS.data(),
+                3, e0, e1))
+            {
+                break;
+            }
+
+            const Bc1Fit refined = fit_bc1(colors, e0, e1);
+            if (refined.error >= best.error)
+            {
+                break;
+            }
+            best = refined;
+        }
+
+        // Four color mode needs c0 > c1. Swapping the endpoints swaps indices
+        // 0 with 1 and 2 with 3. Equal endpoints decode as three colors, so
+        // those blocks only use index 0
+        uint16_t c0 = best.c0;
+        uint16_t c1 = best.c1;
+        uint32_t index_bits = 0;
+        if (c0 != c1)
+        {
+            const uint32_t flip = c0 < c1 ? 1 : 0;
+            if (flip)
+            {
+                std::swap(c0, c1);
+            }
+
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+            {
+                index_bits |= (uint32_t)(best.indices[i] ^ flip) << (2 * i);
+            }
+        }
+
+        block[0] = (uint8_t)(c0 & 0xFF);
+        block[1] = (uint8_t)(c0 >> 8);
+        block[2] = (uint8_t)(c1 & 0xFF);
+        block[3] = (uint8_t)(c1 >> 8);
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            block[4 + i] = (uint8_t)(index_bits >> (8 * i));
+        }
+    }
+
+    void decode_bc1_colors(
+        const uint8_t* block,
+        uint8_t* pixels,
+        bool four_colors_only
+    )
+    {
+        const uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+        const uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+        const std::array<uint32_t, 3> a = from_565(c0);
+        const std::array<uint32_t, 3> b = from_565(c1);
+
+        uint8_t palette[4][4];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            palette[0][c] = (uint8_t)a[c];
+            palette[1][c] = (uint8_t)b[c];
+            if (four_colors_only || c0 > c1)
+            {
+                palette[2][c] = (uint8_t)((2 * a[c] + b[c]) / 3);
+                palette[3][c] = (uint8_t)((a[c] + 2 * b[c]) / 3);
+            }
+            else
+            {
+                palette[2][c] = (uint8_t)((a[c] + b[c]) / 2);
+                palette[3][c] = 0;
+            }
+        }
+        palette[0][3] = 255;
+        palette[1][3] = 255;
+        palette[2][3] = 255;
+        palette[3][3] = (four_colors_only || c0 > c1) ? 255 : 0;
+
+        const uint32_t index_bits = (uint32_t)block[4] | ((uint32_t)block[5] << 8)
+            | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+
+        // BC3 blocks get their alpha from the alpha half
+        const uint32_t channels = four_colors_only ? 3 : 4;
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            const uint32_t index = (index_bits >> (2 * i)) & 3;
+            memcpy(pixels + 4 * i, palette[index], channels);
+        }
+    }
+
+    // BC3 alpha blocks
+
+    void encode_bc3_alpha(const uint8_t* pixels, uint8_t* block)
+    {
+        uint8_t a0 = 0;
+        uint8_t a1 = 255;
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            a0 = std::max(a0, pixels[4 * i + 3]);
+            a1 = std::min(a1, pixels[4 * i + 3]);
+        }
+
+        // a0 > a1 selects the eight value palette. Blocks of a single alpha
+        // only use index 0
+        uint64_t index_bits = 0;
+        if (a0 > a1)
+        {
+            std::array<int32_t, 8> palette;
+            palette[0] = a0;
+            palette[1] = a1;
+            for (int32_t i = 2; i < 8; i++)
+            {
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+            }
+
+            for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+            {
+                const int32_t alpha = pixels[4 * i + 3];
+
+                uint64_t best_index = 0;
+                int32_t best_error = INT32_MAX;
+                for (uint32_t p = 0; p < 8; p++)
+                {
+                    const int32_t error = std::abs(alpha - palette[p]);
+                    if (error < best_error)
+                    {
+                        best_error = error;
+                        best_index = p;
+                    }
+                }
+                index_bits |= best_index << (3 * i);
+            }
+        }
+
+        block[0] = a0;
+        block[1] = a1;
+        for (uint32_t i = 0; i < 6; i++)
+        {
+            block[2 + i] = (uint8_t)(index_bits >> (8 * i));
+        }
+    }
+
+    void decode_bc3_alpha(const uint8_t* block, uint8_t* pixels)
+    {
+        const int32_t a0 = block[0];
+        const int32_t a1 = block[1];
+
+        std::array<int32_t, 8> palette;
+        palette[0] = a0;
+        palette[1] = a1;
+        if (a0 > a1)
+        {
+            for (int32_t i = 2; i < 8; i++)
+            {
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+            }
+        }
+        else
+        {
+            for (int32_t i = 2; i < 6; i++)
+            {
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+
+        uint64_t index_bits = 0;
+        for (uint32_t i = 0; i < 6; i++)
+        {
+            index_bits |= (uint64_t)block[2 + i] << (8 * i);
+        }
+
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            pixels[4 * i + 3] = (uint8_t)palette[(index_bits >> (3 * i)) & 7];
+        }
+    }
+
+    // BC7 mode 6 blocks
+
+    /** 7 bit RGBA endpoint, extended to 8 bits by a p-bit shared by all four */
+    struct Bc7Endpoint
+    {
+        std::array<uint32_t, 4> value;
+        uint32_t pbit;
+    };
+
+    std::array<uint32_t, 4> expand_bc7_endpoint(const Bc7Endpoint& endpoint)
+    {
+        std::array<uint32_t, 4> expanded;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            expanded[c] = (endpoint.value[c] << 1) | endpoint.pbit;
+        }
+        return expanded;
+    }
+
+    Bc7Endpoint quantize_bc7_endpoint(const Color& color)
+    {
+        Bc7Endpoint best = {};
+        float best_error = FLT_MAX;
+
+        for (uint32_t pbit = 0; pbit < 2; pbit++)
+        {
+            Bc7Endpoint endpoint;
+            endpoint.pbit = pbit;
+
+            float error = 0.0f;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const long value = lroundf((color[c] - (float)pbit) * 0.5f);
+                endpoint.value[c] = (uint32_t)std::clamp(value, 0l, 127l);
+
+                const float difference =
+                    (float)((endpoint.value[c] << 1) | pbit) - color[c];
+                error += difference * difference;
+            }
+
+            if (error < best_error)
+            {
+                best_error = error;
+                best = endpoint;
+            }
+        }
+
+        return best;
+    }
+
+    uint32_t interpolate_bc7(uint32_t e0, uint32_t e1, uint32_t weight)
+    {
+        return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+    }
+
+    struct Bc7Fit
+    {
+        Bc7Endpoint e0;
+        Bc7Endpoint e1;
+        std::array<uint8_t, BLOCK_PIXELS> indices;
+        float error;
+    };
+
+    Bc7Fit fit_bc7(const BlockColors& colors, const Color& e0, const Color& e1)
+    {
+        Bc7Fit fit;
+        fit.e0 = quantize_bc7_endpoint(e0);
+        fit.e1 = quantize_bc7_endpoint(e1);
+
+        const std::array<uint32_t, 4> a = expand_bc7_endpoint(fit.e0);
+        const std::array<uint32_t, 4> b = expand_bc7_endpoint(fit.e1);
+
+        Color palette[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                palette[i][c] = (float)interpolate_bc7(a[c], b[c], BC7_WEIGHTS[i]);
+            }
+        }
+
+        fit.error = fit_palette(colors, palette, 16, 4, fit.indices.data());
+
+        return fit;
+    }
+
+    void decode_bc7(const uint8_t* block, uint8_t* pixels)
+    {
+        if ((block[0] & 0x7F) != BC7_MODE_6)
+        {
+            memset(pixels, 0, 4 * BLOCK_PIXELS);
+            return;
+        }
+
+        BitReader reader = { block };
+        reader.read(7);
+
+        Bc7Endpoint e0;
+        Bc7Endpoint e1;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            e0.value[c] = reader.read(7);
+            e1.value[c] = reader.read(7);
+        }
+        e0.pbit = reader.read(1);
+        e1.pbit = reader.read(1);
+
+        const std::array<uint32_t, 4> a = expand_bc7_endpoint(e0);
+        const std::array<uint32_t, 4> b = expand_bc7_endpoint(e1);
+
+        for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+        {
+            const uint32_t index = reader.read(i == 0 ? 3 : 4);
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                pixels[4 * i + c] =
+                    (uint8_t)interpolate_bc7(a[c], b[c], BC7_WEIGHTS[index]);
+            }
+        }
+    }
+
+    /**
+     * Gathers a block from an image. Blocks hanging over the right or bottom
+     * edge repeat the edge pixels.
+     */
+    void load_block(
+        const uint8_t* pixels,
+        uint32_t width,
+        uint32_t height,
+        uint32_t block_x,
+        uint32_t block_y,
+        uint8_t* block_pixels
+    )
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            const uint32_t source_y = std::min(block_y * 4 + y, height - 1);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                const uint32_t source_x = std::min(block_x * 4 + x, width - 1);
+                memcpy(block_pixels + 4 * (4 * y + x),
+                    pixels + 4 * ((size_t)source_y * width + source_x), 4);
+            }
+        }
+    }
+
+    void encode_level(
+        const uint8_t* pixels,
+        uint32_t width,
+        uint32_t height,
+        ETextureFormat format,
+        uint8_t* output
+    )
+    {
+        if (!is_block_compressed(format))
+        {
+            memcpy(output, pixels, (size_t)width * height * 4);
+            return;
+        }
+
+        const uint32_t blocks_x = (width + 3) / 4;
+        const uint32_t blocks_y = (height + 3) / 4;
+        const uint32_t block_size = get_texture_block_size(format);
+
+        get_thread_pool().parallel_for(blocks_y,
+            [&](size_t block_y)
+            {
+                uint8_t block_pixels[4 * BLOCK_PIXELS];
+                for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+                {
+                    load_block(pixels, width, height, block_x,
+                        (uint32_t)block_y, block_pixels);
+
+                    uint8_t* block =
+                        output + (block_y * blocks_x + block_x) * block_size;
+                    switch (format)
+                    {
+                        case TEXTURE_FORMAT_BC1:
+                            encode_bc1_block(block_pixels, block);
+                            break;
+                        case TEXTURE_FORMAT_BC3:
+                            encode_bc3_block(block_pixels, block);
+                            break;
+                        default:
+                            encode_bc7_block(block_pixels, block);
+                            break;
+                    }
+                }
+            }
+        );
+    }
+
+    const std::array<float, 256>& get_srgb_to_linear_table()
+    {
+        static const std::array<float, 256> table = []()
+        {
+            std::array<float, 256> values;
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                const float s = (float)i / 255.0f;
+                values[i] = s <= 0.04045f
+                    ? s / 12.92f
+                    : powf((s + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    uint8_t linear_to_srgb(float linear)
+    {
+        linear = std::clamp(linear, 0.0f, 1.0f);
+        const float s = linear <= 0.0031308f
+            ? linear * 12.92f
+            : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+        return (uint8_t)lroundf(s * 255.0f);
+    }
+} // namespace
+
+ETextureFormat choose_texture_format(
+    const TextureData& image,
+    ETextureCompression compression
+)
+{
+    if (compression == TEXTURE_COMPRESSION_NONE)
+    {
+        return TEXTURE_FORMAT_RGBA8;
+    }
+    if (compression == TEXTURE_COMPRESSION_BC7)
+    {
+        return TEXTURE_FORMAT_BC7;
+    }
+
+    // BC1 can't store alpha, so only opaque images use it
+    const uint8_t* pixels = image.get_data();
+    const size_t pixel_count = (size_t)image.width * image.height;
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        if (pixels[4 * i + 3] != 255)
+        {
+            return TEXTURE_FORMAT_BC3;
+        }
+    }
+    return TEXTURE_FORMAT_BC1;
+}
+
+TextureData cook_texture(const TextureData& image, ETextureFormat format)
+{
+    TextureData cooked;
+    cooked.format = format;
+    cooked.width = image.width;
+    cooked.height = image.height;
+
+    // Lay out every level first so they can be encoded in place
+    const uint32_t mip_levels = get_mip_level_count(image.width, image.height);
+    uint64_t offset = 0;
+    for (uint32_t level = 0; level < mip_levels; level++)
+    {
+        const uint32_t width = std::max(image.width >> level, 1u);
+        const uint32_t height = std::max(image.height >> level, 1u);
+        const uint64_t size = get_texture_level_size(format, width, height);
+
+        cooked.levels.push_back({ width, height, offset, size });
+        offset = align_up(offset + size, LEVEL_ALIGNMENT);
+    }
+    cooked.pixels.resize(offset);
+
+    std::vector<uint8_t> level_pixels(image.get_data(),
+        image.get_data() + (size_t)image.width * image.height * 4);
+
+    for (uint32_t level = 0; level < mip_levels; level++)
+    {
+        const TextureLevel& info = cooked.levels[level];
+        if (level > 0)
+        {
+            const TextureLevel& above = cooked.levels[level - 1];
+            level_pixels =
+                downsample_srgb(level_pixels.data(), above.width, above.height);
+        }
+
+        encode_level(level_pixels.data(), info.width, info.height, format,
+            cooked.pixels.data() + info.offset);
+    }
+
+    return cooked;
+}
+
+std::vector<uint8_t> downsample_srgb(
+    const uint8_t* pixels,
+    uint32_t width,
+    uint32_t height
+)
+{
+    const std::array<float, 256>& to_linear = get_srgb_to_linear_table();
+
+    const uint32_t half_width = std::max(width / 2, 1u);
+    const uint32_t half_height = std::max(height / 2, 1u);
+    std::vector<uint8_t> half(4 * (size_t)half_width * half_height);
+
+    for (uint32_t y = 0; y < half_height; y++)
+    {
+        const uint32_t y0 = std::min(2 * y, height - 1);
+        const uint32_t y1 = std::min(2 * y + 1, height - 1);
+
+        for (uint32_t x = 0; x < half_width; x++)
+        {
+            const uint32_t x0 = std::min(2 * x, width - 1);
+            const uint32_t x1 = std::min(2 * x + 1, width - 1);
+
+            const std::array<const uint8_t*, 4> sources = {
+                pixels + 4 * ((size_t)y0 * width + x0),
+                pixels + 4 * ((size_t)y0 * width + x1),
+                pixels + 4 * ((size_t)y1 * width + x0),
+                pixels + 4 * ((size_t)y1 * width + x1),
+            };
+
+            uint8_t* destination = half.data() + 4 * ((size_t)y * half_width + x);
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                float sum = 0.0f;
+                for (const uint8_t* source : sources)
+                {
+                    sum += to_linear[source[c]];
+                }
+                destination[c] = linear_to_srgb(sum * 0.25f);
+            }
+
+            // Alpha is already linear
+            uint32_t alpha = 2;
+            for (const uint8_t* source : sources)
+            {
+                alpha += source[3];
+            }
+            destination[3] = (uint8_t)(alpha / 4);
+        }
+    }
+
+    return half;
+}
+
+void encode_bc1_block(const uint8_t* pixels, uint8_t* block)
+{
+    encode_bc1_colors(load_block_colors(pixels), block);
+}
+
+void encode_bc3_block(const uint8_t* pixels, uint8_t* block)
+{
+    encode_bc3_alpha(pixels, block);
+    encode_bc1_colors(load_block_colors(pixels), block + 8);
+}
+
+void encode_bc7_block(const uint8_t* pixels, uint8_t* block)
+{
+    const BlockColors colors = load_block_colors(pixels);
+
+    std::array<float, 16> weights;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        weights[i] = (float)BC7_WEIGHTS[i] / 64.0f;
+    }
+
+    Color e0;
+    Color e1;
+    get_axis_endpoints(colors, 4, e0, e1);
+
+    Bc7Fit best = fit_bc7(colors, e0, e1);
+    for (int i = 0; i < MAX_REFINEMENTS; i++)
+    {
+        if (!fit_endpoints(colors, best.indices.data(), weights.data(), 4, e0,
+            e1))
+        {
+            break;
+        }
+
+        const Bc7Fit refined = fit_bc7(colors, e0, e1);
+        if (refined.error >= best.error)
+        {
+            break;
+        }
+        best = refined;
+    }
+
+    // The first pixel's index is stored without its top bit, so it must be
+    // below 8. The weights are symmetric, so swapping the endpoints and
+    // mirroring the indices decodes to the same colors
+    if (best.indices[0] >= 8)
+    {
+        std::swap(best.e0, best.e1);
+        for (uint8_t& index : best.indices)
+        {
+            index = (uint8_t)(15 - index);
+        }
+    }
+
+    memset(block, 0, 16);
+    BitWriter writer = { block };
+    writer.write(BC7_MODE_6, 7);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.write(best.e0.value[c], 7);
+        writer.write(best.e1.value[c], 7);
+    }
+    writer.write(best.e0.pbit, 1);
+    writer.write(best.e1.pbit, 1);
+    for (uint32_t i = 0; i < BLOCK_PIXELS; i++)
+    {
+        writer.write(best.indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+void decode_block(ETextureFormat format, const uint8_t* block, uint8_t* pixels)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1:
+            decode_bc1_colors(block, pixels, false);
+            break;
+        case TEXTURE_FORMAT_BC3:
+            decode_bc3_alpha(block, pixels);
+            decode_bc1_colors(block + 8, pixels, true);
+            break;
+        case TEXTURE_FORMAT_BC7:
+            decode_bc7(block, pixels);
+            break;
+        default:
+            memcpy(pixels, block, 4 * BLOCK_PIXELS);
+            break;
+    }
+}
+
+std::vector<uint8_t> decode_texture_level(
+    const TextureData& texture,
+    uint32_t level
+)
+{
+    const TextureLevel& info = texture.levels[level];
+    const uint8_t* data = texture.get_data() + info.offset;
+
+    if (!is_block_compressed(texture.format))
+    {
+        return std::vector<uint8_t>(data, data + info.size);
+    }
+
+    std::vector<uint8_t> pixels(4 * (size_t)info.width * info.height);
+
+    const uint32_t blocks_x = (info.width + 3) / 4;
+    const uint32_t blocks_y = (info.height + 3) / 4;
+    const uint32_t block_size = get_texture_block_size(texture.format);
+
+    uint8_t block_pixels[4 * BLOCK_PIXELS];
+    for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+    {
+        for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+        {
+            decode_block(texture.format,
+                data + ((size_t)block_y * blocks_x + block_x) * block_size,
+                block_pixels);
+
+            // Drop the pixels hanging over the edges
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                const uint32_t pixel_y = block_y * 4 + y;
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    const uint32_t pixel_x = block_x * 4 + x;
+                    if (pixel_x < info.width && pixel_y < info.height)
+                    {
+                        memcpy(pixels.data()
+                                + 4 * ((size_t)pixel_y * info.width + pixel_x),
+                            block_pixels + 4 * (4 * y + x), 4);
+                    }
+                }
+            }
+        }
+    }
+
+    return pixels;
+}
+
+double compute_psnr(
+    const uint8_t* reference,
+    const uint8_t* pixels,
+    size_t pixel_count,
+    bool include_alpha
+)
+{
+    const uint32_t channels = include_alpha ? 4 : 3;
+
+    double squared_error = 0.0;
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            const double difference =
+                (double)reference[4 * i + c] - (double)pixels[4 * i + c];
+            squared_error += difference * difference;
+        }
+    }
+
+    if (squared_error == 0.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    const double mean_squared_error =
+        squared_error / (double)(pixel_count * channels);
+    return 10.0 * log10(255.0 * 255.0 / mean_squared_error);
+}
+
+bool set_texture_cooker_sse2(bool enabled)
+{
+#ifdef TEXTURE_COOKER_SSE2
+    sse2_enabled = enabled;
+    return true;
+#else
+    return !enabled;
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TextureData.h"
+
+/**
+ * Offline encoder for the BC formats. Blocks are 4x4 RGBA8 pixels, row by row,
+ * and are encoded in sRGB space like the GPU samples them.
+ *
+ * Every encoder fits endpoints along the principal axis of the block's colors,
+ * picks the closest palette entry for every pixel, then refines the endpoints
+ * with a least squares fit to those indices while the error keeps going down.
+ */
+
+/** Picks the format a decoded image is cooked to. */
+[[nodiscard]]
+ETextureFormat choose_texture_format(
+    const TextureData& image,
+    ETextureCompression compression
+);
+
+/**
+ * Encodes a decoded image and its full mip chain. Each level is a 2x2 box
+ * filter of the one above it, averaged in linear space. Blocks are encoded in
+ * parallel on the thread pool, but each block only depends on its pixels, so
+ * the same image always cooks to the same bytes.
+ */
+[[nodiscard]]
+TextureData cook_texture(const TextureData& image, ETextureFormat format);
+
+/** Halves an RGBA8 sRGB image, averaging its colors in linear space. */
+[[nodiscard]]
+std::vector<uint8_t> downsample_srgb(
+    const uint8_t* pixels,
+    uint32_t width,
+    uint32_t height
+);
+
+void encode_bc1_block(const uint8_t* pixels, uint8_t* block);
+void encode_bc3_block(const uint8_t* pixels, uint8_t* block);
+
+/** Encodes in mode 6: one subset of 7 bit RGBA endpoints, 4 bit indices. */
+void encode_bc7_block(const uint8_t* pixels, uint8_t* block);
+
+/**
+ * Decodes a block back to 4x4 RGBA8 pixels. BC7 blocks are only decoded in
+ * mode 6, the one encode_bc7_block writes, other modes decode to black.
+ */
+void decode_block(ETextureFormat format, const uint8_t* block, uint8_t* pixels);
+
+/** Decodes one level of a texture back to RGBA8. */
+[[nodiscard]]
+std::vector<uint8_t> decode_texture_level(
+    const TextureData& texture,
+    uint32_t level
+);
+
+/**
+ * Peak signal to noise ratio in dB between two RGBA8 images, over the color
+ * channels and optionally alpha. Infinite when the images are identical.
+ */
+[[nodiscard]]
+double compute_psnr(
+    const uint8_t* reference,
+    const uint8_t* pixels,
+    size_t pixel_count,
+    bool include_alpha
+);
+
+/**
+ * Switches the encoders between their SSE2 and scalar loops, which encode the
+ * same bytes, so tests can check both. Returns false if the build has no SSE2
+ * loops to switch to.
+ */
+bool set_texture_cooker_sse2(bool enabled);
@@ -0,0 +1,64 @@
+#include "TextureData.h"
+
+#include <algorithm>
+
+uint32_t get_mip_level_count(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+uint32_t get_texture_block_size(ETextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1:
+            return 8;
+        case TEXTURE_FORMAT_BC3:
+        case TEXTURE_FORMAT_BC7:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+bool is_block_compressed(ETextureFormat format)
+{
+    return format != TEXTURE_FORMAT_RGBA8;
+}
+
+uint64_t get_texture_level_size(
+    ETextureFormat format,
+    uint32_t width,
+    uint32_t height
+)
+{
+    if (!is_block_compressed(format))
+    {
+        return (uint64_t)width * height * get_texture_block_size(format);
+    }
+
+    // Partial blocks at the edges take up a whole block
+    const uint64_t blocks_x = (width + 3) / 4;
+    const uint64_t blocks_y = (height + 3) / 4;
+    return blocks_x * blocks_y * get_texture_block_size(format);
+}
+
+const char* get_texture_format_name(ETextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1:
+            return "BC1";
+        case TEXTURE_FORMAT_BC3:
+            return "BC3";
+        case TEXTURE_FORMAT_BC7:
+            return "BC7";
+        default:
+            return "RGBA8";
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class MappedFile;
+
+enum ETextureFormat
+{
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1, // RGB, 8 bytes per 4x4 block
+    TEXTURE_FORMAT_BC3, // RGBA, 16 bytes per 4x4 block
+    TEXTURE_FORMAT_BC7, // RGBA, 16 bytes per 4x4 block
+};
+
+/** Formats textures are cooked to before they're uploaded */
+enum ETextureCompression
+{
+    /** Uploaded as decoded, with mips downsampled on the CPU */
+    TEXTURE_COMPRESSION_NONE,
+    /** BC1 for opaque textures, BC3 for ones with alpha */
+    TEXTURE_COMPRESSION_BC1_BC3,
+    /** BC7 for every texture */
+    TEXTURE_COMPRESSION_BC7,
+};
+
+/** One mip level, as a byte range of the texture's data */
+struct TextureLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+ * Pixels of a texture, ready for upload. Decoded images only have their top
+ * level, cooked ones have their full mip chain.
+ */
+struct TextureData
+{
+    ETextureFormat format = TEXTURE_FORMAT_RGBA8;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TextureLevel> levels;
+
+    /** The levels, either owned or in a mapped cooked texture */
+    std::vector<uint8_t> pixels;
+    std::shared_ptr<MappedFile> file;
+    const uint8_t* mapped_data = nullptr;
+    uint64_t mapped_size = 0;
+
+    [[nodiscard]]
+    bool empty() const { return levels.empty(); }
+
+    [[nodiscard]]
+    const uint8_t* get_data() const
+    {
+        return mapped_data ? mapped_data : pixels.data();
+    }
+
+    [[nodiscard]]
+    uint64_t get_size() const
+    {
+        return mapped_data ? mapped_size : (uint64_t)pixels.size();
+    }
+};
+
+/** Number of levels in a full mip chain down to 1x1. */
+[[nodiscard]]
+uint32_t get_mip_level_count(uint32_t width, uint32_t height);
+
+/** Bytes per 4x4 block of a compressed format, or per pixel for RGBA8. */
+[[nodiscard]]
+uint32_t get_texture_block_size(ETextureFormat format);
+
+[[nodiscard]]
+bool is_block_compressed(ETextureFormat format);
+
+/** Bytes a level of the given size takes up in a format. */
+[[nodiscard]]
+uint64_t get_texture_level_size(
+    ETextureFormat format,
+    uint32_t width,
+    uint32_t height
+);
+
+[[nodiscard]]
+const char* get_texture_format_name(ETextureFormat format);
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+/**
+ * Refers to an item of a HandlePool. The generation tells apart the items that
+ * used the same slot over time, so a handle to a removed item never resolves
+ * to whatever was inserted in its place.
+ */
+template <typename T>
+struct Handle
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	[[nodiscard]]
+	bool is_null() const { return index == UINT32_MAX; }
+
+	bool operator==(const Handle&) const = default;
+};
+
+/**
+ * Items stored contiguously and referred to by generational handles. Removing
+ * an item moves the last one into its place, so iterating only touches live
+ * items, in no particular order. Inserting or removing invalidates pointers,
+ * references and positions of items, but handles stay valid until their item
+ * is removed.
+ */
+template <typename T>
+class HandlePool
+{
+public:
+	Handle<T> insert(T&& item)
+	{
+		uint32_t index;
+		if (free_slots.empty())
+		{
+			index = (uint32_t)slots.size();
+			slots.push_back({});
+		}
+		else
+		{
+			index = free_slots.back();
+			free_slots.pop_back();
+		}
+
+		slots[index].position = (uint32_t)items.size();
+		items.push_back(std::move(item));
+		item_slots.push_back(index);
+
+		return { index, slots[index].generation };
+	}
+
+	/** Removes an item and returns it. Returns nothing for stale handles. */
+	std::optional<T> remove(Handle<T> handle)
+	{
+		if (!contains(handle))
+		{
+			return std::nullopt;
+		}
+
+		Slot& slot = slots[handle.index];
+		std::optional<T> item(std::move(items[slot.position]));
+
+		// Fill the hole with the last item
+		const uint32_t last = (uint32_t)items.size() - 1;
+		if (slot.position != last)
+		{
+			items[slot.position] = std::move(items[last]);
+			item_slots[slot.position] = item_slots[last];
+			slots[item_slots[last]].position = slot.position;
+		}
+		items.pop_back();
+		item_slots.pop_back();
+
+		// Handles to the slot go stale before it's handed out again
+		slot.position = FREE;
+		slot.generation++;
+		free_slots.push_back(handle.index);
+
+		return item;
+	}
+
+	[[nodiscard]]
+	bool contains(Handle<T> handle) const
+	{
+		return handle.index < slots.size()
+			&& slots[handle.index].position != FREE
+			&& slots[handle.index].generation == handle.generation;
+	}
+
+	/** Returns the item of a handle, or null when the handle is stale. */
+	[[nodiscard]]
+	T* get(Handle<T> handle)
+	{
+		return contains(handle) ? &items[slots[handle.index].position] : nullptr;
+	}
+
+	[[nodiscard]]
+	const T* get(Handle<T> handle) const
+	{
+		return contains(handle) ? &items[slots[handle.index].position] : nullptr;
+	}
+
+	/** Returns the handle of the item at a position of get_items(). */
+	[[nodiscard]]
+	Handle<T> get_handle(size_t position) const
+	{
+		const uint32_t index = item_slots[position];
+		return { index, slots[index].generation };
+	}
+
+	/** Every live item, packed together */
+	[[nodiscard]]
+	std::span<T> get_items() { return items; }
+
+	[[nodiscard]]
+	std::span<const T> get_items() const { return items; }
+
+	[[nodiscard]]
+	size_t size() const { return items.size(); }
+
+	[[nodiscard]]
+	bool empty() const { return items.empty(); }
+
+	auto begin() { return items.begin(); }
+	auto end() { return items.end(); }
+	auto begin() const { return items.begin(); }
+	auto end() const { return items.end(); }
+
+private:
+	static constexpr uint32_t FREE = UINT32_MAX;
+
+	struct Slot
+	{
+		/** Position of the slot's item in items, or FREE */
+		uint32_t position = FREE;
+		uint32_t generation = 0;
+	};
+
+	std::vector<T> items;
+
+	/** The slot of every item, by position */
+	std::vector<uint32_t> item_slots;
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+};
@@ -0,0 +1,130 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE)
+	{
+		file_handle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mapping_handle = CreateFileMappingA(
+		file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_handle)
+	{
+		close();
+		return false;
+	}
+
+	mapped_data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!mapped_data)
+	{
+		close();
+		return false;
+	}
+
+	mapped_size = (size_t)file_size.QuadPart;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped_data)
+	{
+		UnmapViewOfFile(mapped_data);
+	}
+	if (mapping_handle)
+	{
+		CloseHandle(mapping_handle);
+	}
+	if (file_handle)
+	{
+		CloseHandle(file_handle);
+	}
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	file_descriptor = ::open(filename, O_RDONLY);
+	if (file_descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ,
+		MAP_PRIVATE, file_descriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	mapped_data = data;
+	mapped_size = (size_t)file_stat.st_size;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped_data)
+	{
+		munmap(const_cast<void*>(mapped_data), mapped_size);
+	}
+	if (file_descriptor >= 0)
+	{
+		::close(file_descriptor);
+	}
+
+	mapped_data = nullptr;
+	mapped_size = 0;
+	file_descriptor = -1;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Read-only memory mapping of a file. The mapping stays valid until close() is
+ * called or the object is destroyed.
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* filename);
+	void close();
+
+	[[nodiscard]]
+	const void* data() const { return mapped_data; }
+
+	[[nodiscard]]
+	size_t size() const { return mapped_size; }
+
+private:
+	const void* mapped_data = nullptr;
+	size_t mapped_size = 0;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int file_descriptor = -1;
+#endif
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+/**
+ * Hands values from one producer thread to one consumer thread in the order
+ * they were pushed, without dropping any. The consumer takes everything
+ * pushed so far at once. Both sides only hold the lock to swap vectors, so
+ * neither waits on the other for long.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+	void push(T&& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		values.push_back(std::move(value));
+	}
+
+	/**
+	 * Moves every value pushed so far to the end of out, oldest first.
+	 * Returns false if there were none.
+	 */
+	bool drain(std::vector<T>& out)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (values.empty())
+			{
+				return false;
+			}
+			drained.swap(values);
+		}
+
+		out.insert(out.end(), std::make_move_iterator(drained.begin()),
+			std::make_move_iterator(drained.end()));
+		drained.clear();
+		return true;
+	}
+
+private:
+	std::mutex mutex;
+	std::vector<T> values;
+
+	/** Owned by the consumer, and swapped in so values keeps its capacity */
+	std::vector<T> drained;
+};
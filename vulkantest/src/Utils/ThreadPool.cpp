@@ -0,0 +1,343 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+	/** The pool the calling thread works for and its index, if any */
+	thread_local const ThreadPool* current_pool = nullptr;
+	thread_local size_t current_worker = 0;
+} // namespace
+
+ThreadPool::ThreadPool(uint32_t num_threads)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Every queue exists before any worker can steal from it
+	worker_queues.reserve(num_threads);
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		worker_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	workers.reserve(num_threads);
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		workers.emplace_back([this, i]() { worker_loop(i); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::run(JobCounter& counter, std::function<void()>&& job)
+{
+	counter.count.fetch_add(1, std::memory_order_relaxed);
+
+	push_task(
+		[this, &counter, job = std::move(job)]()
+		{
+			job();
+			finish_job(counter);
+		}
+	);
+}
+
+void ThreadPool::run_after(
+	JobCounter& dependency,
+	JobCounter& counter,
+	std::function<void()>&& job
+)
+{
+	// Counted right away, so waiting on counter covers jobs still held back
+	counter.count.fetch_add(1, std::memory_order_relaxed);
+
+	std::function<void()> task =
+		[this, &counter, job = std::move(job)]()
+		{
+			job();
+			finish_job(counter);
+		};
+
+	{
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (!dependency.is_done())
+		{
+			dependency.dependents.push_back(std::move(task));
+			return;
+		}
+	}
+
+	push_task(std::move(task));
+}
+
+void ThreadPool::wait(JobCounter& counter)
+{
+	// Only workers help, since a task they take is one they'd have run next
+	// anyway. Other threads would be stuck with whatever happened to be
+	// queued
+	const bool is_worker = current_pool == this;
+	while (!counter.is_done())
+	{
+		std::function<void()> task;
+		if (is_worker && pop_task(task))
+		{
+			task();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// The last job may still hold the lock it dropped the count under, and
+	// the counter can be destroyed once this returns
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void ThreadPool::finish_job(JobCounter& counter)
+{
+	std::vector<std::function<void()>> dependents;
+	{
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		if (counter.count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			dependents.swap(counter.dependents);
+		}
+	}
+
+	for (std::function<void()>& dependent : dependents)
+	{
+		push_task(std::move(dependent));
+	}
+}
+
+void ThreadPool::parallel_for(
+	size_t count,
+	const std::function<void(size_t)>& function
+)
+{
+	parallel_for_range(count, 1,
+		[&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				function(i);
+			}
+		}
+	);
+}
+
+void ThreadPool::parallel_for_range(
+	size_t count,
+	size_t batch_size,
+	const std::function<void(size_t, size_t)>& function
+)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	batch_size = std::max<size_t>(batch_size, 1);
+
+	// Every participant pulls batches from a shared counter until they run
+	// out. Helpers still queued once the caller is done must not touch its
+	// stack frame, so they share the state and check in before using it
+	struct Loop
+	{
+		const std::function<void(size_t, size_t)>* function;
+		size_t count;
+		size_t batch_size;
+		std::atomic<size_t> next_index = 0;
+
+		/** Helpers running the loop, with CLOSED set once the caller's done */
+		std::atomic<size_t> active = 0;
+	};
+	static constexpr size_t CLOSED = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+	const auto loop = std::make_shared<Loop>();
+	loop->function = &function;
+	loop->count = count;
+	loop->batch_size = batch_size;
+
+	auto run = [](Loop& loop)
+	{
+		size_t first;
+		while ((first = loop.next_index.fetch_add(loop.batch_size))
+			< loop.count)
+		{
+			(*loop.function)(first,
+				std::min(loop.count, first + loop.batch_size));
+		}
+	};
+
+	const size_t num_batches = (count + batch_size - 1) / batch_size;
+	const size_t num_helpers = std::min(num_batches - 1, workers.size());
+
+	for (size_t i = 0; i < num_helpers; i++)
+	{
+		push_task(
+			[loop, run]()
+			{
+				if ((loop->active.fetch_add(1) & CLOSED) == 0)
+				{
+					run(*loop);
+				}
+				loop->active.fetch_sub(1, std::memory_order_release);
+			}
+		);
+	}
+
+	run(*loop);
+
+	// Every batch has been taken, so only helpers in the middle of one are
+	// waited on. Those that haven't started yet find the loop closed
+	loop->active.fetch_or(CLOSED);
+	while ((loop->active.load(std::memory_order_acquire) & ~CLOSED) != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void ThreadPool::push_task(std::function<void()>&& task)
+{
+	// Counted before it's queued, so it's never taken before it's counted
+	queued_count.fetch_add(1);
+
+	// Workers keep what they queue to themselves until someone steals it
+	if (current_pool == this)
+	{
+		WorkerQueue& queue = *worker_queues[current_worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+
+	// A worker going to sleep counts itself before it checks for tasks, and
+	// the count was bumped before this check, so at least one of the two
+	// sees the other. The lock keeps the wake up from landing between its
+	// check and its wait
+	if (sleeping_count.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+		}
+		condition.notify_one();
+	}
+}
+
+bool ThreadPool::pop_task(std::function<void()>& task)
+{
+	if (queued_count.load(std::memory_order_relaxed) == 0)
+	{
+		return false;
+	}
+
+	bool found = false;
+
+	// The newest task of the worker's own queue, whose data is likely still
+	// in cache
+	{
+		WorkerQueue& queue = *worker_queues[current_worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			found = true;
+		}
+	}
+
+	// Then tasks from outside the pool, oldest first
+	if (!found)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!tasks.empty())
+		{
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			found = true;
+		}
+	}
+
+	// Then the oldest task of another worker, starting with the next one so
+	// thieves spread out
+	const size_t num_queues = worker_queues.size();
+	const size_t first_victim = current_worker + 1;
+	for (size_t i = 0; !found && i < num_queues; i++)
+	{
+		WorkerQueue& queue = *worker_queues[(first_victim + i) % num_queues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (found)
+	{
+		queued_count.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return found;
+}
+
+void ThreadPool::worker_loop(size_t index)
+{
+	current_pool = this;
+	current_worker = index;
+
+	for (;;)
+	{
+		std::function<void()> task;
+		if (pop_task(task))
+		{
+			task();
+			continue;
+		}
+
+		sleeping_count.fetch_add(1);
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock,
+			[this]() { return stopping || queued_count.load() > 0; });
+		sleeping_count.fetch_sub(1);
+
+		if (stopping && queued_count.load() == 0)
+		{
+			return;
+		}
+	}
+}
+
+ThreadPool& get_thread_pool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool& get_frame_pool()
+{
+	// The thread handing out the work takes part in it too
+	static ThreadPool pool(
+		std::max(2u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
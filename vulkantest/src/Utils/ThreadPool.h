@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Counts the jobs handed to a ThreadPool under it that haven't finished yet.
+ * Jobs can also be held back until another counter is done, which is how
+ * dependencies between them are expressed. Wait on a counter before it's
+ * destroyed.
+ */
+class JobCounter
+{
+public:
+	JobCounter() = default;
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	[[nodiscard]]
+	bool is_done() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class ThreadPool;
+
+	std::atomic<uint32_t> count = 0;
+
+	/** Jobs waiting for the count to drop to zero */
+	std::vector<std::function<void()>> dependents;
+	std::mutex mutex;
+};
+
+/**
+ * Fixed size pool of worker threads. Every worker has a deque of its own:
+ * tasks it queues go at the back, where it takes its next task from, and
+ * idle workers steal from the front of the others. Tasks queued from outside
+ * the pool go to a shared queue instead.
+ *
+ * A thread waiting on a parallel_for only helps with its own calls, never
+ * with unrelated tasks, so it can't get stuck behind a long one. It doesn't
+ * wait for helpers that haven't started by the time it's done either, they
+ * return right away once they do. Pool tasks can safely fan out into the
+ * pool again that way.
+ */
+class ThreadPool
+{
+public:
+	/** A thread count of zero uses one thread per hardware thread. */
+	explicit ThreadPool(uint32_t num_threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/** Queues a task and returns a future for its result. */
+	template <typename Function>
+	auto submit(Function&& function)
+		-> std::future<std::invoke_result_t<std::decay_t<Function>>>
+	{
+		using Result = std::invoke_result_t<std::decay_t<Function>>;
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(
+			std::forward<Function>(function));
+		std::future<Result> future = task->get_future();
+
+		push_task([task]() { (*task)(); });
+
+		return future;
+	}
+
+	/** Queues a job counted by counter. */
+	void run(JobCounter& counter, std::function<void()>&& job);
+
+	/**
+	 * Queues a job counted by counter once every job counted by dependency
+	 * has finished. Queues it right away if they already have.
+	 */
+	void run_after(
+		JobCounter& dependency,
+		JobCounter& counter,
+		std::function<void()>&& job
+	);
+
+	/**
+	 * Returns once counter is done. Workers of the pool run queued tasks in
+	 * the meantime, so jobs can wait on jobs they queued.
+	 */
+	void wait(JobCounter& counter);
+
+	/**
+	 * Calls function(i) for every i in [0, count) across the pool and the
+	 * calling thread, returning once all calls have finished.
+	 */
+	void parallel_for(size_t count, const std::function<void(size_t)>& function);
+
+	/**
+	 * Calls function(first, last) on consecutive ranges of [0, count), at
+	 * most batch_size long, across the pool and the calling thread. Returns
+	 * once all calls have finished. Cheaper than parallel_for when the work
+	 * per index is small.
+	 */
+	void parallel_for_range(
+		size_t count,
+		size_t batch_size,
+		const std::function<void(size_t, size_t)>& function
+	);
+
+	[[nodiscard]]
+	uint32_t get_thread_count() const { return (uint32_t)workers.size(); }
+
+private:
+	struct WorkerQueue
+	{
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+
+	/**
+	 * Workers queue to their own deque without touching the shared lock,
+	 * unless another worker is asleep and has to be woken.
+	 */
+	void push_task(std::function<void()>&& task);
+
+	/** Takes the calling worker's next task, stealing one if need be. */
+	bool pop_task(std::function<void()>& task);
+
+	/** Counts a job of counter as finished and queues its dependents. */
+	void finish_job(JobCounter& counter);
+
+	void worker_loop(size_t index);
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> worker_queues;
+
+	/** Tasks queued from threads outside the pool */
+	std::deque<std::function<void()>> tasks;
+
+	/** Guards tasks, and sleeping on condition */
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	/** Tasks in every queue, so idle workers know whether to sleep */
+	std::atomic<size_t> queued_count = 0;
+
+	/** Workers asleep or about to be, so pushes know whether to wake one */
+	std::atomic<uint32_t> sleeping_count = 0;
+
+	bool stopping = false;
+};
+
+/**
+ * The pool shared by asset importing and other background work, whose tasks
+ * can take seconds.
+ */
+ThreadPool& get_thread_pool();
+
+/**
+ * The pool the simulation and render threads fan their per frame work out
+ * to. Nothing else is queued to it, so background work never holds a frame
+ * up. Its workers sleep while there's none, which leaves the cores to the
+ * background pool.
+ */
+ThreadPool& get_frame_pool();
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+/**
+ * Hands values from one producer thread to one consumer thread without locks.
+ * The producer writes into the back buffer and publishes it, the consumer
+ * takes the latest published buffer as its front buffer. Neither ever waits
+ * for the other: values published faster than they're taken are skipped, and
+ * the consumer keeps its front buffer until a newer value is published.
+ *
+ * A skipped buffer goes back to the producer as it was, so anything the
+ * producer appends to rather than overwrites carries over. It only reaches
+ * the value written after the one published in its place though, so only
+ * what can come late may be handed over that way.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+	/** The buffer the producer writes the next value into. */
+	[[nodiscard]]
+	T& get_back() { return buffers[back]; }
+
+	/** Hands the back buffer to the consumer and takes a free one back. */
+	void publish()
+	{
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	/**
+	 * Takes the latest published value as the front buffer. Returns false,
+	 * keeping the front buffer, if nothing was published since.
+	 */
+	bool acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+		{
+			return false;
+		}
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	/** The buffer the consumer took last. */
+	[[nodiscard]]
+	T& get_front() { return buffers[front]; }
+
+	/** Every buffer. Only safe once neither thread uses them anymore. */
+	[[nodiscard]]
+	std::span<T> get_buffers() { return buffers; }
+
+private:
+	static constexpr uint8_t INDEX = 0x3;
+
+	/** Set on the middle buffer while it holds a value not taken yet */
+	static constexpr uint8_t FRESH = 0x4;
+
+	std::array<T, 3> buffers = {};
+
+	/** Owned by the producer, the consumer and neither respectively */
+	uint8_t back = 0;
+	uint8_t front = 1;
+	std::atomic<uint8_t> middle = 2;
+};
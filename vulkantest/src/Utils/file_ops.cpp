@@ -0,0 +1,25 @@
+#include "file_ops.h"
+
+#include <filesystem>
+#include <system_error>
+
+bool get_file_stamp(const char* filename, uint64_t& size, int64_t& mtime)
+{
+	std::error_code ec;
+	const std::filesystem::path path(filename);
+
+	size = (uint64_t)std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		return false;
+	}
+
+	const auto write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+	{
+		return false;
+	}
+	mtime = (int64_t)write_time.time_since_epoch().count();
+
+	return true;
+}
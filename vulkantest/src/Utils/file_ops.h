@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Gets the size and modification time of a file, which cooked assets store to
+ * tell whether their source has changed since.
+ */
+bool get_file_stamp(const char* filename, uint64_t& size, int64_t& mtime);
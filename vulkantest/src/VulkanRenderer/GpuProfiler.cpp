@@ -0,0 +1,313 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "vkutils.h"
+
+namespace
+{
+    /** The statistics of EPipelineStatistic, in the order they're returned */
+    const VkQueryPipelineStatisticFlags STATISTICS_FLAGS =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    const uint32_t NO_QUERY = UINT32_MAX;
+} // namespace
+
+void GpuProfiler::init(
+    VkDevice device,
+    float timestamp_period,
+    uint32_t timestamp_valid_bits,
+    bool statistics_supported
+)
+{
+    this->device = device;
+    this->timestamp_period = timestamp_period;
+    timestamp_mask = timestamp_valid_bits >= 64
+        ? UINT64_MAX
+        : (uint64_t(1) << timestamp_valid_bits) - 1;
+    timestamps_supported = timestamp_valid_bits > 0;
+    this->statistics_supported = timestamps_supported && statistics_supported;
+    scopes.clear();
+}
+
+void GpuProfiler::init_frame(FrameQueries& queries) const
+{
+    if (!timestamps_supported)
+    {
+        return;
+    }
+
+    const VkQueryPoolCreateInfo timestamp_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = MAX_GPU_SCOPES * 2,
+        .pipelineStatistics = 0
+    };
+    VK_CHECK(vkCreateQueryPool(
+        device, &timestamp_pool_info, nullptr, &queries.timestamp_pool));
+
+    if (statistics_supported)
+    {
+        const VkQueryPoolCreateInfo statistics_pool_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = MAX_GPU_SCOPES,
+            .pipelineStatistics = STATISTICS_FLAGS
+        };
+        VK_CHECK(vkCreateQueryPool(
+            device, &statistics_pool_info, nullptr, &queries.statistics_pool));
+    }
+
+    queries.scope_queries.reserve(MAX_GPU_SCOPES);
+}
+
+void GpuProfiler::destroy_frame(FrameQueries& queries) const
+{
+    if (queries.timestamp_pool)
+    {
+        vkDestroyQueryPool(device, queries.timestamp_pool, nullptr);
+        queries.timestamp_pool = nullptr;
+    }
+    if (queries.statistics_pool)
+    {
+        vkDestroyQueryPool(device, queries.statistics_pool, nullptr);
+        queries.statistics_pool = nullptr;
+    }
+    queries.scope_queries.clear();
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmd, FrameQueries& queries)
+{
+    if (!timestamps_supported)
+    {
+        return;
+    }
+
+    read_results(queries);
+    queries.scope_queries.clear();
+
+    vkCmdResetQueryPool(cmd, queries.timestamp_pool, 0, MAX_GPU_SCOPES * 2);
+    if (statistics_supported)
+    {
+        vkCmdResetQueryPool(cmd, queries.statistics_pool, 0, MAX_GPU_SCOPES);
+    }
+}
+
+uint32_t GpuProfiler::begin_scope(
+    VkCommandBuffer cmd,
+    FrameQueries& queries,
+    const char* name,
+    bool statistics
+)
+{
+    if (!timestamps_supported
+        || queries.scope_queries.size() == MAX_GPU_SCOPES)
+    {
+        return NO_QUERY;
+    }
+
+    const uint32_t query = (uint32_t)queries.scope_queries.size();
+    statistics = statistics && statistics_supported;
+    queries.scope_queries.push_back({ find_scope(name), statistics });
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        queries.timestamp_pool, query * 2);
+    if (statistics)
+    {
+        vkCmdBeginQuery(cmd, queries.statistics_pool, query, 0);
+    }
+
+    return query;
+}
+
+void GpuProfiler::end_scope(
+    VkCommandBuffer cmd,
+    const FrameQueries& queries,
+    uint32_t query
+) const
+{
+    if (query == NO_QUERY)
+    {
+        return;
+    }
+
+    if (queries.scope_queries[query].statistics)
+    {
+        vkCmdEndQuery(cmd, queries.statistics_pool, query);
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        queries.timestamp_pool, query * 2 + 1);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::get_statistics_flags() const
+{
+    return statistics_supported ? STATISTICS_FLAGS : 0;
+}
+
+std::vector<GpuScopeStats> GpuProfiler::get_stats() const
+{
+    std::vector<GpuScopeStats> stats;
+    stats.reserve(scopes.size());
+
+    for (const Scope& scope : scopes)
+    {
+        if (scope.sample_count == 0)
+        {
+            continue;
+        }
+
+        // The ring fills up from the start, so the first sample_count times
+        // are the ones taken
+        const auto first = scope.times.begin();
+        const auto last = first + scope.sample_count;
+        double total = 0.0;
+        for (auto it = first; it != last; it++)
+        {
+            total += *it;
+        }
+
+        stats.push_back({
+            .name = scope.name,
+            .min_ms = *std::min_element(first, last),
+            .avg_ms = total / scope.sample_count,
+            .max_ms = *std::max_element(first, last),
+            .sample_count = scope.sample_count,
+            .has_statistics = scope.has_statistics,
+            .statistics = scope.statistics
+        });
+    }
+
+    return stats;
+}
+
+uint32_t GpuProfiler::find_scope(const char* name)
+{
+    for (uint32_t i = 0; i < (uint32_t)scopes.size(); i++)
+    {
+        if (scopes[i].name == name)
+        {
+            return i;
+        }
+    }
+
+    scopes.push_back({ .name = name });
+    return (uint32_t)scopes.size() - 1;
+}
+
+void GpuProfiler::read_results(const FrameQueries& queries)
+{
+    const uint32_t query_count = (uint32_t)queries.scope_queries.size();
+    if (query_count == 0)
+    {
+        return;
+    }
+
+    // The frame has completed, so the results are there without waiting.
+    // Each is followed by whether it's available all the same, and scopes
+    // that weren't ended are left out
+    std::array<uint64_t, MAX_GPU_SCOPES * 2 * 2> timestamps = {};
+    const VkResult timestamp_result = vkGetQueryPoolResults(
+        device,
+        queries.timestamp_pool,
+        0,
+        query_count * 2,
+        sizeof(timestamps),
+        timestamps.data(),
+        2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+    if (timestamp_result != VK_NOT_READY)
+    {
+        VK_CHECK(timestamp_result);
+    }
+
+    const size_t statistics_stride = PIPELINE_STATISTIC_COUNT + 1;
+    std::array<uint64_t, MAX_GPU_SCOPES * statistics_stride> statistics = {};
+    if (statistics_supported)
+    {
+        const VkResult statistics_result = vkGetQueryPoolResults(
+            device,
+            queries.statistics_pool,
+            0,
+            query_count,
+            sizeof(statistics),
+            statistics.data(),
+            statistics_stride * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+        );
+        if (statistics_result != VK_NOT_READY)
+        {
+            VK_CHECK(statistics_result);
+        }
+    }
+
+    for (uint32_t i = 0; i < query_count; i++)
+    {
+        const uint64_t* begin = &timestamps[i * 4];
+        const uint64_t* end = &timestamps[i * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0)
+        {
+            continue;
+        }
+
+        // Timestamps count ticks of timestamp_period nanoseconds, and only
+        // their valid bits wrap around
+        Scope& scope = scopes[queries.scope_queries[i].scope];
+        const uint64_t ticks = (end[0] - begin[0]) & timestamp_mask;
+        scope.times[scope.next_sample] =
+            (double)ticks * timestamp_period / 1000000.0;
+        scope.next_sample = (scope.next_sample + 1) % GPU_SCOPE_HISTORY;
+        scope.sample_count =
+            std::min<uint32_t>(scope.sample_count + 1, GPU_SCOPE_HISTORY);
+
+        const uint64_t* scope_statistics = &statistics[i * statistics_stride];
+        if (queries.scope_queries[i].statistics
+            && scope_statistics[PIPELINE_STATISTIC_COUNT] != 0)
+        {
+            scope.has_statistics = true;
+            std::copy(scope_statistics,
+                scope_statistics + PIPELINE_STATISTIC_COUNT,
+                scope.statistics.begin());
+        }
+    }
+}
+
+std::string format_gpu_scope_stats(const std::vector<GpuScopeStats>& stats)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+
+    for (const GpuScopeStats& scope : stats)
+    {
+        out << "GPU " << scope.name << ": " << scope.avg_ms << " ms avg, "
+            << scope.min_ms << " min, " << scope.max_ms << " max over "
+            << scope.sample_count << " frames";
+
+        if (scope.has_statistics)
+        {
+            const auto& statistics = scope.statistics;
+            out << ", vertices "
+                << statistics[PIPELINE_STATISTIC_VERTEX_INVOCATIONS]
+                << ", clipping "
+                << statistics[PIPELINE_STATISTIC_CLIPPING_INVOCATIONS]
+                << " in " << statistics[PIPELINE_STATISTIC_CLIPPING_PRIMITIVES]
+                << " out, fragments "
+                << statistics[PIPELINE_STATISTIC_FRAGMENT_INVOCATIONS]
+                << ", compute "
+                << statistics[PIPELINE_STATISTIC_COMPUTE_INVOCATIONS];
+        }
+        out << "\n";
+    }
+
+    return out.str();
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+/** Scopes one frame can time */
+const uint32_t MAX_GPU_SCOPES = 16;
+
+/** Frames the rolling timings of a scope are taken over */
+const size_t GPU_SCOPE_HISTORY = 120;
+
+/** Pipeline statistics gathered for scopes that ask for them, in this order */
+enum EPipelineStatistic
+{
+    PIPELINE_STATISTIC_VERTEX_INVOCATIONS,
+    PIPELINE_STATISTIC_CLIPPING_INVOCATIONS,
+    PIPELINE_STATISTIC_CLIPPING_PRIMITIVES,
+    PIPELINE_STATISTIC_FRAGMENT_INVOCATIONS,
+    PIPELINE_STATISTIC_COMPUTE_INVOCATIONS,
+    PIPELINE_STATISTIC_COUNT
+};
+
+/**
+ * The query pools of one frame in flight, and the scopes it wrote to them.
+ * Scope i of the frame uses timestamps 2i and 2i + 1, and statistics query i.
+ */
+struct FrameQueries
+{
+    VkQueryPool timestamp_pool = nullptr;
+    VkQueryPool statistics_pool = nullptr;
+
+    struct ScopeQuery
+    {
+        uint32_t scope;
+        bool statistics;
+    };
+    std::vector<ScopeQuery> scope_queries;
+};
+
+/** Rolling GPU time of a named scope, with its latest pipeline statistics */
+struct GpuScopeStats
+{
+    std::string name;
+    double min_ms = 0.0;
+    double avg_ms = 0.0;
+    double max_ms = 0.0;
+    uint32_t sample_count = 0;
+
+    bool has_statistics = false;
+    std::array<uint64_t, PIPELINE_STATISTIC_COUNT> statistics = {};
+};
+
+/**
+ * Times named scopes of a frame's commands on the GPU with timestamp
+ * queries, and gathers pipeline statistics for them when the device
+ * supports it. Results are read back without waiting, once the frame slot
+ * comes around again and its previous frame has completed.
+ */
+class GpuProfiler
+{
+public:
+    /**
+     * Timing is off when the queue's timestampValidBits is 0, and statistics
+     * are off unless pipelineStatisticsQuery and inheritedQueries are
+     * enabled, since scopes span secondary command buffers.
+     */
+    void init(
+        VkDevice device,
+        float timestamp_period,
+        uint32_t timestamp_valid_bits,
+        bool statistics_supported
+    );
+
+    void init_frame(FrameQueries& queries) const;
+    void destroy_frame(FrameQueries& queries) const;
+
+    /**
+     * Reads back what the frame's previous use wrote, which has completed,
+     * and resets its queries. Records the reset, so it has to come first in
+     * the frame's command buffer, outside any render pass.
+     */
+    void begin_frame(VkCommandBuffer cmd, FrameQueries& queries);
+
+    /**
+     * Starts timing a scope, returning its query for end_scope. Scopes can
+     * nest but ones gathering statistics can't. Both have to be recorded
+     * outside render passes begun with secondary command buffers.
+     */
+    uint32_t begin_scope(
+        VkCommandBuffer cmd,
+        FrameQueries& queries,
+        const char* name,
+        bool statistics = false
+    );
+
+    void end_scope(
+        VkCommandBuffer cmd,
+        const FrameQueries& queries,
+        uint32_t query
+    ) const;
+
+    /**
+     * The statistics secondary command buffers recorded inside a scope must
+     * inherit, or 0 if they're off.
+     */
+    [[nodiscard]]
+    VkQueryPipelineStatisticFlags get_statistics_flags() const;
+
+    [[nodiscard]]
+    std::vector<GpuScopeStats> get_stats() const;
+
+private:
+    struct Scope
+    {
+        std::string name;
+
+        /** Latest times in milliseconds, as a ring */
+        std::array<double, GPU_SCOPE_HISTORY> times = {};
+        uint32_t sample_count = 0;
+        uint32_t next_sample = 0;
+
+        bool has_statistics = false;
+        std::array<uint64_t, PIPELINE_STATISTIC_COUNT> statistics = {};
+    };
+
+    uint32_t find_scope(const char* name);
+
+    void read_results(const FrameQueries& queries);
+
+    VkDevice device = nullptr;
+    float timestamp_period = 1.0f;
+    uint64_t timestamp_mask = 0;
+    bool timestamps_supported = false;
+    bool statistics_supported = false;
+
+    std::vector<Scope> scopes;
+};
+
+/** One line per scope, for the log. */
+[[nodiscard]]
+std::string format_gpu_scope_stats(const std::vector<GpuScopeStats>& stats);
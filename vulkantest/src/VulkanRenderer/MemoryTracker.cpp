@@ -0,0 +1,173 @@
+#include "MemoryTracker.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    double to_mib(VkDeviceSize bytes)
+    {
+        return (double)bytes / (1024.0 * 1024.0);
+    }
+} // namespace
+
+bool MemorySnapshot::is_over_budget(float fraction) const
+{
+    for (const MemoryHeapUsage& heap : heaps)
+    {
+        if ((double)heap.usage > (double)heap.budget * fraction)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MemoryTracker::init(VmaAllocator allocator, bool budget_extension)
+{
+    this->allocator = allocator;
+    this->budget_extension = budget_extension;
+    categories = {};
+}
+
+void MemoryTracker::track(VmaAllocation allocation, EMemoryCategory category)
+{
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    categories[category].allocation_count++;
+    categories[category].bytes += info.size;
+
+    // Shows up in VMA's own statistics dumps
+    vmaSetAllocationName(
+        allocator, allocation, get_memory_category_name(category));
+}
+
+void MemoryTracker::untrack(VmaAllocation allocation, EMemoryCategory category)
+{
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    categories[category].allocation_count--;
+    categories[category].bytes -= info.size;
+}
+
+MemorySnapshot MemoryTracker::get_snapshot(uint64_t frame) const
+{
+    MemorySnapshot snapshot;
+    snapshot.frame = frame;
+    snapshot.budget_extension = budget_extension;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot.categories = categories;
+    }
+
+    const VkPhysicalDeviceMemoryProperties* properties;
+    vmaGetMemoryProperties(allocator, &properties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+    vmaGetHeapBudgets(allocator, budgets.data());
+
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++)
+    {
+        const VkMemoryHeap& heap = properties->memoryHeaps[i];
+        snapshot.heaps.push_back({
+            .device_local =
+                (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+            .size = heap.size,
+            .usage = budgets[i].usage,
+            .budget = budgets[i].budget,
+            .block_bytes = budgets[i].statistics.blockBytes,
+            .allocation_bytes = budgets[i].statistics.allocationBytes
+        });
+    }
+
+    return snapshot;
+}
+
+const char* get_memory_category_name(EMemoryCategory category)
+{
+    switch (category)
+    {
+        case MEMORY_CATEGORY_MESHES:
+            return "meshes";
+        case MEMORY_CATEGORY_TEXTURES:
+            return "textures";
+        case MEMORY_CATEGORY_FRAME:
+            return "frame";
+        case MEMORY_CATEGORY_ATTACHMENTS:
+            return "attachments";
+        case MEMORY_CATEGORY_STAGING:
+            return "staging";
+        default:
+            return "other";
+    }
+}
+
+std::string format_memory_snapshot(const MemorySnapshot& snapshot)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+
+    for (size_t i = 0; i < snapshot.heaps.size(); i++)
+    {
+        const MemoryHeapUsage& heap = snapshot.heaps[i];
+        out << "Heap " << i << " (" << (heap.device_local ? "device" : "host")
+            << "): " << to_mib(heap.usage) << " / " << to_mib(heap.budget)
+            << " MiB budget, " << to_mib(heap.block_bytes)
+            << " MiB in VMA blocks, " << to_mib(heap.allocation_bytes)
+            << " MiB allocated, " << to_mib(heap.size) << " MiB heap\n";
+    }
+
+    out << "Allocations:";
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        out << " " << get_memory_category_name((EMemoryCategory)i) << " "
+            << to_mib(snapshot.categories[i].bytes) << " MiB ("
+            << snapshot.categories[i].allocation_count << ")"
+            << (i + 1 < MEMORY_CATEGORY_COUNT ? "," : "\n");
+    }
+
+    return out.str();
+}
+
+std::string memory_snapshot_to_json(const MemorySnapshot& snapshot)
+{
+    std::ostringstream out;
+
+    out << "{\n";
+    out << "  \"frame\": " << snapshot.frame << ",\n";
+    out << "  \"budget_extension\": "
+        << (snapshot.budget_extension ? "true" : "false") << ",\n";
+
+    out << "  \"heaps\": [\n";
+    for (size_t i = 0; i < snapshot.heaps.size(); i++)
+    {
+        const MemoryHeapUsage& heap = snapshot.heaps[i];
+        out << "    { \"index\": " << i
+            << ", \"device_local\": " << (heap.device_local ? "true" : "false")
+            << ", \"size\": " << heap.size
+            << ", \"usage\": " << heap.usage
+            << ", \"budget\": " << heap.budget
+            << ", \"block_bytes\": " << heap.block_bytes
+            << ", \"allocation_bytes\": " << heap.allocation_bytes << " }"
+            << (i + 1 < snapshot.heaps.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"categories\": {\n";
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        out << "    \"" << get_memory_category_name((EMemoryCategory)i)
+            << "\": { \"allocations\": "
+            << snapshot.categories[i].allocation_count
+            << ", \"bytes\": " << snapshot.categories[i].bytes << " }"
+            << (i + 1 < MEMORY_CATEGORY_COUNT ? ",\n" : "\n");
+    }
+    out << "  }\n";
+    out << "}\n";
+
+    return out.str();
+}
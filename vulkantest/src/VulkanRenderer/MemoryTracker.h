@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "vktypes.h"
+
+/** What an allocation is used for, so memory use can be broken down */
+enum EMemoryCategory
+{
+    MEMORY_CATEGORY_MESHES,      // Vertices, indices and meshlets
+    MEMORY_CATEGORY_TEXTURES,
+    MEMORY_CATEGORY_FRAME,       // Buffers every frame in flight has a copy of
+    MEMORY_CATEGORY_ATTACHMENTS, // Render targets
+    MEMORY_CATEGORY_STAGING,     // Upload staging
+    MEMORY_CATEGORY_OTHER,
+    MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryCategoryUsage
+{
+    uint32_t allocation_count = 0;
+    VkDeviceSize bytes = 0;
+};
+
+struct MemoryHeapUsage
+{
+    bool device_local = false;
+    VkDeviceSize size = 0;
+
+    /**
+     * What the process uses and may use of the heap. Estimated by the driver
+     * with VK_EXT_memory_budget, otherwise by VMA from its own blocks and
+     * 80% of the heap size.
+     */
+    VkDeviceSize usage = 0;
+    VkDeviceSize budget = 0;
+
+    /** Memory blocks VMA allocated from the heap, and the bytes in use in them */
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize allocation_bytes = 0;
+};
+
+/** GPU memory use at some frame, per heap and per category */
+struct MemorySnapshot
+{
+    uint64_t frame = 0;
+    bool budget_extension = false;
+    std::vector<MemoryHeapUsage> heaps;
+    std::array<MemoryCategoryUsage, MEMORY_CATEGORY_COUNT> categories = {};
+
+    /** Whether any heap is used beyond the given fraction of its budget. */
+    [[nodiscard]]
+    bool is_over_budget(float fraction = 1.0f) const;
+};
+
+/**
+ * Tags allocations with a category and sums them up per category. Heap
+ * usage and budgets come from VMA, which refreshes them from the driver once
+ * per frame index. Safe to use from several threads.
+ */
+class MemoryTracker
+{
+public:
+    void init(VmaAllocator allocator, bool budget_extension);
+
+    /** Counts an allocation towards a category and names it after it. */
+    void track(VmaAllocation allocation, EMemoryCategory category);
+
+    /** Takes a tracked allocation back out, before it's freed. */
+    void untrack(VmaAllocation allocation, EMemoryCategory category);
+
+    [[nodiscard]]
+    MemorySnapshot get_snapshot(uint64_t frame) const;
+
+private:
+    VmaAllocator allocator = nullptr;
+    bool budget_extension = false;
+
+    std::array<MemoryCategoryUsage, MEMORY_CATEGORY_COUNT> categories = {};
+    mutable std::mutex mutex;
+};
+
+[[nodiscard]]
+const char* get_memory_category_name(EMemoryCategory category);
+
+/** One line per heap and one for the categories, for the log. */
+[[nodiscard]]
+std::string format_memory_snapshot(const MemorySnapshot& snapshot);
+
+[[nodiscard]]
+std::string memory_snapshot_to_json(const MemorySnapshot& snapshot);
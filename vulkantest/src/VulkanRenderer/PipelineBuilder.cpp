@@ -1,17 +1,31 @@
 #include "PipelineBuilder.h"
 
+#include <array>
 #include <iostream>
 
 VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
 {
-    // One viewport and scissor box only
+    // One viewport and scissor box only. They're set when drawing, so
+    // pipelines don't have to be rebuilt when the swapchain is resized
     const VkPipelineViewportStateCreateInfo viewport_state = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .pNext = nullptr,
         .viewportCount = 1,
-        .pViewports = &viewport,
+        .pViewports = nullptr,
         .scissorCount = 1,
-        .pScissors = &scissor
+        .pScissors = nullptr
+    };
+
+    const std::array<VkDynamicState, 2> dynamic_states = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    const VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .dynamicStateCount = (uint32_t)dynamic_states.size(),
+        .pDynamicStates = dynamic_states.data()
     };
 
     // Set up color blending. We're not using it yet but we still need to
@@ -39,6 +53,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
         .pMultisampleState = &multisample,
         .pDepthStencilState = &depth_stencil,
         .pColorBlendState = &blend,
+        .pDynamicState = &dynamic_state,
         .layout = pipeline_layout,
         .renderPass = pass,
         .subpass = 0,
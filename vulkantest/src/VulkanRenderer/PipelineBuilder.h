@@ -10,8 +10,6 @@ struct PipelineBuilder
     std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
     VkPipelineVertexInputStateCreateInfo vertex_input;
     VkPipelineInputAssemblyStateCreateInfo input_assembly;
-    VkViewport viewport;
-    VkRect2D scissor;
     VkPipelineRasterizationStateCreateInfo raster;
     VkPipelineColorBlendAttachmentState blend_attachment;
     VkPipelineMultisampleStateCreateInfo multisample;
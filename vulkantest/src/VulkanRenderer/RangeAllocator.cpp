@@ -0,0 +1,96 @@
+#include "RangeAllocator.h"
+
+#include <cassert>
+
+void RangeAllocator::init(uint64_t capacity)
+{
+    this->capacity = capacity;
+    used = 0;
+
+    free_by_offset.clear();
+    free_by_size.clear();
+    if (capacity > 0)
+    {
+        insert_free(0, capacity);
+    }
+}
+
+bool RangeAllocator::allocate(uint64_t size, uint64_t& offset)
+{
+    if (size == 0)
+    {
+        offset = 0;
+        return true;
+    }
+
+    // Best fit, lowest offset among equal sizes
+    const auto best = free_by_size.lower_bound({ size, 0 });
+    if (best == free_by_size.end())
+    {
+        return false;
+    }
+
+    offset = best->second;
+    const uint64_t free_size = best->first;
+    erase_free(free_by_offset.find(offset));
+
+    // Whatever is left of the range stays free
+    if (free_size > size)
+    {
+        insert_free(offset + size, free_size - size);
+    }
+
+    used += size;
+    return true;
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    assert(offset + size <= capacity && size <= used);
+    used -= size;
+
+    // Merge with the free ranges right after and right before
+    const auto next = free_by_offset.find(offset + size);
+    if (next != free_by_offset.end())
+    {
+        size += next->second;
+        erase_free(next);
+    }
+
+    const auto after = free_by_offset.lower_bound(offset);
+    if (after != free_by_offset.begin())
+    {
+        const auto previous = std::prev(after);
+        assert(previous->first + previous->second <= offset);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            erase_free(previous);
+        }
+    }
+
+    insert_free(offset, size);
+}
+
+uint64_t RangeAllocator::get_largest_free() const
+{
+    return free_by_size.empty() ? 0 : free_by_size.rbegin()->first;
+}
+
+void RangeAllocator::insert_free(uint64_t offset, uint64_t size)
+{
+    free_by_offset.emplace(offset, size);
+    free_by_size.emplace(size, offset);
+}
+
+void RangeAllocator::erase_free(std::map<uint64_t, uint64_t>::iterator it)
+{
+    free_by_size.erase({ it->second, it->first });
+    free_by_offset.erase(it);
+}
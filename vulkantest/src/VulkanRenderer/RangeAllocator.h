@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+/**
+ * Hands out ranges of a fixed size space, like the elements of a shared
+ * buffer. Free ranges are kept both by offset, so freed ranges merge with
+ * their neighbours, and by size, so allocations take the smallest free range
+ * they fit in. Both are logarithmic in the number of free ranges.
+ */
+class RangeAllocator
+{
+public:
+    void init(uint64_t capacity);
+
+    /**
+     * Allocates size units and returns whether a free range was big enough.
+     * Empty allocations always succeed at offset 0.
+     */
+    [[nodiscard]]
+    bool allocate(uint64_t size, uint64_t& offset);
+
+    /** Frees a range returned by allocate, with the same size. */
+    void free(uint64_t offset, uint64_t size);
+
+    [[nodiscard]]
+    uint64_t get_capacity() const { return capacity; }
+
+    [[nodiscard]]
+    uint64_t get_used() const { return used; }
+
+    /** The biggest allocation that would succeed right now. */
+    [[nodiscard]]
+    uint64_t get_largest_free() const;
+
+private:
+    void insert_free(uint64_t offset, uint64_t size);
+    void erase_free(std::map<uint64_t, uint64_t>::iterator it);
+
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+
+    /** Free ranges as offset to size, and as (size, offset) pairs */
+    std::map<uint64_t, uint64_t> free_by_offset;
+    std::set<std::pair<uint64_t, uint64_t>> free_by_size;
+};
@@ -0,0 +1,140 @@
+#include "StagingRing.h"
+
+#include "vkutils.h"
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    /** How much of size fits between start and end, in whole granules */
+    VkDeviceSize fit(
+        VkDeviceSize start,
+        VkDeviceSize end,
+        VkDeviceSize size,
+        VkDeviceSize granularity
+    )
+    {
+        if (start >= end)
+        {
+            return 0;
+        }
+
+        const VkDeviceSize available = end - start;
+        if (size <= available)
+        {
+            return size;
+        }
+        return available / granularity * granularity;
+    }
+} // namespace
+
+void StagingRing::init(VmaAllocator allocator, VkDeviceSize capacity)
+{
+    this->allocator = allocator;
+    this->capacity = capacity;
+
+    const VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .size = capacity,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT // transfer commands only
+    };
+
+    // Mapped once for the lifetime of the buffer
+    const VmaAllocationCreateInfo alloc_info = {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY
+    };
+
+    VmaAllocationInfo allocation_info;
+    VK_CHECK(vmaCreateBuffer(
+        allocator,
+        &buffer_info,
+        &alloc_info,
+        &buffer.buffer,
+        &buffer.allocation,
+        &allocation_info)
+    );
+
+    data = static_cast<char*>(allocation_info.pMappedData);
+}
+
+void StagingRing::destroy()
+{
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    buffer = {};
+    data = nullptr;
+}
+
+VkDeviceSize StagingRing::allocate(
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    VkDeviceSize granularity,
+    VkDeviceSize& offset
+)
+{
+    if (get_used() == 0)
+    {
+        // Nothing is in use, so start over from the beginning
+        head = 0;
+        tail = 0;
+    }
+    else if (head == tail)
+    {
+        // Full
+        return 0;
+    }
+
+    // The free space after the head runs up to the tail, or to the end of
+    // the buffer when the tail is behind the head
+    VkDeviceSize start = align_up(head, alignment);
+    const VkDeviceSize end = head < tail ? tail : capacity;
+    VkDeviceSize allocated_size = fit(start, end, size, granularity);
+
+    // Otherwise wrap around to the beginning, skipping the rest of the end
+    if (allocated_size == 0 && head > tail)
+    {
+        allocated_size = fit(0, tail, size, granularity);
+        if (allocated_size > 0)
+        {
+            allocated += capacity - head;
+            head = 0;
+            start = 0;
+        }
+    }
+
+    if (allocated_size == 0)
+    {
+        return 0;
+    }
+
+    allocated += start + allocated_size - head;
+    head = start + allocated_size;
+    offset = start;
+
+    return allocated_size;
+}
+
+void StagingRing::close(uint64_t value)
+{
+    const uint64_t closed = regions.empty() ? released : regions.back().allocated;
+    if (allocated == closed)
+    {
+        return;
+    }
+
+    regions.push_back({ value, head, allocated });
+}
+
+void StagingRing::release(uint64_t completed_value)
+{
+    while (!regions.empty() && regions.front().value <= completed_value)
+    {
+        tail = regions.front().head;
+        released = regions.front().allocated;
+        regions.pop_front();
+    }
+}
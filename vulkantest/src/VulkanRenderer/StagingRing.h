@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include <vulkan/vulkan_core.h>
+
+#include "vktypes.h"
+
+/**
+ * Fixed size staging buffer, persistently mapped and handed out as a ring.
+ * Allocations are made at the head. Every submission closes the allocations
+ * made since the previous one under the timeline value it signals, and the
+ * tail moves past them once that value is reached, so staging memory stays
+ * bounded however much is uploaded.
+ */
+class StagingRing
+{
+public:
+    void init(VmaAllocator allocator, VkDeviceSize capacity);
+    void destroy();
+
+    /**
+     * Allocates size bytes at the given alignment and returns how many were
+     * allocated. When they don't fit in one piece, allocates the largest
+     * multiple of granularity that does instead. Returns 0 when not even that
+     * fits right now.
+     */
+    [[nodiscard]]
+    VkDeviceSize allocate(
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        VkDeviceSize granularity,
+        VkDeviceSize& offset
+    );
+
+    /** Closes the allocations made since the last call under value. */
+    void close(uint64_t value);
+
+    /** Frees the allocations closed under values up to completed_value. */
+    void release(uint64_t completed_value);
+
+    [[nodiscard]]
+    VkBuffer get_buffer() const { return buffer.buffer; }
+
+    [[nodiscard]]
+    VmaAllocation get_allocation() const { return buffer.allocation; }
+
+    [[nodiscard]]
+    char* get_data() const { return data; }
+
+    [[nodiscard]]
+    VkDeviceSize get_capacity() const { return capacity; }
+
+    /** Bytes between the tail and the head, including any skipped at the end */
+    [[nodiscard]]
+    VkDeviceSize get_used() const { return allocated - released; }
+
+private:
+    struct Region
+    {
+        uint64_t value;
+
+        /** The head and the allocation count when the region was closed */
+        VkDeviceSize head;
+        uint64_t allocated;
+    };
+
+    VmaAllocator allocator = nullptr;
+    Buffer buffer = {};
+    char* data = nullptr;
+    VkDeviceSize capacity = 0;
+
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+
+    /** Running totals of bytes allocated and released */
+    uint64_t allocated = 0;
+    uint64_t released = 0;
+
+    std::deque<Region> regions;
+};
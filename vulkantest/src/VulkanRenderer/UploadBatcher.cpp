@@ -0,0 +1,532 @@
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "vkinit.h"
+#include "vkutils.h"
+
+namespace
+{
+    /**
+     * Uploaded buffers are read as vertices and indices, and as storage
+     * buffers by the culling pass and the shaders.
+     */
+    constexpr VkPipelineStageFlags BUFFER_DST_STAGE_MASK =
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    constexpr VkAccessFlags BUFFER_DST_ACCESS_MASK =
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+        | VK_ACCESS_SHADER_READ_BIT;
+
+    /**
+     * Staging allocations start at this alignment, which covers the texel
+     * block size of every format.
+     */
+    constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    /** Split buffer uploads keep their pieces 4 byte aligned */
+    constexpr VkDeviceSize BUFFER_CHUNK_GRANULARITY = 4;
+} // namespace
+
+void UploadAcquires::append(const UploadAcquires& other)
+{
+    buffers.insert(buffers.end(), other.buffers.begin(), other.buffers.end());
+    images.insert(images.end(), other.images.begin(), other.images.end());
+    stage_mask |= other.stage_mask;
+}
+
+void UploadAcquires::clear()
+{
+    buffers.clear();
+    images.clear();
+    stage_mask = 0;
+}
+
+void UploadAcquires::record(VkCommandBuffer cmd) const
+{
+    if (empty())
+    {
+        return;
+    }
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stage_mask,
+        0, 0, nullptr, (uint32_t)buffers.size(), buffers.data(),
+        (uint32_t)images.size(), images.data());
+}
+
+void UploadBatcher::init(
+    VkDevice device,
+    VmaAllocator allocator,
+    VkQueue queue,
+    uint32_t queue_family_index,
+    uint32_t destination_family_index,
+    VkExtent3D image_granularity,
+    VkDeviceSize staging_size,
+    std::mutex* queue_mutex
+)
+{
+    this->device = device;
+    this->queue = queue;
+    this->queue_mutex = queue_mutex;
+    this->queue_family_index = queue_family_index;
+    this->destination_family_index = destination_family_index;
+    this->image_granularity = image_granularity;
+
+    staging_ring.init(allocator, staging_size);
+
+    const VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    const VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+        .flags = 0
+    };
+    VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+}
+
+void UploadBatcher::destroy()
+{
+    wait();
+    uploads.clear();
+
+    for (const Batch& batch : free_batches)
+    {
+        vkDestroyCommandPool(device, batch.command_pool, nullptr);
+    }
+    free_batches.clear();
+
+    staging_ring.destroy();
+    vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+void UploadBatcher::copy_to_buffer(
+    const void* data,
+    VkDeviceSize size,
+    VkBuffer buffer,
+    VkDeviceSize buffer_offset
+)
+{
+    // Empty copies aren't valid Vulkan commands
+    if (size == 0)
+    {
+        return;
+    }
+
+    PendingUpload upload;
+    upload.data = static_cast<const char*>(data);
+    upload.size = size;
+    upload.buffer = buffer;
+    upload.buffer_offset = buffer_offset;
+    uploads.push_back(std::move(upload));
+}
+
+void UploadBatcher::copy_to_image(ImageUpload&& image)
+{
+    PendingUpload upload;
+    upload.image = std::move(image);
+    uploads.push_back(std::move(upload));
+}
+
+UploadAcquires UploadBatcher::take_acquires()
+{
+    UploadAcquires acquires = std::move(retired_acquires);
+    retired_acquires.clear();
+    return acquires;
+}
+
+void UploadBatcher::submit()
+{
+    while (!uploads.empty())
+    {
+        Batch batch = begin_batch();
+
+        while (!uploads.empty())
+        {
+            PendingUpload& upload = uploads.front();
+
+            const bool done = upload.image.image
+                ? record_image_upload(batch, upload)
+                : record_buffer_upload(batch, upload);
+            if (!done)
+            {
+                break;
+            }
+            uploads.pop_front();
+        }
+
+        submit_batch(std::move(batch));
+
+        // The ring is full, so make room for the rest
+        if (!uploads.empty())
+        {
+            wait_oldest();
+        }
+    }
+}
+
+void UploadBatcher::poll()
+{
+    if (batches.empty())
+    {
+        return;
+    }
+
+    uint64_t value;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+
+    while (!batches.empty() && batches.front().value <= value)
+    {
+        Batch batch = std::move(batches.front());
+        batches.pop_front();
+        retire(std::move(batch));
+    }
+}
+
+void UploadBatcher::wait()
+{
+    while (!batches.empty())
+    {
+        wait_oldest();
+    }
+}
+
+UploadBatcher::Batch UploadBatcher::begin_batch()
+{
+    Batch batch;
+    if (!free_batches.empty())
+    {
+        batch = std::move(free_batches.back());
+        free_batches.pop_back();
+    }
+    else
+    {
+        const VkCommandPoolCreateInfo pool_info =
+            vkinit::command_pool_create_info(queue_family_index);
+        VK_CHECK(vkCreateCommandPool(
+            device, &pool_info, nullptr, &batch.command_pool));
+
+        const VkCommandBufferAllocateInfo alloc_info =
+            vkinit::command_buffer_allocate_info(batch.command_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(
+            device, &alloc_info, &batch.command_buffer));
+    }
+
+    const VkCommandBufferBeginInfo begin_info =
+        vkinit::command_buffer_begin_info(
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(batch.command_buffer, &begin_info));
+
+    return batch;
+}
+
+void UploadBatcher::submit_batch(Batch&& batch)
+{
+    // Hand the buffers over to the family that uses them
+    if (!batch.buffer_releases.empty())
+    {
+        vkCmdPipelineBarrier(batch.command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+            (uint32_t)batch.buffer_releases.size(),
+            batch.buffer_releases.data(), 0, nullptr);
+
+        for (VkBufferMemoryBarrier acquire : batch.buffer_releases)
+        {
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = BUFFER_DST_ACCESS_MASK;
+            batch.acquires.buffers.push_back(acquire);
+        }
+        batch.acquires.stage_mask |= BUFFER_DST_STAGE_MASK;
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.command_buffer));
+
+    // Nothing fit, so there's nothing to submit
+    if (batch.copy_count == 0)
+    {
+        VK_CHECK(vkResetCommandPool(device, batch.command_pool, 0));
+        free_batches.push_back(std::move(batch));
+        return;
+    }
+
+    // Signal the batch's value on the timeline, which is polled rather than
+    // waited on here
+    batch.value = submitted_value + 1;
+
+    const VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreValueCount = 0,
+        .pWaitSemaphoreValues = nullptr,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &batch.value
+    };
+
+    VkSubmitInfo submit = vkinit::submit_info(&batch.command_buffer);
+    submit.pNext = &timeline_info;
+    submit.signalSemaphoreCount = 1;
+    submit.pSignalSemaphores = &semaphore;
+    if (queue_mutex)
+    {
+        std::lock_guard<std::mutex> lock(*queue_mutex);
+        VK_CHECK(vkQueueSubmit(queue, 1, &submit, nullptr));
+    }
+    else
+    {
+        VK_CHECK(vkQueueSubmit(queue, 1, &submit, nullptr));
+    }
+
+    // The staging the batch used is freed once it completes
+    staging_ring.close(batch.value);
+    submitted_value = batch.value;
+
+    batches.push_back(std::move(batch));
+}
+
+bool UploadBatcher::record_buffer_upload(Batch& batch, PendingUpload& upload)
+{
+    const VkDeviceSize first_byte = upload.bytes_done;
+
+    while (upload.bytes_done < upload.size)
+    {
+        VkDeviceSize staging_offset;
+        const VkDeviceSize size = staging_ring.allocate(
+            upload.size - upload.bytes_done, STAGING_ALIGNMENT,
+            BUFFER_CHUNK_GRANULARITY, staging_offset);
+        if (size == 0)
+        {
+            break;
+        }
+
+        memcpy(staging_ring.get_data() + staging_offset,
+            upload.data + upload.bytes_done, size);
+
+        const VkBufferCopy region = {
+            .srcOffset = staging_offset,
+            .dstOffset = upload.buffer_offset + upload.bytes_done,
+            .size = size
+        };
+        vkCmdCopyBuffer(batch.command_buffer, staging_ring.get_buffer(),
+            upload.buffer, 1, &region);
+
+        upload.bytes_done += size;
+        batch.copy_count++;
+    }
+
+    // Only the range written by this batch changes hands with it
+    if (transfers_ownership() && upload.bytes_done > first_byte)
+    {
+        batch.buffer_releases.push_back({
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = 0,
+            .srcQueueFamilyIndex = queue_family_index,
+            .dstQueueFamilyIndex = destination_family_index,
+            .buffer = upload.buffer,
+            .offset = upload.buffer_offset + first_byte,
+            .size = upload.bytes_done - first_byte
+        });
+    }
+
+    return upload.bytes_done == upload.size;
+}
+
+bool UploadBatcher::record_image_upload(Batch& batch, PendingUpload& upload)
+{
+    const ImageUpload& image = upload.image;
+    const uint32_t level_count = (uint32_t)image.levels.size();
+
+    // Prepare every level to be copied to, in the first batch that copies
+    // any of them
+    if (!upload.started)
+    {
+        const VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image.image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = level_count,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(batch.command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        upload.started = true;
+    }
+
+    // Levels are split into rows of texel blocks, in multiples of the
+    // queue's granularity. Queues with no granularity only copy whole levels
+    const bool whole_levels = image_granularity.height == 0;
+    const uint32_t row_step = std::max(image_granularity.height, 1u);
+
+    while (upload.level < level_count)
+    {
+        const ImageUploadLevel& level = image.levels[upload.level];
+
+        const uint32_t rows =
+            (level.height + image.block_height - 1) / image.block_height;
+        const VkDeviceSize row_size = level.size / rows;
+        const VkDeviceSize remaining_size =
+            (VkDeviceSize)(rows - upload.rows_done) * row_size;
+
+        VkDeviceSize staging_offset;
+        const VkDeviceSize size = staging_ring.allocate(remaining_size,
+            STAGING_ALIGNMENT,
+            whole_levels ? remaining_size : row_step * row_size,
+            staging_offset);
+        if (size == 0)
+        {
+            // Wait for room unless the ring is already empty
+            if (staging_ring.get_used() > 0)
+            {
+                return false;
+            }
+
+            std::cerr << "Mip level " << upload.level << " is too large for "
+                         "the staging ring and will not be uploaded.\n";
+            upload.level++;
+            upload.rows_done = 0;
+            continue;
+        }
+
+        const uint32_t row_count = (uint32_t)(size / row_size);
+        memcpy(staging_ring.get_data() + staging_offset,
+            static_cast<const char*>(image.data) + level.offset
+                + upload.rows_done * row_size,
+            size);
+
+        const uint32_t y = upload.rows_done * image.block_height;
+        const VkBufferImageCopy copy = {
+            .bufferOffset = staging_offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = upload.level,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            },
+            .imageOffset = { 0, (int32_t)y, 0 },
+            .imageExtent = {
+                level.width,
+                std::min(row_count * image.block_height, level.height - y),
+                1
+            }
+        };
+        vkCmdCopyBufferToImage(batch.command_buffer, staging_ring.get_buffer(),
+            image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+        batch.copy_count++;
+
+        upload.rows_done += row_count;
+        if (upload.rows_done == rows)
+        {
+            upload.level++;
+            upload.rows_done = 0;
+        }
+    }
+
+    release_image(batch, image);
+
+    return true;
+}
+
+void UploadBatcher::release_image(Batch& batch, const ImageUpload& image)
+{
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = image.dst_access_mask,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = image.final_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image.image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = (uint32_t)image.levels.size(),
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+
+    // On the same family the image can go straight to its final layout
+    if (!transfers_ownership())
+    {
+        vkCmdPipelineBarrier(batch.command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, image.dst_stage_mask, 0, 0,
+            nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+
+    // Otherwise the layout transition happens as part of the transfer, and
+    // both halves must describe it the same way
+    barrier.srcQueueFamilyIndex = queue_family_index;
+    barrier.dstQueueFamilyIndex = destination_family_index;
+
+    VkImageMemoryBarrier acquire = barrier;
+    acquire.srcAccessMask = 0;
+    batch.acquires.images.push_back(acquire);
+    batch.acquires.stage_mask |= image.dst_stage_mask;
+
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        &barrier);
+}
+
+void UploadBatcher::wait_oldest()
+{
+    Batch batch = std::move(batches.front());
+    batches.pop_front();
+
+    const VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &batch.value
+    };
+    VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+
+    retire(std::move(batch));
+}
+
+void UploadBatcher::retire(Batch&& batch)
+{
+    // The copies have completed, so their staging can be reused
+    staging_ring.release(batch.value);
+    retired_value = batch.value;
+
+    // The batch's resources are ready to be acquired
+    retired_acquires.append(batch.acquires);
+
+    VK_CHECK(vkResetCommandPool(device, batch.command_pool, 0));
+
+    batch.value = 0;
+    batch.copy_count = 0;
+    batch.buffer_releases.clear();
+    batch.acquires.clear();
+    free_batches.push_back(std::move(batch));
+}
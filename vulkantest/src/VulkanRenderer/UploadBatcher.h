@@ -0,0 +1,242 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "StagingRing.h"
+#include "vktypes.h"
+
+/** One mip level of an image upload, as a byte range of its data */
+struct ImageUploadLevel
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t width;
+    uint32_t height;
+};
+
+/** The levels of an image to upload, and how the image is used afterwards */
+struct ImageUpload
+{
+    VkImage image;
+    const void* data;
+    std::vector<ImageUploadLevel> levels;
+
+    /** Texel block of the format, 1x1 for uncompressed formats */
+    uint32_t block_size;
+    uint32_t block_width;
+    uint32_t block_height;
+
+    VkImageLayout final_layout;
+    VkPipelineStageFlags dst_stage_mask;
+    VkAccessFlags dst_access_mask;
+};
+
+/**
+ * Acquire halves of the ownership transfers of finished uploads, recorded on
+ * the queue family that uses them.
+ */
+struct UploadAcquires
+{
+    std::vector<VkBufferMemoryBarrier> buffers;
+    std::vector<VkImageMemoryBarrier> images;
+    VkPipelineStageFlags stage_mask = 0;
+
+    [[nodiscard]]
+    bool empty() const { return buffers.empty() && images.empty(); }
+
+    void append(const UploadAcquires& other);
+    void clear();
+
+    /**
+     * Records every acquire. The submit they're recorded in must wait on
+     * the uploads' batches.
+     */
+    void record(VkCommandBuffer cmd) const;
+};
+
+/**
+ * Collects the copies of every pending upload and submits them in as few
+ * batches as possible. Each batch is one command buffer and one submit, which
+ * signals the next value of a timeline semaphore.
+ *
+ * Copies are staged through a persistently mapped ring. Each batch frees its
+ * part of the ring once its value is reached. Uploads bigger than the free
+ * space are split: buffers by bytes, images by rows of texel blocks. The ring
+ * is never grown, so when it's full, submitting waits for the oldest batch.
+ *
+ * Uploads may run on a dedicated transfer queue. Its family then releases
+ * every uploaded resource at the end of the batch that finishes it. The
+ * queue that uses them acquires them with the barriers take_acquires returns
+ * once the batch has retired.
+ */
+class UploadBatcher
+{
+public:
+    /**
+     * Uploads are submitted to queue, from queue_family_index, and used by
+     * the queue family at destination_family_index. image_granularity is the
+     * queue family's minImageTransferGranularity. When another thread
+     * submits to the same queue, queue_mutex is locked around every submit.
+     */
+    void init(
+        VkDevice device,
+        VmaAllocator allocator,
+        VkQueue queue,
+        uint32_t queue_family_index,
+        uint32_t destination_family_index,
+        VkExtent3D image_granularity,
+        VkDeviceSize staging_size,
+        std::mutex* queue_mutex = nullptr
+    );
+
+    /** Waits for the batches in flight, then destroys the Vulkan objects. */
+    void destroy();
+
+    /**
+     * Queues a copy into a buffer. The data is read when the batch is
+     * submitted, so it must stay valid until then.
+     */
+    void copy_to_buffer(
+        const void* data,
+        VkDeviceSize size,
+        VkBuffer buffer,
+        VkDeviceSize buffer_offset
+    );
+
+    /**
+     * Queues the copy of every level of an image, which must be newly
+     * created. Like copy_to_buffer, the data must stay valid until the batch
+     * is submitted.
+     */
+    void copy_to_image(ImageUpload&& upload);
+
+    /**
+     * Returns the acquire half of the ownership transfers of every retired
+     * batch not acquired yet. The submit they're recorded in must wait on
+     * get_semaphore() reaching get_retired_value().
+     */
+    [[nodiscard]]
+    UploadAcquires take_acquires();
+
+    /** Whether copies are waiting to be submitted. */
+    [[nodiscard]]
+    bool has_pending() const { return !uploads.empty(); }
+
+    /** Whether any submitted batch hasn't been retired yet. */
+    [[nodiscard]]
+    bool in_flight() const { return !batches.empty(); }
+
+    /** Whether uploads run on another queue family than their users. */
+    [[nodiscard]]
+    bool transfers_ownership() const
+    {
+        return queue_family_index != destination_family_index;
+    }
+
+    [[nodiscard]]
+    VkSemaphore get_semaphore() const { return semaphore; }
+
+    [[nodiscard]]
+    VmaAllocation get_staging_allocation() const
+    {
+        return staging_ring.get_allocation();
+    }
+
+    /** Timeline value signaled by the last batch submitted. */
+    [[nodiscard]]
+    uint64_t get_submitted_value() const { return submitted_value; }
+
+    /** Timeline value signaled by the last batch that retired. */
+    [[nodiscard]]
+    uint64_t get_retired_value() const { return retired_value; }
+
+    /**
+     * Stages, records and submits every queued copy. Only blocks when the
+     * staging ring is full, until the oldest batch completes.
+     */
+    void submit();
+
+    /** Retires every batch that has completed. Never blocks. */
+    void poll();
+
+    /** Blocks until every batch in flight has completed and retires them. */
+    void wait();
+
+private:
+    struct PendingUpload
+    {
+        /** Buffer copies have no image */
+        ImageUpload image = {};
+        const char* data = nullptr;
+        VkDeviceSize size = 0;
+        VkBuffer buffer = nullptr;
+        VkDeviceSize buffer_offset = 0;
+
+        /** How much has been recorded so far */
+        bool started = false;
+        VkDeviceSize bytes_done = 0;
+        uint32_t level = 0;
+        uint32_t rows_done = 0;
+    };
+
+    struct Batch
+    {
+        VkCommandPool command_pool = nullptr;
+        VkCommandBuffer command_buffer = nullptr;
+        uint64_t value = 0;
+        uint32_t copy_count = 0;
+
+        /** Releases of the buffer ranges written by the batch */
+        std::vector<VkBufferMemoryBarrier> buffer_releases;
+
+        /** Acquires matching the batch's releases */
+        UploadAcquires acquires;
+    };
+
+    /** Starts recording a batch, reusing the command pool of a retired one. */
+    Batch begin_batch();
+
+    void submit_batch(Batch&& batch);
+
+    /**
+     * Records as much of an upload as fits in the staging ring. Returns
+     * whether all of it has been recorded.
+     */
+    bool record_buffer_upload(Batch& batch, PendingUpload& upload);
+    bool record_image_upload(Batch& batch, PendingUpload& upload);
+
+    /** Moves every level of a fully written image to its final layout. */
+    void release_image(Batch& batch, const ImageUpload& image);
+
+    /** Blocks until the oldest batch in flight completes, then retires it. */
+    void wait_oldest();
+
+    void retire(Batch&& batch);
+
+    VkDevice device = nullptr;
+    VkQueue queue = nullptr;
+    std::mutex* queue_mutex = nullptr;
+    uint32_t queue_family_index = 0;
+    uint32_t destination_family_index = 0;
+    VkExtent3D image_granularity = {};
+
+    StagingRing staging_ring;
+
+    /** Counts submitted batches. Each batch signals its own value. */
+    VkSemaphore semaphore = nullptr;
+    uint64_t submitted_value = 0;
+    uint64_t retired_value = 0;
+
+    std::deque<PendingUpload> uploads;
+
+    /** Batches in flight, oldest first, and retired ones free for reuse */
+    std::deque<Batch> batches;
+    std::vector<Batch> free_batches;
+
+    /** Acquires of the batches that retired since they were last taken */
+    UploadAcquires retired_acquires;
+};
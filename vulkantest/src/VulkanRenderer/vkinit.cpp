@@ -269,6 +269,47 @@ vkinit::write_descriptor_buffer(
     return descriptor_write;
 }
 
+VkWriteDescriptorSet
+vkinit::write_descriptor_image(
+    VkDescriptorType type,
+    VkDescriptorSet set,
+    VkDescriptorImageInfo* image_info,
+    uint32_t binding
+)
+{
+    const VkWriteDescriptorSet descriptor_write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = type,
+        .pImageInfo = image_info
+    };
+    return descriptor_write;
+}
+
+VkSamplerCreateInfo
+vkinit::sampler_create_info(
+    VkFilter filter,
+    VkSamplerAddressMode address_mode
+)
+{
+    const VkSamplerCreateInfo sampler = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .magFilter = filter,
+        .minFilter = filter,
+        .mipmapMode = filter == VK_FILTER_LINEAR
+            ? VK_SAMPLER_MIPMAP_MODE_LINEAR
+            : VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = address_mode,
+        .addressModeV = address_mode,
+        .addressModeW = address_mode,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE
+    };
+    return sampler;
+}
 
 VkCommandBufferBeginInfo
 vkinit::command_buffer_begin_info(VkCommandBufferUsageFlags flags)
@@ -90,6 +90,20 @@ namespace vkinit
         uint32_t binding
     );
 
+    VkWriteDescriptorSet
+    write_descriptor_image(
+        VkDescriptorType type,
+        VkDescriptorSet set,
+        VkDescriptorImageInfo* image_info,
+        uint32_t binding
+    );
+
+    VkSamplerCreateInfo
+    sampler_create_info(
+        VkFilter filter,
+        VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT
+    );
+
     VkCommandBufferBeginInfo
     command_buffer_begin_info(VkCommandBufferUsageFlags flags);
 
@@ -7,6 +7,13 @@ struct Buffer
 {
     VkBuffer buffer;
     VmaAllocation allocation;
+
+    /**
+     * Where persistently mapped buffers are mapped, and whether writes
+     * through the mapping have to be flushed
+     */
+    void* mapped_data = nullptr;
+    bool needs_flush = false;
 };
 
 struct Image
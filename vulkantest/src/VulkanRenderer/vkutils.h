@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
 #include <format>
 #include <iostream>
+#include <string_view>
+#include <utility>
 
 #include <vulkan/vulkan_core.h>
 
@@ -16,4 +19,41 @@ void VK_CHECK(VkResult result)
             abort();
         }
     }
-}
\ No newline at end of file
+}
+
+/** Present modes that can be picked, by the name they're picked with */
+inline constexpr std::array<std::pair<std::string_view, VkPresentModeKHR>, 4>
+PRESENT_MODE_NAMES = { {
+    { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+    { "fifo_relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+    { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+    { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR }
+} };
+
+inline constexpr
+std::string_view get_present_mode_name(VkPresentModeKHR mode)
+{
+    for (const auto& [name, named_mode] : PRESENT_MODE_NAMES)
+    {
+        if (named_mode == mode)
+        {
+            return name;
+        }
+    }
+    return "unknown";
+}
+
+/** Looks up a present mode by name. Returns false if there's none. */
+inline constexpr
+bool parse_present_mode(std::string_view name, VkPresentModeKHR& mode)
+{
+    for (const auto& [mode_name, named_mode] : PRESENT_MODE_NAMES)
+    {
+        if (mode_name == name)
+        {
+            mode = named_mode;
+            return true;
+        }
+    }
+    return false;
+}
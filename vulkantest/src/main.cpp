@@ -1,13 +1,51 @@
 #include "Application.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "VulkanRenderer/vkutils.h"
+
 #ifdef _MSC_VER
 #include <crtdbg.h>
 #endif
 
-void run_application()
+void run_application(int argc, char* args[])
 {
     Application app;
 
+    // --present-mode picks the present mode to start with, and
+    // --max-frames-ahead how far the CPU may run ahead of the display
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(args[i], "--present-mode") == 0)
+        {
+            VkPresentModeKHR present_mode;
+            if (parse_present_mode(args[++i], present_mode))
+            {
+                app.present_mode = present_mode;
+            }
+            else
+            {
+                std::cerr << "Unknown present mode " << args[i] << ", use "
+                          << "fifo, fifo_relaxed, mailbox or immediate\n";
+            }
+        }
+        else if (strcmp(args[i], "--max-frames-ahead") == 0)
+        {
+            const int frames_ahead = atoi(args[++i]);
+            if (frames_ahead >= 1 && frames_ahead <= NUM_OVERLAPPING_FRAMES)
+            {
+                app.max_frames_ahead = (uint32_t)frames_ahead;
+            }
+            else
+            {
+                std::cerr << "Max frames ahead must be from 1 to "
+                          << NUM_OVERLAPPING_FRAMES << "\n";
+            }
+        }
+    }
+
     app.initialize();
     app.run();
     app.destroy();
@@ -27,7 +65,7 @@ int main(int argc, char* args[])
     //_CrtSetBreakAlloc(163);
 #endif
 
-    run_application();
+    run_application(argc, args);
 
 #ifdef _MSC_VER
     // Perform the leak check